@@ -0,0 +1,51 @@
+// glm 0.9.9.7 timings of the operations main.cpp measures for cgmath.h, on the same kind of matrices
+
+#define GLM_FORCE_INTRINSICS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+struct Timing { double mul, mul_vec, inverse, rotate, look_at; };
+static volatile float sink; // keeps the timed results
+
+template <class F> static double time_ns( int count, int rounds, F f )
+{
+	double best=1e30;
+	for( int k=0; k<rounds; k++ )
+	{
+		auto start=std::chrono::high_resolution_clock::now(); f();
+		double ns=std::chrono::duration<double,std::nano>(std::chrono::high_resolution_clock::now()-start).count()/count;
+		if(ns<best) best=ns;
+	}
+	return best;
+}
+
+Timing glm_timing( int count, int rounds )
+{
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> position(-100,100), direction(-1,1), scale(0.1f,10), angle(-3.14f,3.14f);
+
+	std::vector<glm::mat4> m(count), r(count); std::vector<glm::vec4> v(count), rv(count);
+	std::vector<glm::vec3> axes(count), eye(count), at(count); std::vector<float> angles(count); glm::vec3 up(0,0,1);
+	for( int i=0; i<count; i++ )
+	{
+		glm::vec3 axis=glm::normalize(glm::vec3(direction(rng),direction(rng),direction(rng)));
+		m[i]=glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f),glm::vec3(position(rng),position(rng),position(rng))),angle(rng),axis),glm::vec3(scale(rng),scale(rng),scale(rng)));
+		v[i]=glm::vec4(direction(rng)*10,direction(rng)*10,direction(rng)*10,1);
+		axes[i]=glm::normalize(glm::vec3(direction(rng),direction(rng),direction(rng))); angles[i]=angle(rng);
+		eye[i]=glm::vec3(position(rng),position(rng),position(rng)); at[i]=glm::vec3(position(rng),position(rng),position(rng))*0.1f;
+	}
+	glm::mat4 vp=glm::perspective(0.8f,1.6f,0.1f,1000.0f)*glm::lookAt(glm::vec3(50,20,10),glm::vec3(0),glm::vec3(0,0,1));
+
+	Timing t;
+	t.mul=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=vp*m[i]; vp[0][0]+=r[count-1][0][1]*1e-9f; });
+	t.mul_vec=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) rv[i]=m[i]*v[i]; v[0].x+=rv[count-1].y*1e-9f; });
+	t.inverse=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=glm::inverse(m[i]); m[0][3][0]+=r[count-1][0][1]*1e-9f; });
+	t.rotate=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=glm::rotate(glm::mat4(1.0f),angles[i],axes[i]); angles[0]+=r[count-1][0][1]*1e-9f; });
+	t.look_at=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=glm::lookAt(eye[i],at[i],up); eye[0].x+=r[count-1][0][1]*1e-9f; });
+	sink=r[0][0][0]+rv[0].x;
+	return t;
+}
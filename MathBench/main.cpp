@@ -0,0 +1,166 @@
+// checks and timings of the mat4 operations of cgmath.h (simd::), shared by VulkanTest and trackball
+// - bit for bit against the scalar formulas they replaced : products, rotate and lookAt
+// - the residual of the block inverse, |m*inverse(m) - I|
+// - nanoseconds per operation next to the scalar formulas and glm 0.9.9.7 (glm_bench.cpp)
+// returns 1 when a check fails
+
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../common/cgmath.h"	// after the std headers : it defines min/max macros
+
+// glm_bench.cpp : its own translation unit, glm and the macros of cgmath.h do not mix
+struct Timing { double mul, mul_vec, inverse, rotate, look_at; };
+Timing glm_timing( int count, int rounds );
+
+//*******************************************************************
+// the formulas of mat4 before simd:: (row-major, the same order of operations)
+namespace scalar
+{
+	inline void mat4_mul( const float* a, const float* b, float* r )
+	{
+		for( int i=0; i<16; i+=4 ) for( int j=0; j<4; j++ ) r[i+j]=b[j]*a[i]+b[4+j]*a[i+1]+b[8+j]*a[i+2]+b[12+j]*a[i+3];
+	}
+
+	inline void mat4_mul_vec4( const float* a, const float* v, float* r )
+	{
+		for( int i=0; i<4; i++ ) r[i]=a[i*4]*v[0]+a[i*4+1]*v[1]+a[i*4+2]*v[2]+a[i*4+3]*v[3];
+	}
+
+	inline void mat4_rotate( const float* axis, float angle, float* r )
+	{
+		float c=cos(angle), s=sin(angle), x=axis[0], y=axis[1], z=axis[2];
+		r[0] = x*x*(1-c)+c;		r[1] = x*y*(1-c)-z*s;	r[2] = x*z*(1-c)+y*s;	r[3] = 0.0f;
+		r[4] = x*y*(1-c)+z*s;	r[5] = y*y*(1-c)+c;		r[6] = y*z*(1-c)-x*s;	r[7] = 0.0f;
+		r[8] = x*z*(1-c)-y*s;	r[9] = y*z*(1-c)+x*s;	r[10] = z*z*(1-c)+c;	r[11] = 0.0f;
+		r[12] = 0;				r[13] = 0;				r[14] = 0;				r[15] = 1.0f;
+	}
+
+	inline void mat4_look_at( const float* eye, const float* at, const float* up, float* r )
+	{
+		vec3 e(eye[0],eye[1],eye[2]), n=vec3(eye[0]-at[0],eye[1]-at[1],eye[2]-at[2]);
+		n=vec3(n.x,n.y,n.z)/sqrt(n.x*n.x+n.y*n.y+n.z*n.z);
+		vec3 u(up[1]*n.z-up[2]*n.y, up[2]*n.x-up[0]*n.z, up[0]*n.y-up[1]*n.x);
+		u=u/sqrt(u.x*u.x+u.y*u.y+u.z*u.z);
+		vec3 v(n.y*u.z-n.z*u.y, n.z*u.x-n.x*u.z, n.x*u.y-n.y*u.x);
+		v=v/sqrt(v.x*v.x+v.y*v.y+v.z*v.z);
+		r[0] = u.x;	r[1] = u.y;	r[2] = u.z;		r[3] = -(u.x*e.x+u.y*e.y+u.z*e.z);
+		r[4] = v.x;	r[5] = v.y;	r[6] = v.z;		r[7] = -(v.x*e.x+v.y*e.y+v.z*e.z);
+		r[8] = n.x;	r[9] = n.y;	r[10] = n.z;	r[11] = -(n.x*e.x+n.y*e.y+n.z*e.z);
+		r[12] = 0;	r[13] = 0;	r[14] = 0;		r[15] = 1.0f;
+	}
+}
+
+//*******************************************************************
+static const double RESIDUAL_LIMIT=64.0; // in epsilons of max|m| * max|inverse(m)|
+static std::mt19937 rng(1);
+static volatile float sink; // keeps the timed results
+inline float random( float lo, float hi ){ return std::uniform_real_distribution<float>(lo,hi)(rng); }
+inline vec3 random3( float lo, float hi ){ return vec3(random(lo,hi),random(lo,hi),random(lo,hi)); }
+
+// what the renderers invert : model matrices (translate, rotate, scale) and view-projections
+inline mat4 random_model(){ return mat4::translate(random3(-100,100))*mat4::rotate(random3(-1,1).normalize(),random(-PI,PI))*mat4::scale(random3(0.1f,10)); }
+inline mat4 random_view_projection(){ return mat4::perspective(random(0.3f,1.5f),random(0.5f,2.0f),random(0.1f,1.0f),random(100,10000))*mat4::lookAt(random3(-100,100),random3(-10,10),vec3(0,0,1)); }
+
+// largest |m*inverse(m) - I| in units of what rounding alone allows : max|m| * max|inverse(m)| * epsilon
+// (a view-projection has elements far apart, its absolute residual says little)
+inline double residual( const mat4& m )
+{
+	mat4 i=m.inverse(), p=m*i; double r=0, mm=0, mi=0;
+	for( int k=0; k<16; k++ )
+	{
+		double d=fabs(p.a[k]-(k%5==0?1.0f:0.0f)); if(d>r) r=d;
+		if(fabs(m.a[k])>mm) mm=fabs(m.a[k]);
+		if(fabs(i.a[k])>mi) mi=fabs(i.a[k]);
+	}
+	return r/(mm*mi*FLT_EPSILON);
+}
+
+int check( int count )
+{
+	int mul=0, mul_vec=0, rotate=0, look_at=0; double model_residual=0, projection_residual=0;
+	for( int it=0; it<count; it++ )
+	{
+		float r[16];
+		mat4 a, b; for( int k=0; k<16; k++ ){ a.a[k]=random(-10,10); b.a[k]=random(-10,10); }
+		mat4 ab=a*b; scalar::mat4_mul(a.a,b.a,r); mul+=memcmp(ab.a,r,sizeof(r))!=0;
+		vec4 v(random(-10,10),random(-10,10),random(-10,10),random(-10,10)), av=a*v; scalar::mat4_mul_vec4(a.a,&v.x,r); mul_vec+=memcmp(&av.x,r,sizeof(float)*4)!=0;
+
+		vec3 axis=random3(-1,1).normalize(); float angle=random(-PI,PI);
+		mat4 rot=mat4::rotate(axis,angle); scalar::mat4_rotate(&axis.x,angle,r); rotate+=memcmp(rot.a,r,sizeof(r))!=0;
+		vec3 eye=random3(-100,100), at=random3(-100,100), up=random3(-1,1);
+		mat4 view=mat4::lookAt(eye,at,up); scalar::mat4_look_at(&eye.x,&at.x,&up.x,r); look_at+=memcmp(view.a,r,sizeof(r))!=0;
+
+		double d=residual(random_model()); if(d>model_residual) model_residual=d;
+		d=residual(random_view_projection()); if(d>projection_residual) projection_residual=d;
+	}
+	mat4 zero; memset(zero.a,0,sizeof(zero.a)); bool singular=zero.inverse()==mat4(); // prints its warning
+
+	// the scalar formulas are exact matches unless the compiler contracts them into FMAs
+	// the residuals of a 4x4 inverse stay within a few dozen epsilons
+	bool pass=mul==0&&mul_vec==0&&rotate==0&&look_at==0&&model_residual<RESIDUAL_LIMIT&&projection_residual<RESIDUAL_LIMIT&&singular;
+	printf( "bit-exact mismatches in %d : mul %d, mul_vec %d, rotate %d, lookAt %d\n", count, mul, mul_vec, rotate, look_at );
+	printf( "inverse residual (epsilons) : model %.2f, view-projection %.2f, singular -> identity %s\n", model_residual, projection_residual, singular?"yes":"no" );
+	printf( "%s\n", pass?"checks passed":"checks FAILED" );
+	return pass?0:1;
+}
+
+//*******************************************************************
+// nanoseconds per operation over count matrices, the best of the rounds (each result feeds the next round)
+template <class F> double time_ns( int count, int rounds, F f )
+{
+	double best=1e30;
+	for( int k=0; k<rounds; k++ )
+	{
+		auto start=std::chrono::high_resolution_clock::now(); f();
+		double ns=std::chrono::duration<double,std::nano>(std::chrono::high_resolution_clock::now()-start).count()/count;
+		if(ns<best) best=ns;
+	}
+	return best;
+}
+
+void bench( int count, int rounds )
+{
+	std::vector<mat4> m(count), r(count); std::vector<vec4> v(count), rv(count);
+	std::vector<vec3> axis(count), eye(count), at(count); std::vector<float> angle(count); vec3 up(0,0,1);
+	for( int i=0; i<count; i++ ){ m[i]=random_model(); v[i]=vec4(random3(-10,10),1); axis[i]=random3(-1,1).normalize(); angle[i]=random(-PI,PI); eye[i]=random3(-100,100); at[i]=random3(-10,10); }
+	mat4 vp=random_view_projection();
+
+	Timing cg, sc;
+	cg.mul=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=vp*m[i]; vp.a[0]+=r[count-1].a[1]*1e-9f; });
+	sc.mul=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) scalar::mat4_mul(vp.a,m[i].a,r[i].a); vp.a[0]+=r[count-1].a[1]*1e-9f; });
+	cg.mul_vec=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) rv[i]=m[i]*v[i]; v[0].x+=rv[count-1].y*1e-9f; });
+	sc.mul_vec=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) scalar::mat4_mul_vec4(m[i].a,&v[i].x,&rv[i].x); v[0].x+=rv[count-1].y*1e-9f; });
+	cg.inverse=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=m[i].inverse(); m[0].a[3]+=r[count-1].a[1]*1e-9f; });
+	cg.rotate=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=mat4::rotate(axis[i],angle[i]); angle[0]+=r[count-1].a[1]*1e-9f; });
+	sc.rotate=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) scalar::mat4_rotate(&axis[i].x,angle[i],r[i].a); angle[0]+=r[count-1].a[1]*1e-9f; });
+	cg.look_at=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) r[i]=mat4::lookAt(eye[i],at[i],up); eye[0].x+=r[count-1].a[1]*1e-9f; });
+	sc.look_at=time_ns(count,rounds,[&](){ for( int i=0; i<count; i++ ) scalar::mat4_look_at(&eye[i].x,&at[i].x,&up.x,r[i].a); eye[0].x+=r[count-1].a[1]*1e-9f; });
+	sink=r[0].a[0]+rv[0].x;
+	Timing gl=glm_timing(count,rounds);
+
+	printf( "ns per operation    mat4*mat4  mat4*vec4  inverse  rotate  lookAt\n" );
+	printf( "  cgmath (simd::)   %9.2f  %9.2f  %7.2f  %6.2f  %6.2f\n", cg.mul, cg.mul_vec, cg.inverse, cg.rotate, cg.look_at );
+	printf( "  scalar formulas   %9.2f  %9.2f        -  %6.2f  %6.2f\n", sc.mul, sc.mul_vec, sc.rotate, sc.look_at );
+	printf( "  glm 0.9.9.7       %9.2f  %9.2f  %7.2f  %6.2f  %6.2f\n", gl.mul, gl.mul_vec, gl.inverse, gl.rotate, gl.look_at );
+}
+
+int main( int argc, char* argv[] )
+{
+#if defined(CGMATH_AVX)
+	printf( "cgmath.h : AVX\n" );
+#elif defined(CGMATH_SSE)
+	printf( "cgmath.h : SSE\n" );
+#elif defined(CGMATH_NEON)
+	printf( "cgmath.h : NEON\n" );
+#else
+	printf( "cgmath.h : plain floats\n" );
+#endif
+	int result=check(100000);
+	if(argc<2||strcmp(argv[1],"--check")!=0) bench(1024,2000);
+	return result;
+}
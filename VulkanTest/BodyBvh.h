@@ -0,0 +1,281 @@
+#pragma once
+
+// no std::min/max or glm::min/max here : cgmath.h defines them as macros
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// bounding volume hierarchy over the bounding spheres of the bodies (center, radius in w)
+// the tree is built by median splits for a body count and refit bottom up every frame from the new spheres.
+// the tree keeps its own copy of the spheres in leaf order, gathered at every refit.
+// orbiting bodies make the refit boxes overlap more and more, so the tree is rebuilt once the total surface
+// of its boxes has doubled since the last build.
+class BodyBvh {
+
+public:
+
+	static const uint32_t LEAF_SIZE = 4;
+	static const uint32_t NO_BODY = UINT32_MAX;
+
+	// refit to the spheres of this frame, indexed by body (rebuild when the body count changed or the tree degraded)
+	void update(const std::vector<glm::vec4>& bodies) {
+		if (nodes.empty() || order.size() != bodies.size() || refit(bodies) > built_area * 2.0f) build(bodies);
+	}
+
+	// the nearest body the ray hits, at distance along the normalized direction (NO_BODY when none)
+	uint32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance) const {
+		uint32_t hit = NO_BODY;
+		distance = INFINITY;
+		if (nodes.empty()) return hit;
+
+		glm::vec3 inverse = 1.0f / direction;
+		uint32_t stack[64];
+		uint32_t top = 0;
+		stack[top++] = 0;
+
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+			if (!rayHitsBox(origin, inverse, node, distance)) continue;
+
+			if (node.count == 0) {
+				stack[top++] = node.first;
+				stack[top++] = node.first + 1;
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				float t;
+				if (rayHitsSphere(origin, direction, leafSphere(i), t) && t < distance) {
+					distance = t;
+					hit = order[i];
+				}
+			}
+		}
+		return hit;
+	}
+
+	// bodies whose spheres overlap the sphere at center
+	void queryRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& bodies) const {
+		bodies.clear();
+		if (nodes.empty()) return;
+
+		uint32_t stack[64];
+		uint32_t top = 0;
+		stack[top++] = 0;
+
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+
+			// the point of the box closest to the center
+			glm::vec3 closest = glm::vec3(
+				center.x < node.lo.x ? node.lo.x : (center.x > node.hi.x ? node.hi.x : center.x),
+				center.y < node.lo.y ? node.lo.y : (center.y > node.hi.y ? node.hi.y : center.y),
+				center.z < node.lo.z ? node.lo.z : (center.z > node.hi.z ? node.hi.z : center.z));
+			glm::vec3 gap = closest - center;
+			if (glm::dot(gap, gap) > radius * radius) continue;
+
+			if (node.count == 0) {
+				stack[top++] = node.first;
+				stack[top++] = node.first + 1;
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const glm::vec4& sphere = leafSphere(i);
+				float reach = radius + sphere.w;
+				glm::vec3 offset = glm::vec3(sphere) - center;
+				if (glm::dot(offset, offset) <= reach * reach) bodies.push_back(order[i]);
+			}
+		}
+	}
+
+	// bodies whose spheres are not completely outside of any plane (inside : dot(plane.xyz, p) + plane.w >= 0)
+	void queryFrustum(const glm::vec4 planes[6], std::vector<uint32_t>& bodies) const {
+		bodies.clear();
+		if (nodes.empty()) return;
+
+		glm::vec4 normalized[6];
+		for (int p = 0; p < 6; p++) normalized[p] = planes[p] / glm::length(glm::vec3(planes[p]));
+
+		uint32_t stack[64];
+		uint32_t top = 0;
+		stack[top++] = 0;
+
+		while (top > 0) {
+			uint32_t index = stack[--top];
+			const Node& node = nodes[index];
+
+			// box center and half extent against each plane : outside, straddling or inside
+			glm::vec3 center = (node.lo + node.hi) * 0.5f;
+			glm::vec3 half = (node.hi - node.lo) * 0.5f;
+			bool outside = false, inside = true;
+			for (int p = 0; p < 6 && !outside; p++) {
+				const glm::vec4& plane = normalized[p];
+				float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+				float reach = fabsf(plane.x) * half.x + fabsf(plane.y) * half.y + fabsf(plane.z) * half.z;
+				if (distance < -reach) outside = true;
+				if (distance < reach) inside = false;
+			}
+			if (outside) continue;
+
+			// a box in the frustum : all of its bodies, without testing them
+			if (inside) {
+				collect(index, bodies);
+				continue;
+			}
+
+			if (node.count == 0) {
+				stack[top++] = node.first;
+				stack[top++] = node.first + 1;
+				continue;
+			}
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const glm::vec4& sphere = leafSphere(i);
+				bool visible = true;
+				for (int p = 0; p < 6 && visible; p++) {
+					visible = glm::dot(glm::vec3(normalized[p]), glm::vec3(sphere)) + normalized[p].w >= -sphere.w;
+				}
+				if (visible) bodies.push_back(order[i]);
+			}
+		}
+	}
+
+	size_t nodeCount() const { return nodes.size(); }
+	uint32_t buildCount() const { return build_count; }
+
+private:
+
+	// a leaf holds order[first .. first + count), an inner node (count 0) has the children first and first + 1
+	// children always come after their parent, so a reverse walk refits bottom up
+	struct Node {
+		glm::vec3 lo, hi;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	void build(const std::vector<glm::vec4>& bodies) {
+		order.resize(bodies.size());
+		leaves.resize(bodies.size());
+		for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+
+		nodes.clear();
+		nodes.reserve(bodies.size() / LEAF_SIZE * 2 + 1);
+		nodes.push_back({ glm::vec3(0.0f), glm::vec3(0.0f), 0, static_cast<uint32_t>(order.size()) });
+		split(bodies, 0);
+
+		built_area = refit(bodies);
+		build_count++;
+	}
+
+	// median split along the longest axis of the centers, until the leaves are small enough
+	void split(const std::vector<glm::vec4>& bodies, uint32_t index) {
+		uint32_t first = nodes[index].first;
+		uint32_t count = nodes[index].count;
+		if (count <= LEAF_SIZE) return;
+
+		glm::vec3 lo = glm::vec3(bodies[order[first]]), hi = lo;
+		for (uint32_t i = first + 1; i < first + count; i++) {
+			const glm::vec4& c = bodies[order[i]];
+			lo = glm::vec3(c.x < lo.x ? c.x : lo.x, c.y < lo.y ? c.y : lo.y, c.z < lo.z ? c.z : lo.z);
+			hi = glm::vec3(c.x > hi.x ? c.x : hi.x, c.y > hi.y ? c.y : hi.y, c.z > hi.z ? c.z : hi.z);
+		}
+		glm::vec3 extent = hi - lo;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+		const float* coordinates = &bodies[0].x + axis; // 4 floats per body
+		uint32_t half = count / 2;
+		std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+			[=](uint32_t a, uint32_t b) { return coordinates[a * 4] < coordinates[b * 4]; });
+
+		uint32_t left = static_cast<uint32_t>(nodes.size());
+		nodes[index].first = left;
+		nodes[index].count = 0;
+		nodes.push_back({ glm::vec3(0.0f), glm::vec3(0.0f), first, half });
+		nodes.push_back({ glm::vec3(0.0f), glm::vec3(0.0f), first + half, count - half });
+		split(bodies, left);
+		split(bodies, left + 1);
+	}
+
+	// fit the boxes to the spheres, returns the total surface of the inner boxes (what a traversal pays for)
+	// the gather into leaf order is a pass of its own : its loads do not depend on each other, and the fit and the
+	// queries then read contiguous spheres
+	float refit(const std::vector<glm::vec4>& bodies) {
+		for (size_t i = 0; i < order.size(); i++) leaves[i] = bodies[order[i]];
+
+		float area = 0.0f;
+		for (size_t n = nodes.size(); n > 0; n--) {
+			Node& node = nodes[n - 1];
+			if (node.count > 0) {
+				const glm::vec4& first = leaves[node.first];
+				glm::vec3 lo = glm::vec3(first) - first.w;
+				glm::vec3 hi = glm::vec3(first) + first.w;
+				for (uint32_t i = node.first + 1; i < node.first + node.count; i++) {
+					const glm::vec4& sphere = leaves[i];
+					glm::vec3 l = glm::vec3(sphere) - sphere.w;
+					glm::vec3 h = glm::vec3(sphere) + sphere.w;
+					lo = glm::vec3(l.x < lo.x ? l.x : lo.x, l.y < lo.y ? l.y : lo.y, l.z < lo.z ? l.z : lo.z);
+					hi = glm::vec3(h.x > hi.x ? h.x : hi.x, h.y > hi.y ? h.y : hi.y, h.z > hi.z ? h.z : hi.z);
+				}
+				node.lo = lo;
+				node.hi = hi;
+			}
+			else {
+				const Node& a = nodes[node.first];
+				const Node& b = nodes[node.first + 1];
+				node.lo = glm::vec3(a.lo.x < b.lo.x ? a.lo.x : b.lo.x, a.lo.y < b.lo.y ? a.lo.y : b.lo.y, a.lo.z < b.lo.z ? a.lo.z : b.lo.z);
+				node.hi = glm::vec3(a.hi.x > b.hi.x ? a.hi.x : b.hi.x, a.hi.y > b.hi.y ? a.hi.y : b.hi.y, a.hi.z > b.hi.z ? a.hi.z : b.hi.z);
+				glm::vec3 e = node.hi - node.lo;
+				area += e.x * e.y + e.y * e.z + e.z * e.x;
+			}
+		}
+		return area;
+	}
+
+	const glm::vec4& leafSphere(uint32_t i) const { return leaves[i]; }
+
+	void collect(uint32_t index, std::vector<uint32_t>& bodies) const {
+		const Node& node = nodes[index];
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) bodies.push_back(order[i]);
+			return;
+		}
+		collect(node.first, bodies);
+		collect(node.first + 1, bodies);
+	}
+
+	// slab test, only boxes entered before the nearest hit so far
+	static bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverse, const Node& node, float distance) {
+		glm::vec3 t0 = (node.lo - origin) * inverse;
+		glm::vec3 t1 = (node.hi - origin) * inverse;
+		float enter = 0.0f, exit = distance;
+		for (int a = 0; a < 3; a++) {
+			float near_t = t0[a] < t1[a] ? t0[a] : t1[a];
+			float far_t = t0[a] < t1[a] ? t1[a] : t0[a];
+			if (near_t > enter) enter = near_t;
+			if (far_t < exit) exit = far_t;
+		}
+		return enter <= exit;
+	}
+
+	// the first intersection in front of the origin (the exit point when the origin is inside)
+	static bool rayHitsSphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec4& sphere, float& t) {
+		glm::vec3 offset = glm::vec3(sphere) - origin;
+		float along = glm::dot(offset, direction);
+		float d2 = glm::dot(offset, offset) - along * along;
+		float r2 = sphere.w * sphere.w;
+		if (d2 > r2) return false;
+
+		float half = sqrtf(r2 - d2);
+		t = along - half;
+		if (t < 0.0f) t = along + half;
+		return t >= 0.0f;
+	}
+
+	std::vector<glm::vec4> leaves;  // the spheres of the last update, in leaf order
+	std::vector<uint32_t> order;    // leaf order -> body
+	std::vector<Node> nodes;        // nodes[0] is the root
+	float built_area = 0.0f;
+	uint32_t build_count = 0;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// stable handle of a runtime body : slot in the instance buffer + generation of that slot
+// a handle kept after its body is destroyed never matches the next body in the same slot
+struct BodyHandle {
+	uint32_t slot = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool valid() const { return slot != UINT32_MAX; }
+};
+
+// free-list slot allocator of the runtime bodies
+// a destroyed body stops being drawn by the next frame, but its slot is handed out again only after recycle(),
+// which the owner calls once every frame that may still read the slot is complete (FrameScheduler::defer).
+class BodyRegistry {
+
+public:
+
+	void init(uint32_t capacity) {
+		generations.assign(capacity, 0);
+		live.assign(capacity, false);
+		free_slots.clear();
+		for (uint32_t i = capacity; i > 0; i--) free_slots.push_back(i - 1); // low slots first
+		high_water = 0;
+		live_count = 0;
+	}
+
+	// invalid handle when every slot is in use (or waiting for the GPU)
+	BodyHandle create() {
+		BodyHandle handle;
+		if (free_slots.empty()) return handle;
+
+		handle.slot = free_slots.back();
+		handle.generation = generations[handle.slot];
+		free_slots.pop_back();
+
+		live[handle.slot] = true;
+		live_count++;
+		if (handle.slot + 1 > high_water) high_water = handle.slot + 1;
+		return handle;
+	}
+
+	// false for a stale handle
+	bool destroy(BodyHandle handle) {
+		if (!alive(handle)) return false;
+
+		live[handle.slot] = false;
+		generations[handle.slot]++;
+		live_count--;
+		while (high_water > 0 && !live[high_water - 1]) high_water--;
+		return true;
+	}
+
+	// the GPU is done with the destroyed body of the slot
+	void recycle(uint32_t slot) {
+		free_slots.push_back(slot);
+	}
+
+	bool alive(BodyHandle handle) const {
+		return handle.slot < live.size() && live[handle.slot] && generations[handle.slot] == handle.generation;
+	}
+
+	uint32_t capacity() const { return static_cast<uint32_t>(live.size()); }
+	uint32_t liveCount() const { return live_count; }
+	uint32_t highWater() const { return high_water; } // draw range : every live slot is below it
+
+private:
+
+	std::vector<uint32_t> generations;
+	std::vector<bool> live;
+	std::vector<uint32_t> free_slots;
+	uint32_t high_water = 0;
+	uint32_t live_count = 0;
+};
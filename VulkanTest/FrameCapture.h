@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stb_image_write.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// encodes captured frames on a worker thread
+// the owner hands over pixels that stay valid (mapped readback memory) until the worker gives the slot back,
+// so nothing is copied on the render thread. PNG writes one file per frame (golden images), Y4M streams
+// every frame into one file (benchmark recordings, a new file when the size changes) at the rate given to start(),
+// and repeats the previous frame for the ones that were dropped so the recording keeps its timing.
+class CaptureWriter {
+
+public:
+
+	enum Format { FORMAT_PNG, FORMAT_Y4M };
+
+	// rate : frames per second of the Y4M stream, rate_numerator / rate_denominator
+	void start(Format format, const std::string& prefix, uint32_t rate_numerator, uint32_t rate_denominator) {
+		this->format = format;
+		this->prefix = prefix;
+		this->rate_numerator = rate_numerator;
+		this->rate_denominator = rate_denominator;
+		running = true;
+		worker = std::thread([this]() { workerLoop(); });
+	}
+
+	// writes what is queued, then joins
+	void stop() {
+		flush();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		condition.notify_all();
+		if (worker.joinable()) worker.join();
+		video.close();
+	}
+
+	// pixels : rows of width * 4 bytes, row_pitch apart (BGRA when bgra, RGBA otherwise)
+	// frame : increasing, the numbers skipped are the dropped frames
+	void write(uint32_t slot, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t row_pitch, bool bgra, uint64_t frame) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back({ slot, pixels, width, height, row_pitch, bgra, frame });
+		}
+		condition.notify_one();
+	}
+
+	// a slot the worker is done with (polled by the owner)
+	bool released(uint32_t& slot) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (done.empty()) return false;
+		slot = done.front();
+		done.pop_front();
+		return true;
+	}
+
+	// block until every queued frame is written
+	void flush() {
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this]() { return jobs.empty() && !busy; });
+	}
+
+	size_t written() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return written_count;
+	}
+
+private:
+
+	struct Job {
+		uint32_t slot;
+		const uint8_t* pixels;
+		uint32_t width, height, row_pitch;
+		bool bgra;
+		uint64_t frame;
+	};
+
+	void workerLoop() {
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return !running || !jobs.empty(); });
+				if (jobs.empty()) return;
+				job = jobs.front();
+				jobs.pop_front();
+				busy = true;
+			}
+
+			if (format == FORMAT_PNG) writePng(job);
+			else writeY4m(job);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				done.push_back(job.slot);
+				written_count++;
+				busy = false;
+			}
+			idle.notify_all();
+		}
+	}
+
+	void writePng(const Job& job) {
+		converted.resize(size_t(job.width) * job.height * 3);
+		for (uint32_t y = 0; y < job.height; y++) {
+			const uint8_t* src = job.pixels + size_t(y) * job.row_pitch;
+			uint8_t* dst = converted.data() + size_t(y) * job.width * 3;
+			for (uint32_t x = 0; x < job.width; x++, src += 4, dst += 3) {
+				dst[0] = src[job.bgra ? 2 : 0];
+				dst[1] = src[1];
+				dst[2] = src[job.bgra ? 0 : 2];
+			}
+		}
+
+		char name[64];
+		snprintf(name, sizeof(name), "_%06llu.png", (unsigned long long)job.frame);
+		stbi_write_png((prefix + name).c_str(), job.width, job.height, 3, converted.data(), job.width * 3);
+	}
+
+	// 4:4:4 planes, BT.601 studio range
+	void writeY4m(const Job& job) {
+		if (!video.is_open() || job.width != video_width || job.height != video_height) {
+			video.close();
+			std::string name = prefix + (video_count > 0 ? "_" + std::to_string(video_count) : "") + ".y4m";
+			video.open(name, std::ios::binary);
+			video << "YUV4MPEG2 W" << job.width << " H" << job.height << " F" << rate_numerator << ":" << rate_denominator << " Ip A1:1 C444\n";
+			video_width = job.width;
+			video_height = job.height;
+			video_count++;
+		}
+		else {
+			// converted still holds the previous frame of this file
+			for (uint64_t dropped = video_frame + 1; dropped < job.frame; dropped++) {
+				video << "FRAME\n";
+				video.write(reinterpret_cast<const char*>(converted.data()), converted.size());
+			}
+		}
+		video_frame = job.frame;
+
+		size_t plane = size_t(job.width) * job.height;
+		std::vector<uint8_t>& yuv = converted;
+		yuv.resize(plane * 3);
+		for (uint32_t y = 0; y < job.height; y++) {
+			const uint8_t* src = job.pixels + size_t(y) * job.row_pitch;
+			for (uint32_t x = 0; x < job.width; x++, src += 4) {
+				int r = src[job.bgra ? 2 : 0], g = src[1], b = src[job.bgra ? 0 : 2];
+				size_t i = size_t(y) * job.width + x;
+				yuv[i] = uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+				yuv[plane + i] = uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				yuv[plane * 2 + i] = uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+		}
+
+		video << "FRAME\n";
+		video.write(reinterpret_cast<const char*>(yuv.data()), yuv.size());
+	}
+
+	Format format = FORMAT_PNG;
+	std::string prefix;
+	uint32_t rate_numerator = 60, rate_denominator = 1;
+
+	// worker only
+	std::vector<uint8_t> converted;        // the pixels of the last frame as written, reused by every frame
+	std::ofstream video;
+	uint32_t video_width = 0, video_height = 0;
+	uint32_t video_count = 0;
+	uint64_t video_frame = 0;              // the last frame written to the file
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;     // a job was queued
+	std::condition_variable idle;          // a job was written
+	bool running = false;
+	bool busy = false;
+	std::deque<Job> jobs;
+	std::deque<uint32_t> done;
+	size_t written_count = 0;
+};
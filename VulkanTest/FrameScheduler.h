@@ -0,0 +1,208 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// GPU progress as a monotonically increasing frame value
+// frame N is complete when the timeline semaphore reaches N.
+// without VK_KHR_timeline_semaphore, one fence per frame slot (N % slot count) stands in for the timeline.
+// uploads, resource recycling and deferred destruction all compare against the same value.
+class FrameScheduler {
+
+public:
+
+	void create(VkDevice device, uint32_t slot_count, bool use_timeline) {
+		this->device = device;
+		this->use_timeline = use_timeline;
+
+		if (use_timeline) {
+			vkWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+			vkGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+			if (vkWaitSemaphoresKHR == nullptr || vkGetSemaphoreCounterValueKHR == nullptr) {
+				throw std::runtime_error("failed to load VK_KHR_timeline_semaphore functions!");
+			}
+
+			VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeInfo.initialValue = frame_value;
+
+			VkSemaphoreCreateInfo semaphoreInfo = {};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphoreInfo.pNext = &typeInfo;
+
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timeline semaphore!");
+			}
+		}
+
+		setSlotCount(slot_count);
+	}
+
+	// the device must be idle
+	void destroy() {
+		collect(UINT64_MAX);
+
+		destroyFences();
+		if (timeline != VK_NULL_HANDLE) {
+			vkDestroySemaphore(device, timeline, nullptr);
+			timeline = VK_NULL_HANDLE;
+		}
+	}
+
+	// change the number of frames in flight (the device must be idle)
+	void setSlotCount(uint32_t slot_count) {
+		this->slot_count = slot_count;
+		completed_value = frame_value;
+
+		destroyFences();
+		if (!use_timeline) {
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			fences.resize(slot_count);
+			fence_values.assign(slot_count, 0);
+			for (uint32_t i = 0; i < slot_count; i++) {
+				if (vkCreateFence(device, &fenceInfo, nullptr, &fences[i]) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create frame fence!");
+				}
+			}
+		}
+	}
+
+	bool timelineSupported() const { return use_timeline; }
+
+	uint64_t submittedValue() const { return frame_value; }    // the last submitted frame
+	uint64_t nextValue() const { return frame_value + 1; }     // the frame being prepared now
+	size_t slot() const { return size_t(nextValue() % slot_count); }
+
+	// wait until the frame that used the current slot is complete, then release what it was holding
+	void beginFrame() {
+		if (nextValue() > slot_count) wait(nextValue() - slot_count);
+		collect(completedValue());
+	}
+
+	// submit the frame, signaling its value
+	// wait_values : one per wait semaphore of submitInfo, the value of each timeline one (nullptr : binary semaphores only)
+	void submit(VkQueue queue, const VkSubmitInfo& submitInfo, const uint64_t* wait_values = nullptr) {
+		uint64_t value = nextValue();
+
+		VkSubmitInfo info = submitInfo;
+		VkFence fence = VK_NULL_HANDLE;
+
+		std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+		std::vector<uint64_t> signalValues(signalSemaphores.size(), 0); // ignored for binary semaphores
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+
+		if (use_timeline) {
+			signalSemaphores.push_back(timeline);
+			signalValues.push_back(value);
+
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfo.pNext = info.pNext;
+			timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+			timelineInfo.pSignalSemaphoreValues = signalValues.data();
+			if (wait_values != nullptr) {
+				timelineInfo.waitSemaphoreValueCount = info.waitSemaphoreCount;
+				timelineInfo.pWaitSemaphoreValues = wait_values;
+			}
+
+			info.pNext = &timelineInfo;
+			info.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+			info.pSignalSemaphores = signalSemaphores.data();
+		}
+		else {
+			fence = fences[slot()];
+			vkResetFences(device, 1, &fence);
+			fence_values[slot()] = value;
+		}
+
+		if (vkQueueSubmit(queue, 1, &info, fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+
+		frame_value = value;
+	}
+
+	// block until the frame is complete
+	void wait(uint64_t value) {
+		if (value <= completed_value) return;
+		if (value > frame_value) throw std::runtime_error("waiting for a frame that is not submitted!");
+
+		if (use_timeline) {
+			VkSemaphoreWaitInfoKHR waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &value;
+			vkWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX);
+		}
+		else {
+			// a slot is reused only after its frame is complete, so it still holds this value
+			size_t i = size_t(value % slot_count);
+			if (fence_values[i] == value) vkWaitForFences(device, 1, &fences[i], VK_TRUE, UINT64_MAX);
+		}
+		completed_value = value;
+	}
+
+	// the last frame the GPU has finished, without blocking
+	uint64_t completedValue() {
+		if (use_timeline) {
+			vkGetSemaphoreCounterValueKHR(device, timeline, &completed_value);
+		}
+		else {
+			// frames complete in submission order
+			while (completed_value < frame_value) {
+				size_t i = size_t((completed_value + 1) % slot_count);
+				if (fence_values[i] != completed_value + 1 || vkGetFenceStatus(device, fences[i]) != VK_SUCCESS) break;
+				completed_value++;
+			}
+		}
+		return completed_value;
+	}
+
+	// run the deleter once every frame submitted so far (and the one being prepared) is complete
+	void defer(std::function<void()> deleter) {
+		deletions.push_back({ nextValue(), std::move(deleter) });
+	}
+
+private:
+
+	void collect(uint64_t value) {
+		size_t kept = 0;
+		for (size_t i = 0; i < deletions.size(); i++) {
+			if (deletions[i].first <= value) deletions[i].second();
+			else deletions[kept++] = std::move(deletions[i]);
+		}
+		deletions.resize(kept);
+	}
+
+	void destroyFences() {
+		for (auto fence : fences) vkDestroyFence(device, fence, nullptr);
+		fences.clear();
+		fence_values.clear();
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	bool use_timeline = false;
+	uint32_t slot_count = 1;
+
+	uint64_t frame_value = 0;      // last submitted frame
+	uint64_t completed_value = 0;  // last frame known to be complete
+
+	// timeline semaphore path
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR = nullptr;
+
+	// fallback path
+	std::vector<VkFence> fences;
+	std::vector<uint64_t> fence_values;
+
+	std::vector<std::pair<uint64_t, std::function<void()>>> deletions;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// GPU intervals of one frame, from timestamp queries (nanoseconds)
+struct FrameGpuTiming {
+	uint64_t frame = 0;
+	bool has_compute = false;   // the frame submitted its culling to the compute queue
+	double compute_begin = 0.0, compute_end = 0.0;
+	double graphics_begin = 0.0, graphics_end = 0.0;
+	bool counted = false;
+};
+
+// how much of the async compute work hides behind graphics work instead of adding to the frame time
+// the compute of frame N is meant to run beside the graphics of frame N-1, and may also overlap the start of frame N
+// (everything before its indirect draws). timings arrive when the swapchain image is reused, so not always in order.
+// timestamps of two queues only share a time domain with VK_EXT_calibrated_timestamps (its device domain) :
+// without it (correlated false) only the time spent on each queue is measured.
+class ComputeOverlapStats {
+
+public:
+
+	void add(const FrameGpuTiming& timing) {
+		history[timing.frame % HISTORY_SIZE] = timing;
+		evaluate(timing.frame);
+		evaluate(timing.frame + 1);
+	}
+
+	void reset() {
+		count = 0;
+		compute_ns = 0.0;
+		graphics_ns = 0.0;
+		overlapped_ns = 0.0;
+	}
+
+	bool correlated = false;     // the compute and graphics timestamps are comparable
+	size_t count = 0;            // frames measured since the last reset
+	double compute_ns = 0.0;     // total compute time
+	double graphics_ns = 0.0;    // total graphics time of the same frames
+	double overlapped_ns = 0.0;  // part of the compute time that ran while the graphics queue was busy (correlated only)
+
+private:
+
+	static const size_t HISTORY_SIZE = 8;
+
+	FrameGpuTiming* find(uint64_t frame) {
+		FrameGpuTiming& timing = history[frame % HISTORY_SIZE];
+		return timing.frame == frame ? &timing : nullptr;
+	}
+
+	static double overlap(double begin0, double end0, double begin1, double end1) {
+		double begin = begin0 > begin1 ? begin0 : begin1;
+		double end = end0 < end1 ? end0 : end1;
+		return end > begin ? end - begin : 0.0;
+	}
+
+	void evaluate(uint64_t frame) {
+		FrameGpuTiming* current = find(frame);
+		FrameGpuTiming* previous = frame > 1 ? find(frame - 1) : nullptr; // frame values start at 1
+		if (current == nullptr || previous == nullptr || current->counted || !current->has_compute) return;
+
+		current->counted = true;
+		count++;
+		compute_ns += current->compute_end - current->compute_begin;
+		graphics_ns += current->graphics_end - current->graphics_begin;
+		if (!correlated) return;
+
+		overlapped_ns += overlap(current->compute_begin, current->compute_end, previous->graphics_begin, previous->graphics_end);
+		overlapped_ns += overlap(current->compute_begin, current->compute_end, current->graphics_begin, current->graphics_end);
+	}
+
+	FrameGpuTiming history[HISTORY_SIZE];
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// lock-free queue from one producer thread to one consumer thread (the events of the window thread)
+// the capacity is fixed, push() drops the event when the consumer has fallen that far behind
+template <typename T, size_t Capacity>
+class InputQueue {
+
+public:
+
+	bool push(const T& item) {
+		size_t tail = write_index.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) % Capacity;
+		if (next == read_index.load(std::memory_order_acquire)) return false;
+
+		items[tail] = item;
+		write_index.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& item) {
+		size_t head = read_index.load(std::memory_order_relaxed);
+		if (head == write_index.load(std::memory_order_acquire)) return false;
+
+		item = items[head];
+		read_index.store((head + 1) % Capacity, std::memory_order_release);
+		return true;
+	}
+
+private:
+
+	T items[Capacity];
+	alignas(64) std::atomic<size_t> write_index{ 0 }; // producer only
+	alignas(64) std::atomic<size_t> read_index{ 0 };  // consumer only
+};
+
+// the latest value of a state one thread writes and another one samples, when only the newest value matters
+// (a triple buffer : the writer fills its own slot and swaps it with the middle one, the reader swaps the middle one
+// with its own when it holds a newer value ; neither thread waits, and a slot is only ever touched by one of them)
+template <typename T>
+class TripleBuffer {
+
+public:
+
+	// returns the version of the value (the writer thread only)
+	uint64_t write(const T& value) {
+		slots[back].value = value;
+		slots[back].version = ++written;
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+		return written;
+	}
+
+	// the newest value and its version, 0 : nothing written yet (the reader thread only)
+	uint64_t read(T& value) {
+		if (middle.load(std::memory_order_relaxed) & FRESH) front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		value = slots[front].value;
+		return slots[front].version;
+	}
+
+private:
+
+	static const uint32_t INDEX = 3;
+	static const uint32_t FRESH = 4; // the middle slot holds a value the reader has not taken
+
+	struct Slot {
+		T value = {};
+		uint64_t version = 0;
+	};
+
+	Slot slots[3];
+	std::atomic<uint32_t> middle{ 1 }; // index of the middle slot, and FRESH
+	uint32_t back = 0;                 // writer only
+	uint32_t front = 2;                // reader only
+	uint64_t written = 0;              // writer only
+};
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "../common/cgmath.h"	// slee's simple math library
+
+#include <cstdint>
+#include <vector>
+
+// post-transform vertex cache statistics of an index list
+struct VertexCacheStatistics {
+	uint vertices_transformed = 0; // number of vertex shader invocations (cache misses)
+	float acmr = 0.0f;             // average cache miss ratio : transformed vertices / triangles (0.5 is the best for big grid)
+	float atvr = 0.0f;             // average transform to vertex ratio : transformed vertices / referenced vertices (1.0 is the best)
+};
+
+// simulate a FIFO post-transform cache (default size is close to what most of the GPU hardware have)
+inline VertexCacheStatistics analyzeVertexCache(const std::vector<uint>& indices, size_t vertex_count, uint cache_size = 16) {
+
+	VertexCacheStatistics result;
+	if (indices.empty() || vertex_count == 0) return result;
+
+	// timestamp of the vertex when it entered the cache
+	std::vector<uint> cache_timestamps(vertex_count, 0);
+	std::vector<bool> referenced(vertex_count, false);
+	uint timestamp = cache_size + 1;
+	uint referenced_count = 0;
+
+	for (size_t i = 0; i < indices.size(); i++) {
+		uint index = indices[i];
+
+		if (!referenced[index]) {
+			referenced[index] = true;
+			referenced_count++;
+		}
+
+		// not in cache : transform, and push it into FIFO
+		if (timestamp - cache_timestamps[index] > cache_size) {
+			cache_timestamps[index] = timestamp++;
+			result.vertices_transformed++;
+		}
+	}
+
+	result.acmr = float(result.vertices_transformed) / float(indices.size() / 3);
+	result.atvr = float(result.vertices_transformed) / float(referenced_count);
+
+	return result;
+}
+
+// reorder triangles for post-transform vertex cache locality
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006)
+inline void optimizeVertexCache(std::vector<uint>& indices, size_t vertex_count) {
+
+	static const int CACHE_SIZE = 32;               // simulated LRU cache size (bigger than real one, only used for scoring)
+	static const float CACHE_DECAY_POWER = 1.5f;
+	static const float LAST_TRIANGLE_SCORE = 0.75f; // vertices of the last triangle get fixed score, so the strip direction is not forced
+	static const float VALENCE_BOOST_SCALE = 2.0f;
+	static const float VALENCE_BOOST_POWER = 0.5f;
+
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0 || vertex_count == 0) return;
+
+	// score table for each cache position / remaining valence
+	float cache_score[CACHE_SIZE];
+	for (int i = 0; i < CACHE_SIZE; i++) {
+		if (i < 3) {
+			cache_score[i] = LAST_TRIANGLE_SCORE;
+		}
+		else {
+			float scaler = 1.0f - float(i - 3) / float(CACHE_SIZE - 3);
+			cache_score[i] = powf(scaler, CACHE_DECAY_POWER);
+		}
+	}
+	auto vertexScore = [&](int cache_position, uint remaining_valence) {
+		if (remaining_valence == 0) return -1.0f; // no triangle needs this vertex anymore
+		float score = cache_position < 0 ? 0.0f : cache_score[cache_position];
+		return score + VALENCE_BOOST_SCALE * powf(float(remaining_valence), -VALENCE_BOOST_POWER);
+	};
+
+	// vertex -> triangle adjacency (CSR layout)
+	std::vector<uint> valence(vertex_count, 0);
+	for (size_t i = 0; i < indices.size(); i++) valence[indices[i]]++;
+
+	std::vector<uint> adjacency_offset(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; v++) adjacency_offset[v + 1] = adjacency_offset[v] + valence[v];
+
+	std::vector<uint> adjacency(indices.size());
+	std::vector<uint> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+	for (size_t t = 0; t < triangle_count; t++) {
+		for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = uint(t);
+	}
+
+	// initial scores
+	std::vector<int> cache_position(vertex_count, -1);
+	std::vector<float> vertex_score(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++) vertex_score[v] = vertexScore(-1, valence[v]);
+
+	std::vector<float> triangle_score(triangle_count);
+	std::vector<bool> emitted(triangle_count, false);
+	for (size_t t = 0; t < triangle_count; t++) {
+		triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint> result;
+	result.reserve(indices.size());
+
+	int cache[CACHE_SIZE + 3];
+	int cache_count = 0;
+	size_t scan_cursor = 0; // fallback linear scan when nothing in the cache is useful
+
+	int best_triangle = -1;
+	float best_score = -1.0f;
+	for (size_t t = 0; t < triangle_count; t++) {
+		if (triangle_score[t] > best_score) { best_score = triangle_score[t]; best_triangle = int(t); }
+	}
+
+	while (best_triangle >= 0) {
+
+		// emit triangle
+		emitted[best_triangle] = true;
+		uint tri[3] = { indices[best_triangle * 3], indices[best_triangle * 3 + 1], indices[best_triangle * 3 + 2] };
+		for (int k = 0; k < 3; k++) {
+			result.push_back(tri[k]);
+
+			// remove the triangle from the vertex adjacency
+			uint v = tri[k];
+			uint* begin = &adjacency[adjacency_offset[v]];
+			uint* end = begin + valence[v];
+			for (uint* it = begin; it != end; it++) {
+				if (*it == uint(best_triangle)) { *it = *(end - 1); break; }
+			}
+			valence[v]--;
+		}
+
+		// move the triangle vertices to the front of LRU cache
+		int new_cache[CACHE_SIZE + 3];
+		int new_count = 0;
+		for (int k = 0; k < 3; k++) new_cache[new_count++] = int(tri[k]);
+		for (int i = 0; i < cache_count; i++) {
+			int v = cache[i];
+			if (v != int(tri[0]) && v != int(tri[1]) && v != int(tri[2])) new_cache[new_count++] = v;
+		}
+
+		// update scores of the vertices that are (or were) in the cache
+		for (int i = 0; i < new_count; i++) {
+			int v = new_cache[i];
+			cache_position[v] = i < CACHE_SIZE ? i : -1;
+
+			float score = vertexScore(cache_position[v], valence[v]);
+			float delta = score - vertex_score[v];
+			vertex_score[v] = score;
+
+			for (uint a = adjacency_offset[v]; a < adjacency_offset[v] + valence[v]; a++) triangle_score[adjacency[a]] += delta;
+		}
+
+		// then find the next best triangle among theirs (a triangle shares up to three of them, so only now are all its scores final)
+		best_triangle = -1;
+		best_score = -1.0f;
+		for (int i = 0; i < new_count; i++) {
+			int v = new_cache[i];
+			for (uint a = adjacency_offset[v]; a < adjacency_offset[v] + valence[v]; a++) {
+				uint t = adjacency[a];
+				if (triangle_score[t] > best_score) { best_score = triangle_score[t]; best_triangle = int(t); }
+			}
+		}
+		cache_count = min(new_count, CACHE_SIZE);
+		for (int i = 0; i < cache_count; i++) cache[i] = new_cache[i];
+
+		// dead end : take the next not emitted triangle in the original order
+		if (best_triangle < 0) {
+			while (scan_cursor < triangle_count && emitted[scan_cursor]) scan_cursor++;
+			if (scan_cursor < triangle_count) best_triangle = int(scan_cursor);
+		}
+	}
+
+	indices.swap(result);
+}
+
+// narrow an index list to 16-bit, when every index fits into it
+inline bool packIndices16(const std::vector<uint>& indices, std::vector<uint16_t>& packed) {
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indices[i] > 0xFFFF) return false;
+	}
+	packed.assign(indices.begin(), indices.end());
+	return true;
+}
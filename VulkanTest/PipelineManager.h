@@ -0,0 +1,205 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// pipeline variants compiled on worker threads into one shared VkPipelineCache
+// the frame loop asks for the variant the settings want with get() and keeps drawing with the one it has
+// until get() returns something. compiled variants stay until destroy() or clear(), so switching back is free.
+// Variant needs operator==, Pipelines is whatever the builder returns (a set of VkPipeline handles).
+template <typename Variant, typename Pipelines>
+class PipelineManager {
+
+public:
+
+	// called on a worker thread, throws std::runtime_error like the rest of the pipeline creation
+	using Builder = std::function<Pipelines(const Variant& variant, VkPipelineCache cache)>;
+	using Destroyer = std::function<void(const Pipelines& pipelines)>;
+
+	// initial_data : a cache saved by cacheData() on an earlier run (the driver ignores a stale one)
+	void create(VkDevice device, const std::vector<char>& initial_data, uint32_t thread_count, Builder builder, Destroyer destroyer) {
+		this->device = device;
+		this->builder = builder;
+		this->destroyer = destroyer;
+
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = initial_data.size();
+		cacheInfo.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+
+		running = true;
+		for (uint32_t i = 0; i < thread_count; i++) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	// the device must be idle
+	void destroy() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+			jobs.clear();
+		}
+		condition.notify_all();
+		for (auto& worker : workers) worker.join();
+		workers.clear();
+
+		clear();
+		vkDestroyPipelineCache(device, cache, nullptr);
+	}
+
+	// destroy every compiled variant, e.g. when the render pass they were built for changes (the device must be idle)
+	void clear() {
+		waitIdle();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& entry : entries) {
+			if (entry.state == READY) destroyer(entry.pipelines);
+		}
+		entries.clear();
+	}
+
+	// copies the pipelines of the variant, false while they compile (the first call queues the compilation)
+	bool get(const Variant& variant, Pipelines& pipelines) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (Entry* entry = find(variant)) {
+			if (entry->state == FAILED) throw std::runtime_error(entry->error);
+			if (entry->state == READY) pipelines = entry->pipelines;
+			return entry->state == READY;
+		}
+
+		Entry entry;
+		entry.variant = variant;
+		entry.requested = std::chrono::steady_clock::now();
+		entries.push_back(entry);
+		jobs.push_back(entries.size() - 1);
+		condition.notify_one();
+		return false;
+	}
+
+	// blocking get(), for the first variant when there is nothing to fall back to
+	Pipelines wait(const Variant& variant) {
+		Pipelines pipelines = {};
+		if (get(variant, pipelines)) return pipelines;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			idle.wait(lock, [&]() { return find(variant)->state != COMPILING; });
+		}
+		get(variant, pipelines);
+		return pipelines;
+	}
+
+	// no compilation queued or running
+	void waitIdle() {
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this]() { return jobs.empty() && busy_workers == 0; });
+	}
+
+	// milliseconds from the first get() of the variant to its pipelines being ready (0 until then)
+	double latencyMs(const Variant& variant) {
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry* entry = find(variant);
+		return entry != nullptr && entry->state == READY ? entry->latency_ms : 0.0;
+	}
+
+	// contents of the cache to save for the next run
+	std::vector<char> cacheData() const {
+		size_t size = 0;
+		vkGetPipelineCacheData(device, cache, &size, nullptr);
+
+		std::vector<char> data(size);
+		if (size > 0) vkGetPipelineCacheData(device, cache, &size, data.data());
+		data.resize(size);
+		return data;
+	}
+
+	VkPipelineCache pipelineCache() const { return cache; }
+
+private:
+
+	enum State { COMPILING, READY, FAILED };
+
+	struct Entry {
+		Variant variant;
+		State state = COMPILING;
+		Pipelines pipelines = {};
+		std::string error;
+		std::chrono::steady_clock::time_point requested;
+		double latency_ms = 0.0;
+	};
+
+	// the caller holds mutex
+	Entry* find(const Variant& variant) {
+		for (auto& entry : entries) {
+			if (entry.variant == variant) return &entry;
+		}
+		return nullptr;
+	}
+
+	void workerLoop() {
+		while (true) {
+			size_t index;
+			Variant variant;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return !running || !jobs.empty(); });
+				if (!running) return;
+				index = jobs.front();
+				jobs.pop_front();
+				variant = entries[index].variant;
+				busy_workers++;
+			}
+
+			Pipelines pipelines = {};
+			std::string error;
+			try {
+				pipelines = builder(variant, cache);
+			}
+			catch (const std::exception& e) {
+				error = e.what();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Entry& entry = entries[index];
+				entry.pipelines = pipelines;
+				entry.error = error;
+				entry.state = error.empty() ? READY : FAILED;
+				entry.latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - entry.requested).count();
+				busy_workers--;
+			}
+			idle.notify_all();
+		}
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE; // internally synchronized, shared by all the workers
+	Builder builder;
+	Destroyer destroyer;
+
+	std::vector<Entry> entries; // guarded by mutex, indices stay valid until clear()
+	std::deque<size_t> jobs;
+	uint32_t busy_workers = 0;
+	bool running = false;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable condition; // a job was queued
+	std::condition_variable idle;      // a job finished
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+// how a pass (or the outside of the graph) uses a resource : layout is VK_IMAGE_LAYOUT_UNDEFINED for buffers
+struct ResourceUsage {
+	VkPipelineStageFlags stage;
+	VkAccessFlags access;
+	VkImageLayout layout;
+};
+
+// the passes recorded into one command buffer, declared with the resources they read and write
+// compile() drops the passes no exported resource depends on, execute() records the others in order with the
+// barriers between them : one vkCmdPipelineBarrier in front of a pass (all of its hazards batched), none when
+// the pass only reads what is already visible to it, an execution dependency only for write after read.
+// render passes keep the layouts of their attachments (initialLayout == finalLayout), every transition is here.
+class RenderGraph {
+
+public:
+
+	typedef uint32_t Resource;
+
+	// initial : the last use before this command buffer (what the submit already waits for, or the previous frame),
+	// stage 0 when nothing on the device has to be waited for
+	Resource importImage(VkImage image, VkImageAspectFlags aspect, ResourceUsage initial) {
+		return addResource(image, VK_NULL_HANDLE, aspect, initial);
+	}
+
+	Resource importBuffer(VkBuffer buffer, ResourceUsage initial) {
+		return addResource(VK_NULL_HANDLE, buffer, 0, initial);
+	}
+
+	// the resource is left in this state for whoever uses it after the command buffer, and keeps its writers
+	void exportResource(Resource resource, ResourceUsage final) {
+		resources[resource].exported = true;
+		resources[resource].final = final;
+	}
+
+	uint32_t addPass(const char* name, std::function<void(VkCommandBuffer)> record) {
+		passes.push_back({ name, record, {}, false });
+		return static_cast<uint32_t>(passes.size() - 1);
+	}
+
+	void read(uint32_t pass, Resource resource, ResourceUsage usage) {
+		use(pass, resource, usage, false);
+	}
+
+	void write(uint32_t pass, Resource resource, ResourceUsage usage) {
+		use(pass, resource, usage, true);
+	}
+
+	// walk back from the exports : a pass is live when a later live pass reads or an export keeps what it writes
+	void compile() {
+		std::vector<bool> needed(resources.size(), false);
+		for (size_t r = 0; r < resources.size(); r++) needed[r] = resources[r].exported;
+
+		for (size_t p = passes.size(); p > 0; p--) {
+			Pass& pass = passes[p - 1];
+			pass.live = false;
+			for (const Use& use : pass.uses) {
+				if (use.write && needed[use.resource]) pass.live = true;
+			}
+			if (!pass.live) continue;
+
+			for (const Use& use : pass.uses) {
+				if (use.read) needed[use.resource] = true;
+			}
+		}
+	}
+
+	void execute(VkCommandBuffer commandBuffer) {
+		barrier_count = 0;
+		std::vector<State> states(resources.size());
+		for (size_t r = 0; r < resources.size(); r++) states[r] = initialState(resources[r].initial);
+
+		for (const Pass& pass : passes) {
+			if (!pass.live) continue;
+
+			Batch batch;
+			for (const Use& use : pass.uses) transition(use.resource, use.usage, states[use.resource], batch);
+			flush(commandBuffer, batch);
+
+			pass.record(commandBuffer);
+		}
+
+		Batch batch;
+		for (size_t r = 0; r < resources.size(); r++) {
+			if (resources[r].exported) transition(static_cast<Resource>(r), resources[r].final, states[r], batch);
+		}
+		flush(commandBuffer, batch);
+	}
+
+	uint32_t livePassCount() const {
+		uint32_t count = 0;
+		for (const Pass& pass : passes) count += pass.live ? 1 : 0;
+		return count;
+	}
+
+	// vkCmdPipelineBarrier calls of the last execute()
+	uint32_t barrierCount() const { return barrier_count; }
+
+private:
+
+	static const VkAccessFlags WRITE_ACCESS =
+		VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	struct ResourceInfo {
+		VkImage image;
+		VkBuffer buffer;
+		VkImageAspectFlags aspect;
+		ResourceUsage initial;
+		ResourceUsage final;
+		bool exported;
+	};
+
+	struct Use {
+		Resource resource;
+		ResourceUsage usage;
+		bool read, write;
+	};
+
+	struct Pass {
+		const char* name;
+		std::function<void(VkCommandBuffer)> record;
+		std::vector<Use> uses;
+		bool live;
+	};
+
+	// what the next use of a resource has to wait for
+	struct State {
+		VkImageLayout layout;
+		bool written;                   // a write (or layout transition) the next accesses must see
+		VkPipelineStageFlags write_stage;
+		VkAccessFlags write_access;     // to make available, 0 once a transition has done it
+		VkAccessFlags visible;          // accesses the last write is visible to
+		VkPipelineStageFlags read_stages; // readers since the last write (write after read waits for them)
+	};
+
+	// the barriers in front of one pass
+	struct Batch {
+		VkPipelineStageFlags src_stages = 0, dst_stages = 0;
+		VkAccessFlags src_access = 0, dst_access = 0; // one global memory barrier for every layout preserving hazard
+		std::vector<VkImageMemoryBarrier> images;
+	};
+
+	Resource addResource(VkImage image, VkBuffer buffer, VkImageAspectFlags aspect, ResourceUsage initial) {
+		resources.push_back({ image, buffer, aspect, initial, initial, false });
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	// several uses of a resource in one pass are one use with the stages and accesses of all of them
+	void use(uint32_t pass, Resource resource, ResourceUsage usage, bool write) {
+		for (Use& other : passes[pass].uses) {
+			if (other.resource != resource) continue;
+			if (other.usage.layout != usage.layout) throw std::runtime_error("render graph pass uses an image in two layouts!");
+			other.usage.stage |= usage.stage;
+			other.usage.access |= usage.access;
+			other.read = other.read || !write;
+			other.write = other.write || write;
+			return;
+		}
+		passes[pass].uses.push_back({ resource, usage, !write, write });
+	}
+
+	static State initialState(const ResourceUsage& initial) {
+		State state = {};
+		state.layout = initial.layout;
+		state.written = (initial.access & WRITE_ACCESS) != 0;
+		state.write_stage = initial.stage;
+		state.write_access = initial.access & WRITE_ACCESS;
+		state.visible = state.written ? 0 : initial.access;
+		state.read_stages = state.written ? 0 : initial.stage;
+		return state;
+	}
+
+	void transition(Resource resource, const ResourceUsage& usage, State& state, Batch& batch) {
+		const ResourceInfo& info = resources[resource];
+		bool writes = (usage.access & WRITE_ACCESS) != 0;
+
+		if (info.image != VK_NULL_HANDLE && usage.layout != state.layout) {
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = state.write_access;
+			barrier.dstAccessMask = usage.access;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = usage.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = info.image;
+			barrier.subresourceRange.aspectMask = info.aspect;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			batch.images.push_back(barrier);
+			batch.src_stages |= state.write_stage | state.read_stages;
+			batch.dst_stages |= usage.stage;
+
+			// the transition is a write of its own, visible to this use only
+			state.layout = usage.layout;
+			state.written = true;
+			state.write_stage = usage.stage;
+			state.write_access = 0;
+			state.visible = usage.access;
+			state.read_stages = 0;
+		}
+		else if (state.written && (usage.access & ~state.visible) != 0) {
+			batch.src_stages |= state.write_stage | (writes ? state.read_stages : 0);
+			batch.dst_stages |= usage.stage;
+			batch.src_access |= state.write_access;
+			batch.dst_access |= usage.access;
+			state.visible |= usage.access;
+		}
+		else if (writes && state.read_stages != 0) {
+			batch.src_stages |= state.read_stages;
+			batch.dst_stages |= usage.stage;
+		}
+
+		if (writes) {
+			state.written = true;
+			state.write_stage = usage.stage;
+			state.write_access = usage.access & WRITE_ACCESS;
+			state.visible = 0;
+			state.read_stages = 0;
+		}
+		else {
+			state.read_stages |= usage.stage;
+		}
+	}
+
+	void flush(VkCommandBuffer commandBuffer, Batch& batch) {
+		if (batch.dst_stages == 0) return;
+
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = batch.src_access;
+		memoryBarrier.dstAccessMask = batch.dst_access;
+		uint32_t memoryBarrierCount = batch.dst_access != 0 ? 1 : 0;
+
+		vkCmdPipelineBarrier(commandBuffer, batch.src_stages != 0 ? batch.src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, batch.dst_stages, 0,
+			memoryBarrierCount, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(batch.images.size()), batch.images.data());
+		barrier_count++;
+	}
+
+	std::vector<ResourceInfo> resources;
+	std::vector<Pass> passes;
+	uint32_t barrier_count = 0;
+};
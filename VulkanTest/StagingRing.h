@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// a sub-allocation of the staging ring : copy into data, then record a copy from buffer at offset
+struct StagingAllocation {
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	uint8_t* data;
+};
+
+// one persistently mapped staging buffer shared by every upload
+// allocations are carved out of the ring in order, and the ones made since the last submitFence() retire together
+// once that fence signals (the transfer queue has read them). a full ring waits for its oldest submission,
+// which finishes on its own, so this also works during initialization before any frame is submitted.
+class StagingRing {
+
+public:
+
+	// buffer : TRANSFER_SRC, host visible and coherent memory of capacity bytes (owned by the ring from here on)
+	void create(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize capacity) {
+		this->device = device;
+		this->buffer = buffer;
+		this->memory = memory;
+		this->capacity = capacity;
+
+		void* data;
+		vkMapMemory(device, memory, 0, capacity, 0, &data);
+		mapped = static_cast<uint8_t*>(data);
+	}
+
+	// every submission must be complete
+	void destroy() {
+		for (auto& region : regions) freeFence(region.fence);
+		regions.clear();
+		for (auto fence : free_fences) vkDestroyFence(device, fence, nullptr);
+		free_fences.clear();
+
+		vkUnmapMemory(device, memory);
+		vkDestroyBuffer(device, buffer, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+	// false when size does not fit even into the empty ring, or the ring is full of allocations not submitted yet
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& allocation) {
+		if (size > capacity) return false;
+
+		retire(false);
+		VkDeviceSize offset;
+		while (!findSpace(size, alignment, offset)) {
+			if (regions.empty()) return false; // only open allocations left
+			retire(true);
+		}
+
+		head = offset + size;
+		open = true;
+		allocation = { buffer, offset, mapped + offset };
+		return true;
+	}
+
+	// the fence to signal with the submission that reads the allocations made since the last call
+	// (VK_NULL_HANDLE when there are none)
+	VkFence submitFence() {
+		if (!open) return VK_NULL_HANDLE;
+
+		VkFence fence;
+		if (!free_fences.empty()) {
+			fence = free_fences.back();
+			free_fences.pop_back();
+		}
+		else {
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			vkCreateFence(device, &fenceInfo, nullptr, &fence);
+		}
+
+		regions.push_back({ head, fence });
+		open = false;
+		return fence;
+	}
+
+	VkDeviceSize usedBytes() const {
+		if (regions.empty() && !open) return 0;
+		return head > tail ? head - tail : capacity - tail + head;
+	}
+
+private:
+
+	struct Region {
+		VkDeviceSize end;  // the region runs from the end of the previous one (or 0 after a wrap)
+		VkFence fence;
+	};
+
+	bool findSpace(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+		if (regions.empty() && !open) {
+			head = tail = 0;
+		}
+
+		offset = (head + alignment - 1) / alignment * alignment;
+		if (head > tail || (regions.empty() && !open)) {
+			if (offset + size <= capacity) return true;
+			offset = 0; // wrap, the end of the buffer stays unused this lap
+			return size <= tail;
+		}
+		return offset + size <= tail;
+	}
+
+	// release the regions the transfer queue is done with, blocking on the oldest one when wait is set
+	void retire(bool wait) {
+		if (wait && !regions.empty()) {
+			vkWaitForFences(device, 1, &regions.front().fence, VK_TRUE, UINT64_MAX);
+		}
+		while (!regions.empty() && vkGetFenceStatus(device, regions.front().fence) == VK_SUCCESS) {
+			tail = regions.front().end;
+			freeFence(regions.front().fence);
+			regions.pop_front();
+		}
+	}
+
+	void freeFence(VkFence fence) {
+		vkResetFences(device, 1, &fence);
+		free_fences.push_back(fence);
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize capacity = 0;
+	uint8_t* mapped = nullptr;
+
+	VkDeviceSize head = 0;    // end of the newest allocation
+	VkDeviceSize tail = 0;    // start of the oldest allocation in use
+	bool open = false;        // allocations since the last submitFence()
+	std::deque<Region> regions;
+	std::vector<VkFence> free_fences;
+};
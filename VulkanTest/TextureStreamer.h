@@ -0,0 +1,455 @@
+#pragma once
+
+// no std::min/max here : cgmath.h defines them as macros
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// RGBA8 mip chain, levels[0] is the largest one
+struct TextureMipChain {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<std::vector<uint8_t>> levels;
+
+	size_t bytes() const {
+		size_t total = 0;
+		for (auto& level : levels) total += level.size();
+		return total;
+	}
+};
+
+// 2x2 box filter (an odd edge is clamped)
+inline void downsampleRGBA(const std::vector<uint8_t>& src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst, uint32_t& dst_width, uint32_t& dst_height) {
+	dst_width = width > 1 ? width / 2 : 1;
+	dst_height = height > 1 ? height / 2 : 1;
+	dst.resize(size_t(dst_width) * dst_height * 4);
+
+	for (uint32_t y = 0; y < dst_height; y++) {
+		uint32_t y0 = y * 2 < height ? y * 2 : height - 1;
+		uint32_t y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+		for (uint32_t x = 0; x < dst_width; x++) {
+			uint32_t x0 = x * 2 < width ? x * 2 : width - 1;
+			uint32_t x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+			for (uint32_t c = 0; c < 4; c++) {
+				uint32_t sum = src[(size_t(y0) * width + x0) * 4 + c] + src[(size_t(y0) * width + x1) * 4 + c]
+					+ src[(size_t(y1) * width + x0) * 4 + c] + src[(size_t(y1) * width + x1) * 4 + c];
+				dst[(size_t(y) * dst_width + x) * 4 + c] = uint8_t((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+// mips first_level .. 1x1 of a full resolution image
+inline TextureMipChain buildMipChain(std::vector<uint8_t> pixels, uint32_t width, uint32_t height, uint32_t first_level) {
+	TextureMipChain chain;
+	std::vector<uint8_t> next;
+	uint32_t next_width, next_height;
+
+	for (uint32_t level = 0; ; level++) {
+		if (level == first_level) {
+			chain.width = width;
+			chain.height = height;
+		}
+		if (level >= first_level) chain.levels.push_back(pixels);
+		if (width == 1 && height == 1) break;
+
+		downsampleRGBA(pixels, width, height, next, next_width, next_height);
+		pixels.swap(next);
+		width = next_width;
+		height = next_height;
+	}
+	return chain;
+}
+
+// bytes of the mips level .. 1x1
+inline size_t mipChainBytes(uint32_t width, uint32_t height, uint32_t level) {
+	size_t total = 0;
+	for (uint32_t i = 0; ; i++) {
+		if (i >= level) total += size_t(width) * height * 4;
+		if (width == 1 && height == 1) break;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return total;
+}
+
+// number of levels down to 1x1
+inline uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+	uint32_t count = 1;
+	for (; width > 1 || height > 1; count++) {
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return count;
+}
+
+// pre-built mip chain of an image : <image>.ktx next to it (KTX 1.1, RGBA8, every level down to 1x1, finest first)
+// written offline (--build-mips), then read from the first level a load asks for : the finer levels are skipped, not decoded
+inline std::string mipFilePath(const std::string& file) { return file + ".ktx"; }
+
+static const uint8_t KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// the fields after the identifier
+struct KtxHeader {
+	uint32_t endianness, gl_type, gl_type_size, gl_format, gl_internal_format, gl_base_internal_format;
+	uint32_t width, height, depth, array_elements, faces, mip_levels, key_value_bytes;
+};
+
+// every level of chain (level 0 first), srgb for the colour textures
+inline bool writeMipFile(const std::string& path, const TextureMipChain& chain, bool srgb) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) return false;
+
+	// GL_UNSIGNED_BYTE, GL_RGBA, GL_SRGB8_ALPHA8 or GL_RGBA8
+	KtxHeader header = { 0x04030201, 0x1401, 1, 0x1908, srgb ? 0x8C43u : 0x8058u, 0x1908, chain.width, chain.height, 0, 0, 1, static_cast<uint32_t>(chain.levels.size()), 0 };
+	file.write(reinterpret_cast<const char*>(KTX_IDENTIFIER), sizeof(KTX_IDENTIFIER));
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (auto& level : chain.levels) {
+		uint32_t size = static_cast<uint32_t>(level.size()); // RGBA8 rows and levels need no padding
+		file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		file.write(reinterpret_cast<const char*>(level.data()), level.size());
+	}
+	return bool(file);
+}
+
+// the header of a mip file this reader understands (the file is left at level 0)
+inline bool readMipFileHeader(std::ifstream& file, KtxHeader& header) {
+	uint8_t identifier[sizeof(KTX_IDENTIFIER)];
+	if (!file.read(reinterpret_cast<char*>(identifier), sizeof(identifier)) || memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0) return false;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+	if (header.endianness != 0x04030201 || header.gl_type != 0x1401 || header.gl_format != 0x1908 || header.depth > 1 || header.array_elements > 0 || header.faces != 1) return false;
+	if (header.width == 0 || header.height == 0 || header.mip_levels != mipLevelCount(header.width, header.height)) return false;
+	return bool(file.seekg(header.key_value_bytes, std::ios::cur));
+}
+
+// size of level 0 of a mip file
+inline bool readMipFileSize(const std::string& path, uint32_t& width, uint32_t& height) {
+	std::ifstream file(path, std::ios::binary);
+	KtxHeader header;
+	if (!file || !readMipFileHeader(file, header)) return false;
+	width = header.width;
+	height = header.height;
+	return true;
+}
+
+// levels first_level .. 1x1 of a mip file, the finer levels are seeked over
+inline bool readMipFile(const std::string& path, uint32_t first_level, TextureMipChain& chain) {
+	std::ifstream file(path, std::ios::binary);
+	KtxHeader header;
+	if (!file || !readMipFileHeader(file, header) || first_level >= header.mip_levels) return false;
+
+	chain = TextureMipChain();
+	for (uint32_t level = 0; level < header.mip_levels; level++) {
+		uint32_t width = header.width >> level > 0 ? header.width >> level : 1;
+		uint32_t height = header.height >> level > 0 ? header.height >> level : 1;
+		uint32_t size;
+		if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) || size != size_t(width) * height * 4) return false;
+
+		if (level < first_level) {
+			file.seekg(size, std::ios::cur);
+			continue;
+		}
+		if (level == first_level) {
+			chain.width = width;
+			chain.height = height;
+		}
+		chain.levels.emplace_back(size);
+		if (!file.read(reinterpret_cast<char*>(chain.levels.back().data()), size)) return false;
+	}
+	return true;
+}
+
+// residency of the planet textures, by their on-screen size
+// every texture keeps a small base mip chain. finer levels are decoded on a background thread when a body needs
+// more texels than are resident, and textures that are small on screen are dropped back to coarser levels
+// whenever the resident bytes would exceed the budget (the colour, alpha, normal and bump maps share it). the owner uploads the finished chains and drops the
+// evicted levels of its images (poll()) : an eviction is never a load.
+// the loader keeps the chains it decoded (up to the budget again), so a texture coming back is not decoded twice.
+class TextureStreamer {
+
+public:
+
+	// levels level .. 1x1 of an image file as RGBA8 (called on the loader thread)
+	using Loader = std::function<bool(const std::string& file, uint32_t level, TextureMipChain& chain)>;
+
+	// a finished load (chain.levels from level to 1x1), or a drop : the resident image keeps only its levels from level
+	// (chain.width and chain.height are the size of that level, chain.levels is empty)
+	struct Result {
+		uint32_t texture;
+		uint32_t level;
+		TextureMipChain chain;
+		bool drop = false;
+	};
+
+	static const uint32_t BASE_SIZE = 256;       // the resident floor : largest side of the base level
+	static const uint32_t MAX_PENDING_LOADS = 2;
+
+	void start(Loader loader, size_t budget_bytes) {
+		this->loader = loader;
+		this->budget_bytes = budget_bytes;
+		running = true;
+		worker = std::thread([this]() { workerLoop(); });
+	}
+
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+			jobs.clear();
+		}
+		condition.notify_all();
+		if (worker.joinable()) worker.join();
+	}
+
+	// register a texture, resident at level (returns its streaming index)
+	uint32_t add(const std::string& file, uint32_t width, uint32_t height, uint32_t level) {
+		Texture texture;
+		texture.file = file;
+		texture.width = width;
+		texture.height = height;
+		texture.base_level = baseLevel(width, height);
+		texture.resident_level = level;
+		texture.target_level = level;
+		textures.push_back(texture);
+		return static_cast<uint32_t>(textures.size() - 1);
+	}
+
+	static uint32_t baseLevel(uint32_t width, uint32_t height) {
+		uint32_t level = 0;
+		while ((width >> level) > BASE_SIZE || (height >> level) > BASE_SIZE) level++;
+		return level;
+	}
+
+	// texels the texture should have across its width this frame (the largest request wins)
+	void request(uint32_t texture, float texels) {
+		if (texels > textures[texture].demand) textures[texture].demand = texels;
+	}
+
+	// pick the loads (and evictions) of this frame, then clear the requests
+	void update() {
+		for (auto& texture : textures) texture.desired_level = desiredLevel(texture);
+
+		// the most starved texture first : fewest resident texels per requested texel
+		std::vector<uint32_t> order;
+		for (uint32_t i = 0; i < textures.size(); i++) {
+			if (textures[i].desired_level < textures[i].target_level) order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return starvation(textures[a]) > starvation(textures[b]); });
+
+		for (uint32_t i : order) {
+			if (pending_loads >= MAX_PENDING_LOADS) break;
+			Texture& texture = textures[i];
+
+			size_t extra = mipChainBytes(texture.width, texture.height, texture.desired_level) - mipChainBytes(texture.width, texture.height, texture.target_level);
+			if (targetBytes() + extra > budget_bytes && !evict(extra, i)) continue;
+			schedule(i, texture.desired_level);
+		}
+
+		for (auto& texture : textures) texture.demand = 0.0f;
+	}
+
+	// a finished chain to upload or levels to drop, the texture is resident at result.level afterwards
+	bool poll(Result& result) {
+		if (!drops.empty()) {
+			result = std::move(drops.front());
+			drops.pop_front();
+			return true;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!results.empty()) {
+			result = std::move(results.front());
+			results.pop_front();
+			pending_loads--;
+
+			// the file could not be decoded : keep what is resident
+			if (result.chain.levels.empty()) {
+				textures[result.texture].target_level = textures[result.texture].resident_level;
+				continue;
+			}
+
+			textures[result.texture].resident_level = result.level;
+			return true;
+		}
+		return false;
+	}
+
+	size_t residentBytes() const {
+		size_t total = 0;
+		for (auto& texture : textures) total += mipChainBytes(texture.width, texture.height, texture.resident_level);
+		return total;
+	}
+
+	size_t budgetBytes() const { return budget_bytes; }
+
+private:
+
+	struct Texture {
+		std::string file;
+		uint32_t width = 0, height = 0;
+		uint32_t base_level = 0;
+		uint32_t resident_level = 0;  // uploaded now
+		uint32_t target_level = 0;    // resident, or being loaded
+		uint32_t desired_level = 0;
+		float demand = 0.0f;
+	};
+
+	uint32_t desiredLevel(const Texture& texture) const {
+		uint32_t level = texture.base_level;
+		while (level > 0 && float(texture.width >> level) < texture.demand) level--;
+		return level;
+	}
+
+	float starvation(const Texture& texture) const {
+		uint32_t width = texture.width >> texture.target_level;
+		return texture.demand / float(width > 0 ? width : 1);
+	}
+
+	size_t targetBytes() const {
+		size_t total = 0;
+		for (auto& texture : textures) total += mipChainBytes(texture.width, texture.height, texture.target_level);
+		return total;
+	}
+
+	// drop the least needed textures to coarser levels until extra bytes fit, never the one being loaded
+	// (only textures without a load in flight : the drop applies to the resident image right away)
+	bool evict(size_t extra, uint32_t keep) {
+		std::vector<uint32_t> candidates;
+		for (uint32_t i = 0; i < textures.size(); i++) {
+			if (i != keep && textures[i].target_level < textures[i].base_level && textures[i].target_level == textures[i].resident_level) candidates.push_back(i);
+		}
+		std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) { return starvation(textures[a]) < starvation(textures[b]); });
+
+		size_t total = targetBytes();
+		std::vector<std::pair<uint32_t, uint32_t>> evictions;
+		for (uint32_t i : candidates) {
+			if (total + extra <= budget_bytes) break;
+			Texture& texture = textures[i];
+			uint32_t level = texture.desired_level > texture.target_level ? texture.desired_level : texture.target_level + 1;
+			total -= mipChainBytes(texture.width, texture.height, texture.target_level) - mipChainBytes(texture.width, texture.height, level);
+			evictions.push_back({ i, level });
+		}
+		if (total + extra > budget_bytes) return false;
+
+		for (auto& eviction : evictions) drop(eviction.first, eviction.second);
+		return true;
+	}
+
+	void drop(uint32_t texture, uint32_t level) {
+		textures[texture].target_level = level;
+		textures[texture].resident_level = level;
+
+		Result result;
+		result.texture = texture;
+		result.level = level;
+		result.chain.width = textures[texture].width >> level > 0 ? textures[texture].width >> level : 1;
+		result.chain.height = textures[texture].height >> level > 0 ? textures[texture].height >> level : 1;
+		result.drop = true;
+		drops.push_back(std::move(result));
+	}
+
+	void schedule(uint32_t texture, uint32_t level) {
+		textures[texture].target_level = level;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back({ texture, level, textures[texture].file });
+			pending_loads++;
+		}
+		condition.notify_one();
+	}
+
+	struct Job {
+		uint32_t texture;
+		uint32_t level;
+		std::string file;
+	};
+
+	void workerLoop() {
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return !running || !jobs.empty(); });
+				if (!running) return;
+				job = jobs.front();
+				jobs.pop_front();
+			}
+
+			Result result;
+			result.texture = job.texture;
+			result.level = job.level;
+
+			if (decoded.size() <= job.texture) decoded.resize(job.texture + 1);
+			Decoded& cached = decoded[job.texture];
+			if (cached.chain.levels.empty() || cached.level > job.level) {
+				TextureMipChain chain;
+				if (loader(job.file, job.level, chain)) {
+					cached.chain = std::move(chain);
+					cached.level = job.level;
+				}
+			}
+
+			// the cached chain may start finer than the job asks for
+			if (!cached.chain.levels.empty() && cached.level <= job.level) {
+				uint32_t skip = job.level - cached.level;
+				result.chain.width = cached.chain.width >> skip > 0 ? cached.chain.width >> skip : 1;
+				result.chain.height = cached.chain.height >> skip > 0 ? cached.chain.height >> skip : 1;
+				result.chain.levels.assign(cached.chain.levels.begin() + skip, cached.chain.levels.end());
+			}
+			trimDecoded();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			results.push_back(std::move(result));
+		}
+	}
+
+	// decoded chains of the loader thread
+	struct Decoded {
+		uint32_t level = 0;
+		TextureMipChain chain;
+	};
+
+	// keep the decoded chains within the budget : the finest level of the largest chain goes first
+	void trimDecoded() {
+		size_t total = 0;
+		for (auto& cached : decoded) total += cached.chain.bytes();
+
+		while (total > budget_bytes) {
+			Decoded* largest = nullptr;
+			for (size_t i = 0; i < decoded.size(); i++) {
+				if (decoded[i].chain.levels.empty()) continue;
+				if (largest == nullptr || decoded[i].chain.levels.front().size() > largest->chain.levels.front().size()) largest = &decoded[i];
+			}
+			if (largest == nullptr) return;
+
+			total -= largest->chain.levels.front().size();
+			largest->chain.levels.erase(largest->chain.levels.begin());
+			largest->chain.width = largest->chain.width > 1 ? largest->chain.width / 2 : 1;
+			largest->chain.height = largest->chain.height > 1 ? largest->chain.height / 2 : 1;
+			largest->level++;
+		}
+	}
+
+	std::vector<Texture> textures;  // main thread only
+	size_t budget_bytes = 0;
+	uint32_t pending_loads = 0;     // scheduled, not polled yet (drops are not loads)
+	std::deque<Result> drops;       // main thread only
+	std::vector<Decoded> decoded;   // loader thread only
+
+	Loader loader;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool running = false;
+	std::deque<Job> jobs;
+	std::deque<Result> results;
+};
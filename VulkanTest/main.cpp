@@ -5,9 +5,13 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#undef STB_IMAGE_WRITE_IMPLEMENTATION // FrameCapture.h includes it again for the declarations
 
 #include <vulkan/vulkan.h>
 
@@ -22,14 +26,33 @@
 #include <optional>
 #include <set>
 #include <array>
-
-#include "cgmath.h"
-#include "Planet.h"
-#include "Trackball.h"
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+#include "../common/cgmath.h"		// shared with trackball
+#include "../common/SolarSystem.h"	// the scene shared with trackball
+#include "../common/Trackball.h"	// the camera of trackball, on cgmath
+#include "MeshOptimizer.h"
+#include "FrameScheduler.h"
+#include "GpuTiming.h"
+#include "BodyRegistry.h"
+#include "TextureStreamer.h"
+#include "PipelineManager.h"
+#include "../common/RenderQueue.h"
+#include "FrameCapture.h"
+#include "StagingRing.h"
+#include "BodyBvh.h"
+#include "InputQueue.h"
+#include "RenderGraph.h"
 
 ivec2 window_size = ivec2(1280, 720); // initial window size
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const int MAX_FRAMES_IN_FLIGHT = 3; // upper bound of framesInFlight
 
 // Layer
 const std::vector<const char*> validationLayers = {
@@ -72,6 +95,8 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily; // transfer-only family if the device has one, otherwise the graphics family
+	std::optional<uint32_t> computeFamily;  // compute family without graphics (async compute) if any, otherwise the graphics family
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -124,6 +149,107 @@ struct Vertex {
 	}
 };
 
+// Quantized vertex formats
+// meshes are unit sized (scale goes into the model matrix), so positions fit into snorm16
+
+enum VertexFormat {
+	VERTEX_FORMAT_FULL = 0,   // Vertex         : 32 bytes
+	VERTEX_FORMAT_PACKED,     // PackedVertex   : 16 bytes
+	VERTEX_FORMAT_POSITION,   // PositionVertex :  8 bytes
+	VERTEX_FORMAT_COUNT
+};
+
+static const char* vertex_format_name[VERTEX_FORMAT_COUNT] = { "full (32 bytes)", "packed (16 bytes)", "position-only (8 bytes)" };
+
+inline int16_t packSnorm16(float v) { return int16_t(roundf(clamp(v, -1.0f, 1.0f) * 32767.0f)); }
+inline uint16_t packUnorm16(float v) { return uint16_t(roundf(clamp(v, 0.0f, 1.0f) * 65535.0f)); }
+
+// octahedral normal encoding : unit vector -> [-1,1]^2
+inline glm::vec2 octEncode(glm::vec3 n) {
+	n /= (fabs(n.x) + fabs(n.y) + fabs(n.z));
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f) {
+		e.x = (1.0f - fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		e.y = (1.0f - fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+// snorm16 position, octahedral snorm16 normal, unorm16 texcoord
+struct PackedVertex {
+	int16_t pos[4];       // w is padding (3-component 16-bit formats are not widely supported for vertex fetch)
+	int16_t norm[2];
+	uint16_t texCoord[2];
+
+	static PackedVertex pack(const Vertex& v) {
+		glm::vec2 n = octEncode(glm::length(v.norm) > 0.0f ? glm::normalize(v.norm) : glm::vec3(0.0f, 0.0f, 1.0f));
+		return { { packSnorm16(v.pos.x), packSnorm16(v.pos.y), packSnorm16(v.pos.z), 0 },
+				 { packSnorm16(n.x), packSnorm16(n.y) },
+				 { packUnorm16(v.texCoord.x), packUnorm16(v.texCoord.y) } };
+	}
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(PackedVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+		attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+		attributeDescriptions[1].offset = offsetof(PackedVertex, norm);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R16G16_UNORM;
+		attributeDescriptions[2].offset = offsetof(PackedVertex, texCoord);
+
+		return attributeDescriptions;
+	}
+};
+
+// snorm16 position with texcoord.x in w
+// the shader derives normal = position and texcoord.y = acos(z) / PI,
+// which matches the sphere exactly, and the ring (z = 0) whose texture only varies along x
+struct PositionVertex {
+	int16_t pos[4];
+
+	static PositionVertex pack(const Vertex& v) {
+		return { { packSnorm16(v.pos.x), packSnorm16(v.pos.y), packSnorm16(v.pos.z), packSnorm16(v.texCoord.x) } };
+	}
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(PositionVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 1> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 1> attributeDescriptions = {};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+		attributeDescriptions[0].offset = offsetof(PositionVertex, pos);
+
+		return attributeDescriptions;
+	}
+};
+
 struct CameraInfo {
 	glm::vec3 eye = { 0.0f, 100.0f, 20.0f };
 	glm::vec3 at = { 0.0f, 0.0f, 0.0f };
@@ -149,9 +275,72 @@ struct CameraInfo {
 	}
 };
 CameraInfo cameraInfo;
+
+// Input latency
+// trackball input to the return of the vkQueuePresentKHR call of the first frame that shows it, statistics of the frame
+// rate period. The GPU work and the wait for the display come after that : it is not the time until the image is seen.
+struct LatencyInfo {
+	size_t count = 0;
+	float sum_ms = 0.0f;
+	float max_ms = 0.0f;
+};
+LatencyInfo latencyInfo;
+
+// Input : the GLFW callbacks run on the window thread, the render thread only sees what they publish
+// keys, picks and resizes go through inputQueue, the camera the trackball moves through cameraInput
+struct InputEvent {
+	enum Type { KEY, PICK, RESIZE } type;
+	int key;
+	float x, y; // PICK : cursor, 0 .. 1 across the window / RESIZE : framebuffer size
+};
+struct CameraInput {
+	glm::mat4 viewMatrix;
+	std::chrono::steady_clock::time_point inputTime; // the oldest input the render thread has not taken yet
+};
+InputQueue<InputEvent, 256> inputQueue;
+TripleBuffer<CameraInput> cameraInput;
+std::atomic<uint64_t> cameraInputTaken{ 0 };        // the version the render thread took last
+
+// window thread only
+// the trackball works on cgmath (row-major), the camera is glm (column-major) : the same matrix, transposed in memory
 Trackball trackball;
+inline mat4 toCgmath(const glm::mat4& m) { mat4 r; memcpy(r.a, glm::value_ptr(glm::transpose(m)), sizeof(r.a)); return r; }
+inline glm::mat4 toGlm(const mat4& m) { return glm::transpose(glm::make_mat4(m.a)); }
+glm::mat4 inputViewMatrix = CameraInfo().viewMatrix; // the camera the trackball moves
+uint64_t cameraInputVersion = 0;                     // the version published last
+std::chrono::steady_clock::time_point cameraInputTime;
+dvec2 clickPosition;                // where the left button went down, releasing it there picks a body
+
+inline void publishCamera() {
+	if (cameraInputTaken.load(std::memory_order_acquire) == cameraInputVersion) cameraInputTime = std::chrono::steady_clock::now();
+	cameraInputVersion = cameraInput.write({ inputViewMatrix, cameraInputTime });
+}
 bool bWireframe = false;
-bool bShiftKeyPressed = false;
+VertexFormat vertexFormat = VERTEX_FORMAT_FULL;
+bool bProceduralSphere = false;
+bool bImpostor = true;
+
+// Frame pacing (keys or command line options)
+VkPresentModeKHR presentModePreference = VK_PRESENT_MODE_MAILBOX_KHR; // falls back to FIFO when not supported
+uint framesInFlight = 2;            // 1 .. MAX_FRAMES_IN_FLIGHT
+uint swapChainImageRequest = 0;     // 0 : minImageCount + 1
+bool bSimulateBeforeWait = false;   // throughput : simulate the next frame while the GPU is still busy
+bool bLatencyReport = false;        // input to present call latency of the trackball
+bool bAsyncCompute = true;          // culling and indirect arguments on the compute queue (on the CPU otherwise)
+bool bGpuTimingReport = false;      // how much of the compute time overlaps the graphics work
+bool bCapture = false;              // read back every presented frame and encode it on the capture thread
+CaptureWriter::Format captureFormat = CaptureWriter::FORMAT_PNG;
+size_t textureBudgetMB = 256;       // resident texture memory, finer mips are evicted above it
+bool bBuildMips = false;            // write the mip file of every texture image and exit
+
+// Simulation time (keys or command line options)
+double startTime = 0.0;             // simulation time of the first frame, seconds
+double timeScale = 1.0;             // simulation seconds per real second (0 : paused)
+double fixedTimeStep = 0.0;         // simulation seconds per frame for reproducible replays (0 : real time)
+bool bNullBackend = false;          // build and record every frame, acquire, submit and present nothing
+
+static const char* present_mode_name[] = { "immediate", "mailbox", "fifo", "fifo relaxed" }; // indexed by VkPresentModeKHR
+bool bShiftKeyPressed = false;     // window thread
 bool bCtrlKeyPressed = false;
 
 
@@ -177,96 +366,130 @@ struct UniformBufferObject {
 	// option
 	bool applyLight;
 
+	// simulation seconds, for the bodies animated in the vertex shader (shader_dynamic.vert)
+	float time;
+
+};
+
+// runtime body in the instance buffer, one per BodyRegistry slot (orbit evaluated in shader_dynamic.vert)
+// the phases are the angles at dynamicTimeOrigin, the shader gets the time since then
+struct DynamicBodyInstance {
+	glm::vec4 orbit; // distance, revolution speed (rad/s), phase, inclination
+	glm::vec4 body;  // radius, rotation speed (rad/s), alive, rotation phase
+};
+static const uint32_t MAX_DYNAMIC_BODIES = 65536;
+static const double DYNAMIC_TIME_SPAN = 1024.0; // seconds of float time (1e-4 s steps) before the phases move to a new origin
+static const uint32_t DYNAMIC_BODY_TESS = 12; // small bodies : 432 vertices each
+static const uint DYNAMIC_BODY_TEXTURE_INDEX = 9; // moon
+
+// textures of the renderer : the colour and alpha textures of SolarSystem.h, then the normal and the bump map of each
+// texSampler[BODY_TEXTURE_COUNT] of a body : colour, alpha, normal and bump map of the colour texture
+static const uint32_t NUM_TEXTURES = NUM_SOLAR_TEXTURES * 3;
+static const uint32_t BODY_TEXTURE_COUNT = 4;
+inline uint normalTexture(uint texture) { return NUM_SOLAR_TEXTURES + texture; }
+inline uint bumpTexture(uint texture) { return NUM_SOLAR_TEXTURES * 2 + texture; }
+
+
+
+// Indirect draw commands of a body, rewritten every frame so the command buffers can stay prerecorded
+// only one of mesh (or procedural) and impostor has instanceCount 1
+struct BodyDrawCommands {
+	VkDrawIndexedIndirectCommand mesh;
+	VkDrawIndirectCommand procedural;
+	VkDrawIndirectCommand impostor;
+};
+
+// input of shaders/shader_cull.comp, followed by the model matrix of every body
+struct CullingInput {
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::vec4 params;   // x : viewport height, y : impostor radius in pixels, z : impostors on
+	uint32_t counts[4]; // x : body count, y : mesh index count, z : procedural vertex count
+	glm::mat4 models[1];
 };
 
+static const double SEEK_SECONDS = 60.0;
+static const double CLICK_PIXELS = 3.0;        // cursor travel between press and release that still counts as a click
+static const float PICK_NEIGHBOR_RADII = 10.0f; // neighborhood reported for a picked body, in its radii
+static const float IMPOSTOR_RADIUS_PIXELS = 12.0f; // spheres smaller than this on screen are drawn as impostors
 
 
 // Vertices, Indices
 
 static const uint NUM_TESS = 72; // initial tessellation factor of the "sphere" as a "polyhedron"
 static const float RADIUS = 1.0f;
+uint procedural_tess = NUM_TESS; // tessellation factor of the buffer-less sphere (specialization constant)
 
-std::vector<Vertex> planet_vertex_list;
-std::vector<uint> planet_index_list;
-std::vector<Vertex>	ring_vertex_list;
-std::vector<uint> ring_index_list;
-
-void createVerticesAndIndices()
-{
-	/// 2(n-1)(n-1)
-	// Planet Vertex
-	// i : longitude, k : latitude
-	planet_vertex_list.clear();
-	for (uint i = 0; i <= NUM_TESS; i++) {
-
-		// t : theta - angle of longitude
-		float t = PI*2.0f / float(NUM_TESS) * float(i);
-
-		for (uint k = 0; k <= NUM_TESS / 2; k++) {
-
-			// p : pi - angle of latitude
-			float p = PI*2.0f / float(NUM_TESS) * float(k);
+// the settings baked into the graphics pipelines
+// the keys change the globals above, the pipelines follow once PipelineManager has compiled them
+struct PipelineVariant {
+	VertexFormat vertexFormat;
+	bool wireframe;
+	uint proceduralTess;
 
-			// position, texcoord
-			float x = RADIUS * sin(p) * cos(t), y = RADIUS * sin(p) * sin(t), z = RADIUS * cos(p);
-			float c1 = t / 2 / PI;
-			float c2 = p / PI;
-
-			planet_vertex_list.push_back({ {x, y, z}, {x, y, z}, {c1, c2} });
-		}
-	}
-
-	// Planet Index
-	planet_index_list.clear();
-	for (uint i = 0; i <= NUM_TESS + 1; i++) {
-		for (uint k = 0; k < NUM_TESS / 2; k++) {
-			planet_index_list.push_back(i * (NUM_TESS / 2) + k);
-			planet_index_list.push_back(i * (NUM_TESS / 2) + k + 1);
-			planet_index_list.push_back((i + 1) * (NUM_TESS / 2) + k + 1);
-
-			planet_index_list.push_back((i + 1) * (NUM_TESS / 2) + k + 1);
-			planet_index_list.push_back((i + 1) * (NUM_TESS / 2) + k);
-			planet_index_list.push_back(i * (NUM_TESS / 2) + k);
-		}
+	bool operator==(const PipelineVariant& other) const {
+		return vertexFormat == other.vertexFormat && wireframe == other.wireframe && proceduralTess == other.proceduralTess;
 	}
+	bool operator!=(const PipelineVariant& other) const { return !(*this == other); }
+};
 
-	// Ring Vertex
-	// i : longitude
-	ring_vertex_list.clear();
-	for (uint i = 0; i <= NUM_TESS; i++) {
-
-		// t : theta - angle of longitude
-		float t = PI*2.0f / float(NUM_TESS) * float(i);
+// fragment shader variant of the opaque bodies (specialization constant APPLY_LIGHT)
+enum Shading { SHADING_LIT, SHADING_UNLIT, SHADING_COUNT };
 
-		float x = RADIUS * cos(t), y = RADIUS * sin(t);
+struct PipelineSet {
+	VkPipeline graphics[SHADING_COUNT];
+	VkPipeline procedural[SHADING_COUNT]; // buffer-less sphere
+	VkPipeline dynamic;                   // runtime bodies, lit
+	VkPipeline impostor[SHADING_COUNT];   // ray-traced sphere on a quad
+	VkPipeline transparent;               // alpha-mapped bodies, lit and blending on
+};
 
-		ring_vertex_list.push_back({ {x * 1.0f, y * 1.0f, 0}, {x * 1.0f, y * 1.0f, 0}, {0, t} });
-		ring_vertex_list.push_back({ {x * 0.6f, y * 0.6f, 0}, {x * 0.6f, y * 0.6f, 0}, {1, t} });
-	}
+// DrawItem::pipeline of the render queue, in drawing order within a pass
+enum DrawPipeline {
+	DRAW_MESH = 0,                                  // + Shading
+	DRAW_PROCEDURAL = DRAW_MESH + SHADING_COUNT,    // + Shading
+	DRAW_DYNAMIC = DRAW_PROCEDURAL + SHADING_COUNT, // every runtime body, after the planets
+	DRAW_IMPOSTOR,                                  // + Shading
+	DRAW_TRANSPARENT = DRAW_IMPOSTOR + SHADING_COUNT
+};
 
+inline VkPipeline drawPipeline(const PipelineSet& pipelines, uint32_t pipeline) {
+	if (pipeline < DRAW_PROCEDURAL) return pipelines.graphics[pipeline - DRAW_MESH];
+	if (pipeline < DRAW_DYNAMIC) return pipelines.procedural[pipeline - DRAW_PROCEDURAL];
+	if (pipeline == DRAW_DYNAMIC) return pipelines.dynamic;
+	if (pipeline < DRAW_TRANSPARENT) return pipelines.impostor[pipeline - DRAW_IMPOSTOR];
+	return pipelines.transparent;
+}
 
-	// Ring Index
-	ring_index_list.clear();
-	for (uint i = 0; i <= NUM_TESS; i++) {
+static const uint32_t PIPELINE_COMPILE_THREADS = 2;
+static const uint32_t CAPTURE_RING_SIZE = 4; // frames between a capture copy and its readback, at most
+static const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
 
-		// like flatten doughnut
+std::vector<Vertex> planet_vertex_list;
+std::vector<uint> planet_index_list;
+std::vector<Vertex>	ring_vertex_list;
+std::vector<uint> ring_index_list;
 
-		ring_index_list.push_back(i * 2);
-		ring_index_list.push_back(i * 2 + 1);
-		ring_index_list.push_back((i + 1) * 2 + 1);
+void createVerticesAndIndices()
+{
+	// the meshes shared with trackball, converted to the vertex of this renderer
+	std::vector<SceneVertex> vertices;
+	createSphereMesh(NUM_TESS, vertices, planet_index_list);
+	planet_vertex_list.clear();
+	for (const SceneVertex& v : vertices) planet_vertex_list.push_back({ glm::make_vec3(v.pos) * RADIUS, glm::make_vec3(v.norm), glm::make_vec2(v.tex) });
 
-		ring_index_list.push_back((i + 1) * 2 + 1);
-		ring_index_list.push_back(i * 2 + 1);
-		ring_index_list.push_back(i * 2);
+	createRingMesh(NUM_TESS, vertices, ring_index_list);
+	ring_vertex_list.clear();
+	for (const SceneVertex& v : vertices) ring_vertex_list.push_back({ glm::make_vec3(v.pos) * RADIUS, glm::make_vec3(v.norm), glm::make_vec2(v.tex) });
 
-		ring_index_list.push_back((i + 1) * 2 + 1);
-		ring_index_list.push_back((i + 1) * 2);
-		ring_index_list.push_back(i * 2);
+	// Vertex cache optimization
+	VertexCacheStatistics planet_before = analyzeVertexCache(planet_index_list, planet_vertex_list.size());
+	optimizeVertexCache(planet_index_list, planet_vertex_list.size());
+	optimizeVertexCache(ring_index_list, ring_vertex_list.size());
+	VertexCacheStatistics planet_after = analyzeVertexCache(planet_index_list, planet_vertex_list.size());
 
-		ring_index_list.push_back(i * 2);
-		ring_index_list.push_back((i + 1) * 2);
-		ring_index_list.push_back((i + 1) * 2 + 1);
-	}
+	printf("> planet mesh : %zu vertices, %zu triangles\n", planet_vertex_list.size(), planet_index_list.size() / 3);
+	printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", planet_before.acmr, planet_after.acmr, planet_before.atvr, planet_after.atvr);
 
 }
 
@@ -274,46 +497,11 @@ void createVerticesAndIndices()
 
 std::vector<Planet> planet_list;
 
-void createPlanets() {
-
-	planet_list.clear();
+// fragment shader variant of the opaque bodies
+inline Shading planetShading(uint planetIndex) { return isLit(planetIndex) ? SHADING_LIT : SHADING_UNLIT; } // the Sun is the light
 
-	planet_list.push_back(Planet(-1, 0, 0, 12, 0.0f, 5.4f, 5.2f, 0.0f));       // Sun
-	planet_list.push_back(Planet(-1, 0, 1, 12, 9.9f, 0.6f, 7.7f, 3.1f));       // Mercury
-	planet_list.push_back(Planet(-1, 0, 2, 12, 15.8f, 1.0f, 15.6f, 3.9f));     // Venus
-	planet_list.push_back(Planet(-1, 0, 3, 12, 19.3f, 1.0f, 1.0f, 4.4f));      // Earth
-	planet_list.push_back(Planet(-1, 0, 4, 12, 24.2f, 0.7f, 1.0f, 5.1f));      // Mars
-	planet_list.push_back(Planet(-1, 0, 5, 12, 36.8f, 3.3f, 0.6f, 8.1f));      // Jupiter
-	planet_list.push_back(Planet(-1, 0, 6, 12, 61.4f, 3.1f, 0.6f, 10.2f));     // Saturn
-	planet_list.push_back(Planet(-1, 0, 7, 12, 82.6f, 2.0f, 0.8f, 13.2f));     // Uranus
-	planet_list.push_back(Planet(-1, 0, 8, 12, 103.6f, 2.0f, 0.8f, 15.6f));     // Neptune
-
-	// Setellite instance
-	planet_list.push_back(Planet(3, 0, 9, 12, 2.5f, 0.3f, 27.3f, 1.0f));  // Moon (Setellite of the Earth)
-
-	planet_list.push_back(Planet(5, 0, 9, 12, 4.0f, 0.4f, 0.4f, 0.4f));  // Io (Setellite of the Jupiter)
-	planet_list.push_back(Planet(5, 0, 9, 12, 8.5f, 0.5f, 4.0f, 4.0f));  // Callisto (Setellite of the Jupiter)
-	planet_list.push_back(Planet(5, 0, 9, 12, 5.0f, 0.3f, 0.8f, 0.8f));  // Europa (Setellite of the Jupiter)
-	planet_list.push_back(Planet(5, 0, 9, 12, 7.0f, 0.6f, 2.0f, 2.0f));  // Ganymede (Setellite of the Jupiter)
-
-	planet_list.push_back(Planet(7, 0, 9, 12, 3.8f, 0.3f, 0.4f, 0.4f));  // Miranda (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 0, 9, 12, 5.0f, 0.5f, 0.5f, 0.5f));  // Ariel (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 0, 9, 12, 6.5f, 0.5f, 0.6f, 0.6f));  // Umbriel (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 0, 9, 12, 8.0f, 0.7f, 0.8f, 0.8f));  // Titania (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 0, 9, 12, 10.0f, 0.7f, 1.3f, 1.3f));  // Oberon (Setellite of the Uranus)
-
-	planet_list.push_back(Planet(8, 0, 9, 12, 5.0f, 0.8f, -0.6f, -0.6f));  // Triton (Setellite of the Neptune)
-	planet_list.push_back(Planet(8, 0, 9, 12, 7.0f, 0.5f, 1.1f, 30.0f));  // Oberon (Setellite of the Neptune)
-
-	// Ring
-	planet_list.push_back(Planet(6, 1, 10, 11, 0.0f, 6.2f, 0.0f, 0.0f));     // Saturn
-
-	// other tiny planets
-	srand((int)time(NULL));
-	for (int i = 0; i < 1000; i++) {
-		int parent = rand() % 9;
-		planet_list.push_back(Planet(parent, 0, 9, 12, planet_list.at(parent).radius + 1 + rand() % 500 / 100.0f, 0.01f + rand() % 10 / 100.0f, 1.0f + rand() % 1000 / 100.0f, 1.0f + rand() % 1000 / 100.0f));
-	}
+void createPlanets() {
+	createSolarSystem(planet_list, (unsigned int)time(NULL));
 }
 
 
@@ -329,11 +517,41 @@ public:
 		cleanup();
 	}
 
+	// --build-mips : the mip file next to every texture image, read level by level by loadTextureLevels()
+	static void buildMipFiles() {
+		for (uint i = 0; i < NUM_SOLAR_TEXTURES; i++) {
+			const char* fileNames[] = { SOLAR_TEXTURE_PATHS[i], SOLAR_NORMAL_PATHS[i], SOLAR_BUMP_PATHS[i] };
+			for (int k = 0; k < 3; k++) {
+				if (!fileNames[k]) continue;
+
+				std::vector<uint8_t> pixels;
+				uint32_t width, height;
+				if (!loadTextureFile(fileNames[k], pixels, width, height)) {
+					throw std::runtime_error(std::string("failed to load texture image : ") + fileNames[k]);
+				}
+				TextureMipChain chain = buildMipChain(std::move(pixels), width, height, 0);
+				if (!writeMipFile(mipFilePath(fileNames[k]), chain, k == 0)) {
+					throw std::runtime_error("failed to write mip file : " + mipFilePath(fileNames[k]));
+				}
+				printf("> %s : %ux%u, %zu levels, %.1f MB\n", mipFilePath(fileNames[k]).c_str(), width, height, chain.levels.size(), chain.bytes() / 1048576.0);
+			}
+		}
+	}
+
 private:
 	// Window
 	GLFWwindow* window;
 	bool framebufferResized = false;
-	bool wireframeModeChanged = false;
+	bool framePacingChanged = false;
+	int framebufferWidth = 0;                      // the size of the last RESIZE event (render thread)
+	int framebufferHeight = 0;
+
+	// Render Thread : everything below runs on it once mainLoop() starts it
+	std::thread renderThread;
+	std::atomic<bool> bStopRendering{ false };     // the window is closing
+	std::atomic<bool> bRenderStopped{ false };     // the render thread returned (or threw renderError)
+	std::exception_ptr renderError;
+	uint64_t cameraVersion = 0;                    // version of cameraInput in cameraInfo
 
 	// Instance
 	VkInstance instance;
@@ -351,6 +569,11 @@ private:
 	// Queue
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue transferQueue;        // same as graphicsQueue without a transfer-only family
+	uint32_t graphicsQueueFamily;
+	uint32_t transferQueueFamily;
+	VkQueue computeQueue;         // same as graphicsQueue without a separate compute family
+	uint32_t computeQueueFamily;
 
 	// Swapchain
 	VkSwapchainKHR swapChain;
@@ -369,13 +592,38 @@ private:
 
 	// Graphics Pipeline
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
+	PipelineManager<PipelineVariant, PipelineSet> pipelineManager;
+	PipelineVariant activeVariant;  // what the command buffers are recorded with
+	PipelineSet activePipelines;
+	VkFormat renderPassFormat;      // color format the render pass (and so every pipeline) was created for
+	uint64_t recordVersion = 0;     // bumped when every command buffer has to be recorded again
 
 	// Frame Buffers
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
 	// Command Pool
 	VkCommandPool commandPool;
+	VkCommandPool transferCommandPool;
+	VkCommandPool computeCommandPool;
+
+	// Upload : what the next frame waits for, and the ownership it takes back from the transfer queue
+	// with timeline semaphores every upload signals the next value of one semaphore and the frame waits for the last one,
+	// otherwise each upload signals a binary semaphore from a pool, back in the pool once the frame that waited is complete
+	VkSemaphore uploadTimeline = VK_NULL_HANDLE;
+	uint64_t uploadValue = 0;                // signaled by the last upload
+	uint64_t uploadWaitedValue = 0;          // the last one a frame waited for
+	std::vector<VkSemaphore> pendingUploadSemaphores;
+	std::vector<VkSemaphore> uploadSemaphorePool;
+	std::vector<VkBufferMemoryBarrier> pendingBufferAcquires;
+	std::vector<VkImageMemoryBarrier> pendingImageAcquires;
+
+	// Texture streaming : evicted levels, copied out of the resident image into a smaller one ahead of the next frame
+	struct TextureLevelDrop {
+		VkImage source, target;
+		uint32_t firstLevel, levelCount; // source levels kept, they become target levels 0 ..
+		uint32_t width, height;          // of the first kept level
+	};
+	std::vector<TextureLevelDrop> pendingTextureDrops;
 
 	// Depth Image Resources
 	VkImage depthImage;
@@ -390,6 +638,42 @@ private:
 	std::vector<VkImageView> textureImageView;
 	VkSampler textureSampler;
 
+	// Texture Streaming : mip chains by on-screen size, swapped in image by image
+	TextureStreamer textureStreamer;
+	std::vector<uint32_t> textureMipLevels;
+	std::vector<VkFormat> textureFormat;                    // sRGB colour and alpha textures, UNORM normal and bump maps
+	std::vector<uint32_t> textureStreamIndex;               // texture -> streamer index (UINT32_MAX : not streamed)
+	std::vector<uint32_t> streamTextureIndex;               // streamer index -> texture
+	std::vector<std::vector<uint>> staleTextureDescriptors; // for each swapchain image, textures its descriptor sets still miss
+	struct RetiredTexture {
+		uint texture;
+		VkImage image;
+		VkImageView view;
+		VkDeviceMemory memory;
+		size_t imagesLeft; // swapchain images whose descriptor sets may still point at it
+	};
+	std::vector<RetiredTexture> retiredTextures;
+
+	// Frame Capture : swapchain image -> readback ring -> capture thread
+	enum CaptureState { CAPTURE_FREE, CAPTURE_GPU, CAPTURE_WRITING };
+	struct CaptureSlot {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		uint8_t* mapped;
+		bool coherent;
+		VkCommandBuffer commandBuffer;
+		CaptureState state;
+		uint64_t frameValue;  // the frame whose copy fills the buffer
+		uint64_t frame;       // number of the frame since the capture started (file names, the dropped ones are skipped)
+	};
+	std::vector<CaptureSlot> captureSlots;
+	std::vector<uint32_t> captureReady;     // slots whose copy is complete, in frame order
+	CaptureWriter captureWriter;
+	bool captureSupported = false;  // the swapchain images can be a transfer source
+	uint64_t capturedFrames = 0;    // the dropped ones included
+	size_t droppedCaptures = 0;     // every slot was still busy
+
 	// Vertex Buffer, Index Buffer
 	VkBuffer planetVertexBuffer;
 	VkDeviceMemory planetVertexBufferMemory;
@@ -399,6 +683,8 @@ private:
 	VkDeviceMemory ringVertexBufferMemory;
 	VkBuffer ringIndexBuffer;
 	VkDeviceMemory ringIndexBufferMemory;
+	VkIndexType planetIndexType = VK_INDEX_TYPE_UINT32;
+	VkIndexType ringIndexType = VK_INDEX_TYPE_UINT32;
 
 	// Uniform Buffer
 	std::vector<std::vector<VkBuffer>> uniformBuffers;
@@ -408,17 +694,81 @@ private:
 	std::vector<VkDescriptorPool> descriptorPool;
 	std::vector<std::vector<VkDescriptorSet>> descriptorSets;
 
+	// Indirect Buffers (BodyDrawCommands of every body, for each swapchain image)
+	std::vector<VkBuffer> indirectBuffers;
+	std::vector<VkDeviceMemory> indirectBuffersMemory;
+	std::vector<BodyDrawCommands*> indirectBuffersMapped;
+	uint impostorCount = 0;
+	uint culledCount = 0;
+
+	// Culling (compute) : body models in, BodyDrawCommands out, for each swapchain image
+	VkDescriptorSetLayout computeDescriptorSetLayout;
+	VkPipelineLayout computePipelineLayout;
+	VkPipeline computePipeline;
+	VkDescriptorPool computeDescriptorPool;
+	std::vector<VkDescriptorSet> computeDescriptorSets;
+	std::vector<VkBuffer> cullingBuffers;
+	std::vector<VkDeviceMemory> cullingBuffersMemory;
+	std::vector<CullingInput*> cullingBuffersMapped;
+	std::vector<VkCommandBuffer> computeCommandBuffers;
+	std::vector<bool> imageComputeSubmitted; // the last frame of the image ran its culling on the compute queue
+
+	// Dynamic Bodies : registry slots in a persistently mapped instance buffer of each swapchain image, drawn by a single indirect draw
+	BodyRegistry bodyRegistry;
+	std::vector<DynamicBodyInstance> dynamicInstances;         // every slot, copied into the buffer of an image when it is prepared
+	std::vector<std::vector<uint32_t>> dynamicInstanceChanges; // slots changed since each image was prepared last
+	std::vector<VkBuffer> dynamicInstanceBuffers;
+	std::vector<VkDeviceMemory> dynamicInstanceBuffersMemory;
+	std::vector<DynamicBodyInstance*> dynamicInstancesMapped;
+	std::vector<BodyHandle> asteroidHandles;       // bodies spawned with 'b', removed with 'n'
+	double dynamicTimeOrigin = 0.0;                // simulation time of the phases in dynamicInstances
+	VkDescriptorSetLayout dynamicDescriptorSetLayout;
+	VkPipelineLayout dynamicPipelineLayout;
+	std::vector<VkBuffer> dynamicUniformBuffers;   // camera, light and time of each swapchain image
+	std::vector<VkDeviceMemory> dynamicUniformBuffersMemory;
+	VkDescriptorPool dynamicDescriptorPool;
+	std::vector<VkDescriptorSet> dynamicDescriptorSets;
+
+	// GPU Timing : graphics begin/end and compute begin/end of the last frame of each swapchain image
+	std::vector<VkQueryPool> timingQueryPools;
+	bool gpuTimingSupported = false;
+	float timestampPeriod = 1.0f;           // nanoseconds per tick
+	ComputeOverlapStats computeOverlap;
+
 	// Command Buffers
 	std::vector<VkCommandBuffer> commandBuffers;
+	RenderQueue renderQueue;                                 // draws of the simulated frame, sorted
+
+	// --null : frames recorded without a submit
+	uint64_t nullFrameCount = 0;
+	uint32_t nullRecordCount = 0;                            // command buffers recorded since the last report
+
+	// Body Queries : bounding spheres of the simulated frame in a BVH, for culling and picking
+	BodyBvh bodyBvh;
+	std::vector<glm::vec4> bodySpheres;       // center, radius (0 for the rings : picked through their planet)
+	std::vector<uint32_t> queryResult;
+	std::vector<uint8_t> bodyVisible;         // in the frustum this frame
+	uint32_t pickedBody = BodyBvh::NO_BODY;
+	std::vector<std::vector<DrawItem>> recordedDraws;        // draws recorded in each command buffer
+	std::vector<uint64_t> recordedVersion;                   // recordVersion of each command buffer
 
 	// SyncObjects (Semaphore, Fence)
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
+	std::vector<VkSemaphore> computeFinishedSemaphores; // culling of the frame -> its indirect draws
+	FrameScheduler frameScheduler;          // frame values, signaled by a timeline semaphore (or fences)
+	StagingRing stagingRing;                // source of every upload, regions retire on the fence of their transfer
+	std::vector<uint64_t> imageFrameValues; // the last frame that rendered to each swapchain image
+	bool physicalDeviceProperties2Supported = false; // VK_KHR_get_physical_device_properties2 on the instance
+	bool timelineSemaphoreSupported = false;
+	bool calibratedTimestampsSupported = false;
 
 	// Drawing
 	size_t currentFrame = 0;
+	std::vector<UniformBufferObject> bodyUniforms; // simulated frame, copied to the uniform buffers of the image
+	double simulationTime = 0.0;                   // absolute, every body transform is a function of it
+	bool bFrameHasInput = false;                   // the simulated frame contains the trackball input of frameInputTime
+	std::chrono::steady_clock::time_point frameInputTime;
 	std::chrono::time_point<std::chrono::steady_clock> currentTime = std::chrono::high_resolution_clock::now();
 
 	// Frame update count
@@ -440,29 +790,25 @@ private:
 		glfwSetKeyCallback(window, keyboardCallback);			                // callback for keyboard events
 		glfwSetMouseButtonCallback(window, mouseCallback);                      // callback for mouse click inputs
 		glfwSetCursorPosCallback(window, motionCallback);                       // callback for mouse movement
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
 		printHelp();
 	}
 
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
-		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
-		app->framebufferResized = true;
-		cameraInfo.updateProjectionMatrix(width, height);
+		window_size = ivec2(width, height);
+		inputQueue.push({ InputEvent::RESIZE, 0, float(width), float(height) });
 	}
 
+	// the keys of the window thread are handled here, the rest are queued for handleKey()
 	static void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
 		if (action == GLFW_PRESS)
 		{
 			if (key == GLFW_KEY_ESCAPE || key == GLFW_KEY_Q)	glfwSetWindowShouldClose(window, GL_TRUE);
-			else if (key == GLFW_KEY_H || key == GLFW_KEY_F1)	printHelp();
-			else if (key == GLFW_KEY_HOME)					    cameraInfo = {};
-			else if (key == GLFW_KEY_W)
-			{
-				bWireframe = !bWireframe;
-				auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
-				app->wireframeModeChanged = true;
-				printf("> using %s mode\n", bWireframe ? "wireframe" : "solid");
+			else if (key == GLFW_KEY_HOME) {
+				inputViewMatrix = CameraInfo().viewMatrix;
+				publishCamera();
 			}
 			else if (key == GLFW_KEY_LEFT_SHIFT || key == GLFW_KEY_RIGHT_SHIFT) {
 				bShiftKeyPressed = true;
@@ -470,6 +816,7 @@ private:
 			else if (key == GLFW_KEY_LEFT_CONTROL || key == GLFW_KEY_RIGHT_CONTROL) {
 				bCtrlKeyPressed = true;
 			}
+			else inputQueue.push({ InputEvent::KEY, key, 0.0f, 0.0f });
 		}
 		else if (action == GLFW_RELEASE) {
 			if (key == GLFW_KEY_LEFT_SHIFT || key == GLFW_KEY_RIGHT_SHIFT) {
@@ -481,6 +828,94 @@ private:
 		}
 	}
 
+	// a key press on the render thread
+	void handleKey(int key) {
+
+		if (key == GLFW_KEY_H || key == GLFW_KEY_F1)	printHelp();
+		else if (key == GLFW_KEY_W)
+		{
+			bWireframe = !bWireframe;
+			printf("> using %s mode\n", bWireframe ? "wireframe" : "solid");
+		}
+		else if (key == GLFW_KEY_V)
+		{
+			vertexFormat = VertexFormat((vertexFormat + 1) % VERTEX_FORMAT_COUNT);
+			printf("> using %s vertex format\n", vertex_format_name[vertexFormat]);
+		}
+		else if (key == GLFW_KEY_P)
+		{
+			bProceduralSphere = !bProceduralSphere;
+			printf("> using %s sphere\n", bProceduralSphere ? "procedural" : "vertex buffer");
+		}
+		else if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD || key == GLFW_KEY_MINUS || key == GLFW_KEY_KP_SUBTRACT)
+		{
+			bool increase = (key == GLFW_KEY_EQUAL || key == GLFW_KEY_KP_ADD);
+			// kept even : tess / 2 latitude bands have to reach from pole to pole
+			procedural_tess = increase ? min(procedural_tess * 2, 512u) : max((procedural_tess / 2) & ~1u, 8u);
+			printf("> procedural sphere tessellation : %u\n", procedural_tess);
+		}
+		else if (key == GLFW_KEY_F2 || key == GLFW_KEY_F3 || key == GLFW_KEY_F4)
+		{
+			if (key == GLFW_KEY_F2) presentModePreference = VkPresentModeKHR((presentModePreference + 1) % 4);
+			if (key == GLFW_KEY_F3) framesInFlight = framesInFlight % MAX_FRAMES_IN_FLIGHT + 1;
+			if (key == GLFW_KEY_F4) swapChainImageRequest = swapChainImageRequest == 0 ? 2 : (swapChainImageRequest >= 4 ? 0 : swapChainImageRequest + 1);
+			framePacingChanged = true;
+		}
+		else if (key == GLFW_KEY_F5)
+		{
+			bSimulateBeforeWait = !bSimulateBeforeWait;
+			printf("> simulating %s the fence wait (%s)\n", bSimulateBeforeWait ? "before" : "after", bSimulateBeforeWait ? "throughput" : "latency");
+		}
+		else if (key == GLFW_KEY_F6)
+		{
+			bCapture = !bCapture;
+			printf("> frame capture %s\n", bCapture ? "on" : "off");
+		}
+		else if (key == GLFW_KEY_L)
+		{
+			bLatencyReport = !bLatencyReport;
+			printf("> latency report %s\n", bLatencyReport ? "on" : "off");
+		}
+		else if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET)
+		{
+			if (timeScale == 0.0) timeScale = 1.0;
+			else timeScale *= key == GLFW_KEY_RIGHT_BRACKET ? 2.0 : 0.5;
+			printf("> time scale x%g\n", timeScale);
+		}
+		else if (key == GLFW_KEY_BACKSLASH)
+		{
+			timeScale = timeScale == 0.0 ? 1.0 : 0.0;
+			printf("> time %s\n", timeScale == 0.0 ? "paused" : "running");
+		}
+		else if (key == GLFW_KEY_COMMA || key == GLFW_KEY_PERIOD)
+		{
+			seek(key == GLFW_KEY_PERIOD ? SEEK_SECONDS : -SEEK_SECONDS);
+		}
+		else if (key == GLFW_KEY_B)
+		{
+			spawnAsteroids(1000);
+		}
+		else if (key == GLFW_KEY_N)
+		{
+			removeAsteroids(1000);
+		}
+		else if (key == GLFW_KEY_C)
+		{
+			bAsyncCompute = !bAsyncCompute;
+			printf("> culling on the %s\n", bAsyncCompute ? "compute queue" : "CPU");
+		}
+		else if (key == GLFW_KEY_T)
+		{
+			bGpuTimingReport = !bGpuTimingReport;
+			printf("> compute overlap report %s\n", bGpuTimingReport ? "on" : "off");
+		}
+		else if (key == GLFW_KEY_I)
+		{
+			bImpostor = !bImpostor;
+			printf("> %s sphere impostors\n", bImpostor ? "using" : "not using");
+		}
+	}
+
 	static void mouseCallback(GLFWwindow* window, int button, int action, int mods)
 	{
 		int mode;
@@ -513,16 +948,25 @@ private:
 
 		dvec2 pos; glfwGetCursorPos(window, &pos.x, &pos.y);
 		vec2 npos = vec2(float(pos.x) / float(window_size.x - 1), float(pos.y) / float(window_size.y - 1));
-		if (action == GLFW_PRESS)			trackball.begin(cameraInfo.viewMatrix, npos.x, npos.y, mode);
+		if (action == GLFW_PRESS)			trackball.begin(toCgmath(inputViewMatrix), npos.x, npos.y, mode);
 		else if (action == GLFW_RELEASE)	trackball.end();
 
+		// a click without dragging picks the body under the cursor
+		if (button == GLFW_MOUSE_BUTTON_LEFT && mode == MODE_ROTATION) {
+			if (action == GLFW_PRESS) clickPosition = pos;
+			else if (action == GLFW_RELEASE && (pos - clickPosition).length() < CLICK_PIXELS) {
+				inputQueue.push({ InputEvent::PICK, 0, npos.x, npos.y });
+			}
+		}
+
 	}
 
 	static void motionCallback(GLFWwindow* window, double x, double y)
 	{
 		if (!trackball.bTracking) return;
 		vec2 npos = vec2(float(x) / float(window_size.x - 1), float(y) / float(window_size.y - 1));
-		cameraInfo.viewMatrix = trackball.update(npos.x, npos.y);
+		inputViewMatrix = toGlm(trackball.update(npos.x, npos.y));
+		publishCamera();
 	}
 
 
@@ -531,6 +975,16 @@ private:
 		printf("- press ESC or 'q' to terminate the program\n");
 		printf("- press F1 or 'h' to see help\n");
 		printf("- press 'w' to toggle wireframe\n");
+		printf("- press 'v' to change vertex format\n");
+		printf("- press 'p' to toggle procedural sphere, '+'/'-' to change its tessellation\n");
+		printf("- press 'i' to toggle impostors for distant spheres\n");
+		printf("- press F2 / F3 / F4 to change present mode / frames in flight / swapchain images\n");
+		printf("- press F5 to simulate before or after the fence wait, 'l' to toggle latency report\n");
+		printf("- press F6 to toggle frame capture (--capture png|y4m)\n");
+		printf("- press 'c' to cull on the compute queue or the CPU, 't' to toggle compute overlap report\n");
+		printf("- press 'b' to spawn 1000 asteroids, 'n' to remove 1000 of them\n");
+		printf("- press '[' / ']' to slow down / speed up time, '\\' to pause, ',' / '.' to seek 60 seconds\n");
+		printf("- click a body to pick it\n");
 		printf("- press Home to reset camera\n");
 		printf("\n");
 	}
@@ -548,37 +1002,43 @@ private:
 		createImageViews(); // recreate  ȣ
 		createRenderPass(); // recreate  ȣ
 		createDescriptorSetLayout();
-		createGraphicsPipeline(); // recreate  ȣ
+		createPipelineLayouts();
+		createPipelineManager();
+		createComputePipeline();
 		createDepthResources(); // recreate  ȣ
 		createFramebuffers(); // recreate  ȣ
 		createCommandPool();
+		createStagingRing();
+		createUploadSync();
 
 		// texture initialize
-		textureImage.resize(13);
-		textureImageMemory.resize(13);
-
-		createTextureImage(textureImage[0], textureImageMemory[0], "./textures/sun.jpg");
-		createTextureImage(textureImage[1], textureImageMemory[1], "./textures/mercury.jpg");
-		createTextureImage(textureImage[2], textureImageMemory[2], "./textures/venus.jpg");
-		createTextureImage(textureImage[3], textureImageMemory[3], "./textures/earth.jpg");
-		createTextureImage(textureImage[4], textureImageMemory[4], "./textures/mars.jpg");
-		createTextureImage(textureImage[5], textureImageMemory[5], "./textures/jupiter.jpg");
-		createTextureImage(textureImage[6], textureImageMemory[6], "./textures/saturn.jpg");
-		createTextureImage(textureImage[7], textureImageMemory[7], "./textures/uranus.jpg");
-		createTextureImage(textureImage[8], textureImageMemory[8], "./textures/neptune.jpg");
-		createTextureImage(textureImage[9], textureImageMemory[9], "./textures/moon.jpg");
-		createTextureImage(textureImage[10], textureImageMemory[10], "./textures/saturn-ring.jpg");
-		createTextureImage(textureImage[11], textureImageMemory[11], "./textures/saturn-ring-alpha.jpg");
-		createWhiteDotImage(textureImage[12], textureImageMemory[12]);
+		textureImage.resize(NUM_TEXTURES);
+		textureImageMemory.resize(NUM_TEXTURES);
+		textureMipLevels.resize(NUM_TEXTURES);
+		textureFormat.resize(NUM_TEXTURES);
+		textureStreamIndex.assign(NUM_TEXTURES, UINT32_MAX);
+
+		// a body without detail maps gets flat ones : the surface normal, and no parallax offset
+		for (uint i = 0; i < NUM_SOLAR_TEXTURES; i++) {
+			if (SOLAR_TEXTURE_PATHS[i]) createTextureImage(i, SOLAR_TEXTURE_PATHS[i], VK_FORMAT_R8G8B8A8_SRGB);
+			else createDotImage(i, { 0xFF, 0xFF, 0xFF, 0xFF }, VK_FORMAT_R8G8B8A8_SRGB);
+
+			if (SOLAR_NORMAL_PATHS[i]) createTextureImage(normalTexture(i), SOLAR_NORMAL_PATHS[i], VK_FORMAT_R8G8B8A8_UNORM);
+			else createDotImage(normalTexture(i), { 0x80, 0x80, 0xFF, 0xFF }, VK_FORMAT_R8G8B8A8_UNORM);
+
+			if (SOLAR_BUMP_PATHS[i]) createTextureImage(bumpTexture(i), SOLAR_BUMP_PATHS[i], VK_FORMAT_R8G8B8A8_UNORM);
+			else createDotImage(bumpTexture(i), { 0x80, 0x80, 0x80, 0xFF }, VK_FORMAT_R8G8B8A8_UNORM);
+		}
 
 		createTextureImageView();
+		textureStreamer.start(loadTextureLevels, textureBudgetMB << 20);
 
 		createTextureSampler();
 		createVerticesAndIndices(); //   
-		createVertexBuffer(planet_vertex_list, planetVertexBuffer, planetVertexBufferMemory);
-		createIndexBuffer(planet_index_list, planetIndexBuffer, planetIndexBufferMemory);
-		createVertexBuffer(ring_vertex_list, ringVertexBuffer, ringVertexBufferMemory);
-		createIndexBuffer(ring_index_list, ringIndexBuffer, ringIndexBufferMemory);
+		createMeshVertexBuffer(planet_vertex_list, planetVertexBuffer, planetVertexBufferMemory);
+		createIndexBuffer(planet_index_list, planetIndexBuffer, planetIndexBufferMemory, planetIndexType);
+		createMeshVertexBuffer(ring_vertex_list, ringVertexBuffer, ringVertexBufferMemory);
+		createIndexBuffer(ring_index_list, ringIndexBuffer, ringIndexBufferMemory, ringIndexType);
 		createPlanets();
 
 		uniformBuffers.resize(planet_list.size());
@@ -591,24 +1051,86 @@ private:
 			createDescriptorPool(descriptorPool[i]); // recreate  ȣ
 			createDescriptorSets(descriptorSets[i], descriptorPool[i], uniformBuffers[i], planet_list[i]); // recreate  ȣ
 		}
+		createIndirectBuffers(); // recreate  ȣ
+		createCullingResources(); // recreate  ȣ
+		createDynamicInstanceBuffer();
+		createDynamicBodyResources(); // recreate  ȣ
+		createCaptureResources(); // recreate  ȣ
 		createCommandBuffers(); // recreate  ȣ
+		resetTextureDescriptorUpdates(); // recreate  ȣ
+		frameScheduler.create(device, framesInFlight, timelineSemaphoreSupported);
 		createSyncObjects();
+		startCapture();
 
 	}
 
+	// the window thread only waits for events (it may sit in a modal loop while the window is dragged or resized),
+	// the render thread keeps simulating and presenting meanwhile
 	void mainLoop() {
-		while (!glfwWindowShouldClose(window)) {
-			glfwPollEvents();
+		renderThread = std::thread([this]() {
+			try {
+				renderLoop();
+			}
+			catch (...) {
+				renderError = std::current_exception();
+			}
+			bRenderStopped = true;
+			glfwPostEmptyEvent();
+		});
+
+		while (!glfwWindowShouldClose(window) && !bRenderStopped) {
+			glfwWaitEvents();
+		}
+
+		bStopRendering = true;
+		renderThread.join();
+		if (renderError) std::rethrow_exception(renderError);
+	}
+
+	void renderLoop() {
+		simulationTime = startTime;
+		currentTime = std::chrono::high_resolution_clock::now();
+
+		while (!bStopRendering) {
+			processInput();
 			drawFrame();
 		}
 
 		vkDeviceWaitIdle(device);
 	}
 
+	// the events the window thread queued since the last call
+	void processInput() {
+		InputEvent event;
+		while (inputQueue.pop(event)) {
+			if (event.type == InputEvent::KEY) handleKey(event.key);
+			else if (event.type == InputEvent::PICK) pickBody(event.x, event.y);
+			else if (event.type == InputEvent::RESIZE) {
+				framebufferWidth = int(event.x);
+				framebufferHeight = int(event.y);
+				framebufferResized = true;
+			}
+		}
+	}
+
 	void cleanup() {
 
+		textureStreamer.stop();
+		collectCaptures();
+		captureWriter.stop();
+		for (auto& retired : retiredTextures) destroyTexture(retired.image, retired.view, retired.memory);
+
 		cleanupSwapChain();
 
+		// Graphics Pipeline
+		savePipelineCache();
+		pipelineManager.destroy();
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, dynamicPipelineLayout, nullptr);
+
+		// Render Pass
+		vkDestroyRenderPass(device, renderPass, nullptr);
+
 		vkDestroySampler(device, textureSampler, nullptr);
 		for (int i = 0; i < (int)textureImageView.size(); i++) {
 
@@ -623,6 +1145,13 @@ private:
 		// Descriptor Layout
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		vkDestroyDescriptorSetLayout(device, dynamicDescriptorSetLayout, nullptr);
+
+		// Compute Pipeline
+		vkDestroyPipeline(device, computePipeline, nullptr);
+		vkDestroyPipelineLayout(device, computePipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, computeDescriptorSetLayout, nullptr);
+
 		// Vertex Buffer, Index Buffer
 		vkDestroyBuffer(device, planetIndexBuffer, nullptr);
 		vkFreeMemory(device, planetIndexBufferMemory, nullptr);
@@ -634,14 +1163,15 @@ private:
 		vkFreeMemory(device, ringVertexBufferMemory, nullptr);
 
 		// SyncObjects (Semaphore, Fence)
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device, inFlightFences[i], nullptr);
-		}
+		cleanupSyncObjects();
+		frameScheduler.destroy();
+		destroyUploadSync();
+		stagingRing.destroy();
 
 		// Command Pool
 		vkDestroyCommandPool(device, commandPool, nullptr);
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
+		vkDestroyCommandPool(device, computeCommandPool, nullptr);
 
 		// Logical Device
 		vkDestroyDevice(device, nullptr);
@@ -728,9 +1258,28 @@ private:
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 		}
 
+		// the instance is Vulkan 1.0 : the optional device extensions (timeline semaphore) depend on this one
+		physicalDeviceProperties2Supported = checkInstanceExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		if (physicalDeviceProperties2Supported) {
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+
 		return extensions;
 	}
 
+	bool checkInstanceExtension(const char* extensionName) {
+		uint32_t extensionCount;
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0) return true;
+		}
+		return false;
+	}
+
 
 	//// Layer
 
@@ -846,6 +1395,34 @@ private:
 		return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
 	}
 
+	bool checkDeviceExtension(VkPhysicalDevice device, const char* extensionName) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0) return true;
+		}
+		return false;
+	}
+
+	bool hasDeviceTimeDomain(VkPhysicalDevice device) {
+		auto getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+		if (getTimeDomains == nullptr) return false;
+
+		uint32_t domainCount = 0;
+		getTimeDomains(device, &domainCount, nullptr);
+		std::vector<VkTimeDomainEXT> domains(domainCount);
+		getTimeDomains(device, &domainCount, domains.data());
+
+		for (VkTimeDomainEXT domain : domains) {
+			if (domain == VK_TIME_DOMAIN_DEVICE_EXT) return true;
+		}
+		return false;
+	}
+
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -874,25 +1451,41 @@ private:
 		int i = 0;
 		for (const auto& queueFamily : queueFamilies) {
 
-			// ׷Ƚ ť ã
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-				indices.graphicsFamily = i;
+			if (!indices.isComplete()) {
+
+				// ׷Ƚ ť ã
+				if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+					indices.graphicsFamily = i;
+				}
+
+				// Present ϴ ť ã
+				VkBool32 presentSupport = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+				if (presentSupport) {
+					indices.presentFamily = i;
+				}
 			}
 
-			// Present ϴ ť ã
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-			if (presentSupport) {
-				indices.presentFamily = i;
+			// transfer-only queue (DMA engine) : uploads run beside the rendering
+			if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				if (!indices.transferFamily.has_value()) indices.transferFamily = i;
 			}
 
-			if (indices.isComplete()) {
-				break;
+			// async compute queue : runs beside the graphics queue
+			if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+				if (!indices.computeFamily.has_value()) indices.computeFamily = i;
 			}
 
 			i++;
 		}
 
+		if (!indices.transferFamily.has_value()) {
+			indices.transferFamily = indices.graphicsFamily;
+		}
+		if (!indices.computeFamily.has_value()) {
+			indices.computeFamily = indices.graphicsFamily;
+		}
+
 		return indices;
 	}
 
@@ -904,7 +1497,7 @@ private:
 
 		// With DeviceQueueCreateInfo, DeviceCreateInfo
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value(), indices.computeFamily.value() };
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -928,8 +1521,38 @@ private:
 		createInfo.pEnabledFeatures = &deviceFeatures;
 
 		// Extension Check
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		// VK_KHR_timeline_semaphore is optional, FrameScheduler falls back to fences without it
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineFeatures.timelineSemaphore = VK_TRUE;
+
+		// it needs VK_KHR_get_physical_device_properties2 on the instance, and the extension alone does not promise the feature
+		timelineSemaphoreSupported = physicalDeviceProperties2Supported && checkDeviceExtension(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		if (timelineSemaphoreSupported) {
+			auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+			VkPhysicalDeviceFeatures2 features2 = {};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &timelineFeatures;
+			timelineFeatures.timelineSemaphore = VK_FALSE;
+			if (getFeatures2 != nullptr) getFeatures2(physicalDevice, &features2);
+			timelineSemaphoreSupported = timelineFeatures.timelineSemaphore == VK_TRUE;
+		}
+		if (timelineSemaphoreSupported) {
+			enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			createInfo.pNext = &timelineFeatures;
+		}
+		printf("> %s frame synchronization\n", timelineSemaphoreSupported ? "timeline semaphore" : "fence");
+
+		// VK_EXT_calibrated_timestamps is optional too : its device time domain is what makes the timestamps
+		// of the graphics and the compute queue comparable, the compute overlap report needs it
+		calibratedTimestampsSupported = physicalDeviceProperties2Supported && checkDeviceExtension(physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) && hasDeviceTimeDomain(physicalDevice);
+		if (calibratedTimestampsSupported) {
+			enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+		}
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		// Layer Check
 		if (enableValidationLayers) {
@@ -948,6 +1571,39 @@ private:
 		// Get Graphics Queue
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+		vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+
+		graphicsQueueFamily = indices.graphicsFamily.value();
+		transferQueueFamily = indices.transferFamily.value();
+		if (hasDedicatedTransferQueue()) printf("> uploads on the dedicated transfer queue (family %u)\n", transferQueueFamily);
+		else printf("> uploads on the graphics queue\n");
+
+		vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+		computeQueueFamily = indices.computeFamily.value();
+		printf("> culling on the %s queue (family %u)\n", computeQueueFamily != graphicsQueueFamily ? "async compute" : "graphics", computeQueueFamily);
+
+		// timestamps of both queues, for the compute overlap report
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		timestampPeriod = properties.limits.timestampPeriod;
+		gpuTimingSupported = queueFamilies[graphicsQueueFamily].timestampValidBits > 0 && queueFamilies[computeQueueFamily].timestampValidBits > 0;
+
+		// culling on the graphics queue is one time domain, two queues are comparable only in the calibrated device domain
+		computeOverlap.correlated = computeQueueFamily == graphicsQueueFamily;
+		if (calibratedTimestampsSupported && !computeOverlap.correlated) {
+			auto getCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT");
+			VkCalibratedTimestampInfoEXT calibrationInfo = {};
+			calibrationInfo.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+			calibrationInfo.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+			uint64_t deviceTimestamp, maxDeviation;
+			computeOverlap.correlated = getCalibratedTimestamps != nullptr && getCalibratedTimestamps(device, 1, &calibrationInfo, &deviceTimestamp, &maxDeviation) == VK_SUCCESS;
+		}
+		if (gpuTimingSupported && !computeOverlap.correlated) printf("> queue timestamps are not correlated, the compute report has no overlap\n");
 	}
 
 
@@ -961,7 +1617,10 @@ private:
 		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+		uint32_t imageCount = swapChainImageRequest > 0 ? swapChainImageRequest : swapChainSupport.capabilities.minImageCount + 1;
+		if (imageCount < swapChainSupport.capabilities.minImageCount) {
+			imageCount = swapChainSupport.capabilities.minImageCount;
+		}
 		if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
 			imageCount = swapChainSupport.capabilities.maxImageCount;
 		}
@@ -978,6 +1637,10 @@ private:
 		createInfo.imageArrayLayers = 1;
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+		// frame capture copies the presented images
+		captureSupported = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+		if (captureSupported) createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 		uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -1007,12 +1670,17 @@ private:
 		swapChainImages.resize(imageCount);
 		vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
 
+		printf("> %s present mode, %u swapchain images, %u frames in flight\n", presentMode < 4 ? present_mode_name[presentMode] : "other", imageCount, framesInFlight);
+
 		swapChainImageFormat = surfaceFormat.format;
 		swapChainExtent = extent;
 	}
 
 	void cleanupSwapChain() {
 
+		// Frame Capture (the device is idle : every copy is complete)
+		destroyCaptureResources();
+
 		// Depth Image Resources
 		vkDestroyImageView(device, depthImageView, nullptr);
 		vkDestroyImage(device, depthImage, nullptr);
@@ -1026,13 +1694,6 @@ private:
 		// Command Buffers
 		vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
 
-		// Graphics Pipeline
-		vkDestroyPipeline(device, graphicsPipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-
-		// Render Pass
-		vkDestroyRenderPass(device, renderPass, nullptr);
-
 		// Swapchain ImageView
 		for (auto imageView : swapChainImageViews) {
 			vkDestroyImageView(device, imageView, nullptr);
@@ -1051,18 +1712,45 @@ private:
 			vkDestroyDescriptorPool(device, descriptorPool[n], nullptr);
 		}
 
+		// Indirect Buffer
+		for (size_t i = 0; i < indirectBuffers.size(); i++) {
+			vkUnmapMemory(device, indirectBuffersMemory[i]);
+			vkDestroyBuffer(device, indirectBuffers[i], nullptr);
+			vkFreeMemory(device, indirectBuffersMemory[i], nullptr);
+		}
+
+		// Culling
+		vkFreeCommandBuffers(device, computeCommandPool, static_cast<uint32_t>(computeCommandBuffers.size()), computeCommandBuffers.data());
+		vkDestroyDescriptorPool(device, computeDescriptorPool, nullptr);
+		for (size_t i = 0; i < cullingBuffers.size(); i++) {
+			vkUnmapMemory(device, cullingBuffersMemory[i]);
+			vkDestroyBuffer(device, cullingBuffers[i], nullptr);
+			vkFreeMemory(device, cullingBuffersMemory[i], nullptr);
+			vkDestroyQueryPool(device, timingQueryPools[i], nullptr);
+		}
+
+		// Dynamic Bodies
+		vkDestroyDescriptorPool(device, dynamicDescriptorPool, nullptr);
+		for (size_t i = 0; i < dynamicUniformBuffers.size(); i++) {
+			vkDestroyBuffer(device, dynamicUniformBuffers[i], nullptr);
+			vkFreeMemory(device, dynamicUniformBuffersMemory[i], nullptr);
+			vkUnmapMemory(device, dynamicInstanceBuffersMemory[i]);
+			vkDestroyBuffer(device, dynamicInstanceBuffers[i], nullptr);
+			vkFreeMemory(device, dynamicInstanceBuffersMemory[i], nullptr);
+		}
+
 
 	}
 
 	void recreateSwapChain() {
 
-		// Wait for minimize
-		glfwGetFramebufferSize(window, &window_size.x, &window_size.y);
-		while (window_size.x == 0 || window_size.y == 0) {
-			glfwGetFramebufferSize(window, &window_size.x, &window_size.y);
-			glfwWaitEvents();
+		// Wait for minimize (until the window thread sends a size again)
+		while (framebufferWidth == 0 || framebufferHeight == 0) {
+			if (bStopRendering) return;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			processInput();
 		}
-		cameraInfo.updateProjectionMatrix(window_size.x, window_size.y);
+		cameraInfo.updateProjectionMatrix(framebufferWidth, framebufferHeight);
 		vkDeviceWaitIdle(device);
 
 
@@ -1070,8 +1758,15 @@ private:
 
 		createSwapChain();
 		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
+
+		// viewport and scissor are dynamic : the pipelines only depend on the render pass formats
+		if (swapChainImageFormat != renderPassFormat) {
+			pipelineManager.clear();
+			vkDestroyRenderPass(device, renderPass, nullptr);
+			createRenderPass();
+			activePipelines = pipelineManager.wait(activeVariant);
+		}
+
 		createDepthResources();
 		createFramebuffers();
 		for (int i = 0; i < (int)planet_list.size(); i++) {
@@ -1079,7 +1774,15 @@ private:
 			createDescriptorPool(descriptorPool[i]); // recreate  ȣ
 			createDescriptorSets(descriptorSets[i], descriptorPool[i], uniformBuffers[i], planet_list[i]); // recreate  ȣ
 		}
+		createIndirectBuffers();
+		createCullingResources();
+		createDynamicBodyResources();
+		createCaptureResources();
 		createCommandBuffers();
+		resetTextureDescriptorUpdates(); // the new descriptor sets already point at the newest textures
+
+		// the number of images may have changed, and nothing is in flight now
+		imageFrameValues.assign(swapChainImages.size(), 0);
 	}
 
 
@@ -1122,12 +1825,12 @@ private:
 
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
 		for (const auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+			if (availablePresentMode == presentModePreference) {
 				return availablePresentMode;
 			}
 		}
 
-		return VK_PRESENT_MODE_FIFO_KHR;
+		return VK_PRESENT_MODE_FIFO_KHR; // always supported
 	}
 
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
@@ -1135,12 +1838,9 @@ private:
 			return capabilities.currentExtent;
 		}
 		else {
-			int width, height;
-			glfwGetFramebufferSize(window, &width, &height);
-
 			VkExtent2D actualExtent = {
-				static_cast<uint32_t>(width),
-				static_cast<uint32_t>(height)
+				static_cast<uint32_t>(framebufferWidth),
+				static_cast<uint32_t>(framebufferHeight)
 			};
 
 			actualExtent.width = max(capabilities.minImageExtent.width, min(capabilities.maxImageExtent.width, actualExtent.width));
@@ -1169,13 +1869,14 @@ private:
 
 		VkAttachmentDescription colorAttachment = {};
 		colorAttachment.format = swapChainImageFormat;
+		renderPassFormat = swapChainImageFormat;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentDescription depthAttachment = {};
 		depthAttachment.format = findDepthFormat();
@@ -1184,7 +1885,7 @@ private:
 		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference colorAttachmentRef = {};
@@ -1201,14 +1902,6 @@ private:
 		subpass.pColorAttachments = &colorAttachmentRef;
 		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
 		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
 		VkRenderPassCreateInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -1216,8 +1909,6 @@ private:
 		renderPassInfo.pAttachments = attachments.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
 
 		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create render pass!");
@@ -1239,7 +1930,7 @@ private:
 
 		VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
 		samplerLayoutBinding.binding = 1;
-		samplerLayoutBinding.descriptorCount = 2;
+		samplerLayoutBinding.descriptorCount = BODY_TEXTURE_COUNT;
 		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		samplerLayoutBinding.pImmutableSamplers = nullptr;
 		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -1260,13 +1951,105 @@ private:
 		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create descriptor set layout!");
 		}
-	}
+
+		// dynamic bodies : the same bindings (shader.frag is shared) and the instance buffer
+		VkDescriptorSetLayoutBinding instanceLayoutBinding = {};
+		instanceLayoutBinding.binding = 3;
+		instanceLayoutBinding.descriptorCount = 1;
+		instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		instanceLayoutBinding.pImmutableSamplers = nullptr;
+		instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		std::array<VkDescriptorSetLayoutBinding, 4> dynamicBindings = { uboLayoutBinding, samplerLayoutBinding, uboLayoutBinding2, instanceLayoutBinding };
+		layoutInfo.bindingCount = static_cast<uint32_t>(dynamicBindings.size());
+		layoutInfo.pBindings = dynamicBindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &dynamicDescriptorSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create dynamic body descriptor set layout!");
+		}
+	}
 
 
 	//// Graphics Pipeline
 
-	void createGraphicsPipeline() {
-		auto vertShaderCode = readFile("shaders/vert.spv");
+	void createPipelineLayouts() {
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		pipelineLayoutInfo.pSetLayouts = &dynamicDescriptorSetLayout;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &dynamicPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create dynamic body pipeline layout!");
+		}
+	}
+
+	// the first variant is compiled right away, later ones in the background (updatePipelineVariant())
+	void createPipelineManager() {
+		std::vector<char> cacheData;
+		std::ifstream file(PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary);
+		if (file.is_open()) {
+			cacheData.resize((size_t)file.tellg());
+			file.seekg(0);
+			file.read(cacheData.data(), cacheData.size());
+		}
+
+		VkDevice logicalDevice = device;
+		pipelineManager.create(device, cacheData, PIPELINE_COMPILE_THREADS,
+			[this](const PipelineVariant& variant, VkPipelineCache cache) { return createPipelines(variant, cache); },
+			[logicalDevice](const PipelineSet& pipelines) {
+				for (int shading = 0; shading < SHADING_COUNT; shading++) {
+					vkDestroyPipeline(logicalDevice, pipelines.graphics[shading], nullptr);
+					vkDestroyPipeline(logicalDevice, pipelines.procedural[shading], nullptr);
+					vkDestroyPipeline(logicalDevice, pipelines.impostor[shading], nullptr);
+				}
+				vkDestroyPipeline(logicalDevice, pipelines.dynamic, nullptr);
+				vkDestroyPipeline(logicalDevice, pipelines.transparent, nullptr);
+			});
+
+		activeVariant = requestedPipelineVariant();
+		activePipelines = pipelineManager.wait(activeVariant);
+	}
+
+	void savePipelineCache() {
+		std::vector<char> cacheData = pipelineManager.cacheData();
+		std::ofstream file(PIPELINE_CACHE_FILE, std::ios::binary);
+		if (file.is_open()) file.write(cacheData.data(), cacheData.size());
+	}
+
+	static PipelineVariant requestedPipelineVariant() {
+		return { vertexFormat, bWireframe, procedural_tess };
+	}
+
+	// switch to the variant the keys asked for once it is compiled, the frames keep the active one until then
+	void updatePipelineVariant() {
+		PipelineVariant requested = requestedPipelineVariant();
+		if (requested == activeVariant) return;
+
+		PipelineSet pipelines;
+		if (!pipelineManager.get(requested, pipelines)) return;
+
+		// the vertex buffers are laid out for the vertex input of the pipelines
+		if (requested.vertexFormat != activeVariant.vertexFormat) recreateVertexBuffers();
+
+		activeVariant = requested;
+		activePipelines = pipelines;
+		recordVersion++;
+		printf("> pipelines ready after %.1f ms\n", pipelineManager.latencyMs(requested));
+	}
+
+	// called on a pipeline manager thread : everything it reads besides the variant is fixed after initialization
+	PipelineSet createPipelines(const PipelineVariant& variant, VkPipelineCache cache) {
+		// vertex shader variant for each vertex format
+		static const char* vertShaderFile[VERTEX_FORMAT_COUNT] = { "shaders/vert.spv", "shaders/vert_packed.spv", "shaders/vert_position.spv" };
+
+		PipelineSet pipelines;
+
+		auto vertShaderCode = readFile(vertShaderFile[variant.vertexFormat]);
 		auto fragShaderCode = readFile("shaders/frag.spv");
 
 		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
@@ -1284,14 +2067,57 @@ private:
 		fragShaderStageInfo.module = fragShaderModule;
 		fragShaderStageInfo.pName = "main";
 
+		// fragment variants : constant 0 applies the light, constant 1 reads the alpha map
+		struct FragmentConstants {
+			VkBool32 applyLight;
+			VkBool32 alphaMap;
+		};
+		std::array<VkSpecializationMapEntry, 2> fragmentEntries = {};
+		fragmentEntries[0] = { 0, offsetof(FragmentConstants, applyLight), sizeof(VkBool32) };
+		fragmentEntries[1] = { 1, offsetof(FragmentConstants, alphaMap), sizeof(VkBool32) };
+
+		FragmentConstants fragmentConstants[SHADING_COUNT + 1];
+		fragmentConstants[SHADING_LIT] = { VK_TRUE, VK_FALSE };
+		fragmentConstants[SHADING_UNLIT] = { VK_FALSE, VK_FALSE };
+		fragmentConstants[SHADING_COUNT] = { VK_TRUE, VK_TRUE }; // transparent
+
+		VkSpecializationInfo fragmentSpecialization[SHADING_COUNT + 1];
+		for (int i = 0; i <= SHADING_COUNT; i++) {
+			fragmentSpecialization[i].mapEntryCount = static_cast<uint32_t>(fragmentEntries.size());
+			fragmentSpecialization[i].pMapEntries = fragmentEntries.data();
+			fragmentSpecialization[i].dataSize = sizeof(FragmentConstants);
+			fragmentSpecialization[i].pData = &fragmentConstants[i];
+		}
+		fragShaderStageInfo.pSpecializationInfo = &fragmentSpecialization[SHADING_LIT];
+
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		
 		// Vertex Input Description
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		VkVertexInputBindingDescription bindingDescription;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		switch (variant.vertexFormat) {
+		case VERTEX_FORMAT_PACKED: {
+			auto attributes = PackedVertex::getAttributeDescriptions();
+			bindingDescription = PackedVertex::getBindingDescription();
+			attributeDescriptions.assign(attributes.begin(), attributes.end());
+			break;
+		}
+		case VERTEX_FORMAT_POSITION: {
+			auto attributes = PositionVertex::getAttributeDescriptions();
+			bindingDescription = PositionVertex::getBindingDescription();
+			attributeDescriptions.assign(attributes.begin(), attributes.end());
+			break;
+		}
+		default: {
+			auto attributes = Vertex::getAttributeDescriptions();
+			bindingDescription = Vertex::getBindingDescription();
+			attributeDescriptions.assign(attributes.begin(), attributes.end());
+			break;
+		}
+		}
 
 		vertexInputInfo.vertexBindingDescriptionCount = 1;
 		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -1303,30 +2129,23 @@ private:
 		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
-
+		// set in recordCommandBuffer(), so a resize does not need new pipelines
 		VkPipelineViewportStateCreateInfo viewportState = {};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
+
+		VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = {};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
 
 		VkPipelineRasterizationStateCreateInfo rasterizer = {};
 		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 		rasterizer.depthClampEnable = VK_FALSE;
 		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = (bWireframe) ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+		rasterizer.polygonMode = (variant.wireframe) ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
 		rasterizer.lineWidth = 1.0f;
 		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
 		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
@@ -1345,9 +2164,10 @@ private:
 		depthStencil.depthBoundsTestEnable = VK_FALSE;
 		depthStencil.stencilTestEnable = VK_FALSE;
 
+		// opaque pipelines : no blending (no framebuffer read), the transparent pipeline turns it on below
 		VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
 		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.blendEnable = VK_FALSE;
 		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
 		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
@@ -1364,15 +2184,6 @@ private:
 		colorBlending.blendConstants[2] = 0.0f;
 		colorBlending.blendConstants[3] = 0.0f;
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
-
 		VkGraphicsPipelineCreateInfo pipelineInfo = {};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineInfo.stageCount = 2;
@@ -1384,17 +2195,129 @@ private:
 		pipelineInfo.pMultisampleState = &multisampling;
 		pipelineInfo.pDepthStencilState = &depthStencil;
 		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
 		pipelineInfo.layout = pipelineLayout;
 		pipelineInfo.renderPass = renderPass;
 		pipelineInfo.subpass = 0;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline!");
+		for (int shading = 0; shading < SHADING_COUNT; shading++) {
+			shaderStages[1].pSpecializationInfo = &fragmentSpecialization[shading];
+			if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipelines.graphics[shading]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create graphics pipeline!");
+			}
+		}
+
+		// Procedural sphere pipeline
+		// no vertex input, the vertex shader builds the sphere from gl_VertexIndex
+		auto proceduralShaderCode = readFile("shaders/vert_procedural.spv");
+		VkShaderModule proceduralShaderModule = createShaderModule(proceduralShaderCode);
+
+		VkSpecializationMapEntry tessEntry = {};
+		tessEntry.constantID = 0;
+		tessEntry.offset = 0;
+		tessEntry.size = sizeof(uint32_t);
+
+		uint32_t tessValue = variant.proceduralTess;
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &tessEntry;
+		specializationInfo.dataSize = sizeof(tessValue);
+		specializationInfo.pData = &tessValue;
+
+		VkPipelineShaderStageCreateInfo proceduralStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+		proceduralStages[0].module = proceduralShaderModule;
+		proceduralStages[0].pSpecializationInfo = &specializationInfo;
+
+		VkPipelineVertexInputStateCreateInfo emptyVertexInputInfo = {};
+		emptyVertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		pipelineInfo.pStages = proceduralStages;
+		pipelineInfo.pVertexInputState = &emptyVertexInputInfo;
+
+		for (int shading = 0; shading < SHADING_COUNT; shading++) {
+			proceduralStages[1].pSpecializationInfo = &fragmentSpecialization[shading];
+			if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipelines.procedural[shading]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create procedural graphics pipeline!");
+			}
+		}
+
+		// Dynamic body pipeline
+		// buffer-less sphere too, one instance per registry slot
+		auto dynamicShaderCode = readFile("shaders/vert_dynamic.spv");
+		VkShaderModule dynamicShaderModule = createShaderModule(dynamicShaderCode);
+
+		uint32_t dynamicTessValue = DYNAMIC_BODY_TESS;
+		VkSpecializationInfo dynamicSpecializationInfo = specializationInfo;
+		dynamicSpecializationInfo.pData = &dynamicTessValue;
+
+		VkPipelineShaderStageCreateInfo dynamicStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+		dynamicStages[0].module = dynamicShaderModule;
+		dynamicStages[0].pSpecializationInfo = &dynamicSpecializationInfo;
+
+		pipelineInfo.pStages = dynamicStages;
+		pipelineInfo.layout = dynamicPipelineLayout;
+
+		if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipelines.dynamic) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create dynamic body graphics pipeline!");
+		}
+		pipelineInfo.layout = pipelineLayout;
+
+		// Impostor pipeline
+		// a camera-facing quad from gl_VertexIndex, the fragment shader intersects the sphere and writes depth
+		auto impostorVertShaderCode = readFile("shaders/vert_impostor.spv");
+		auto impostorFragShaderCode = readFile("shaders/frag_impostor.spv");
+		VkShaderModule impostorVertShaderModule = createShaderModule(impostorVertShaderCode);
+		VkShaderModule impostorFragShaderModule = createShaderModule(impostorFragShaderCode);
+
+		VkPipelineShaderStageCreateInfo impostorStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+		impostorStages[0].module = impostorVertShaderModule;
+		impostorStages[1].module = impostorFragShaderModule;
+
+		VkPipelineRasterizationStateCreateInfo impostorRasterizer = rasterizer;
+		impostorRasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		impostorRasterizer.cullMode = VK_CULL_MODE_NONE;
+
+		pipelineInfo.pStages = impostorStages;
+		pipelineInfo.pRasterizationState = &impostorRasterizer;
+
+		for (int shading = 0; shading < SHADING_COUNT; shading++) {
+			impostorStages[1].pSpecializationInfo = &fragmentSpecialization[shading];
+			if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipelines.impostor[shading]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create impostor graphics pipeline!");
+			}
+		}
+
+		// Transparent pipeline
+		// same shaders and vertex format as the opaque one, blended and without depth write
+		VkPipelineColorBlendAttachmentState transparentBlendAttachment = colorBlendAttachment;
+		transparentBlendAttachment.blendEnable = VK_TRUE;
+
+		VkPipelineColorBlendStateCreateInfo transparentBlending = colorBlending;
+		transparentBlending.pAttachments = &transparentBlendAttachment;
+
+		VkPipelineDepthStencilStateCreateInfo transparentDepthStencil = depthStencil;
+		transparentDepthStencil.depthWriteEnable = VK_FALSE;
+
+		shaderStages[1].pSpecializationInfo = &fragmentSpecialization[SHADING_COUNT];
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pColorBlendState = &transparentBlending;
+		pipelineInfo.pDepthStencilState = &transparentDepthStencil;
+
+		if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipelines.transparent) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transparent graphics pipeline!");
 		}
 
+		vkDestroyShaderModule(device, impostorFragShaderModule, nullptr);
+		vkDestroyShaderModule(device, impostorVertShaderModule, nullptr);
+		vkDestroyShaderModule(device, dynamicShaderModule, nullptr);
+		vkDestroyShaderModule(device, proceduralShaderModule, nullptr);
 		vkDestroyShaderModule(device, fragShaderModule, nullptr);
 		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+		return pipelines;
 	}
 
 
@@ -1466,20 +2389,87 @@ private:
 		VkCommandPoolCreateInfo poolInfo = {};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // command buffers are re-recorded one by one
 
 		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create command pool!");
 		}
 
+		// upload command buffers are short-lived
+		poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create transfer command pool!");
+		}
+
+		// culling command buffers are recorded once for each swapchain image
+		poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+		poolInfo.flags = 0;
+
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute command pool!");
+		}
+
+	}
+
+
+	//// Compute Pipeline (culling)
+
+	void createComputePipeline() {
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+		for (uint32_t i = 0; i < 2; i++) {
+			bindings[i].binding = i; // 0 : CullingInput, 1 : BodyDrawCommands
+			bindings[i].descriptorCount = 1;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].pImmutableSamplers = nullptr;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &computeDescriptorSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute descriptor set layout!");
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &computeDescriptorSetLayout;
+
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline layout!");
+		}
+
+		auto compShaderCode = readFile("shaders/comp_cull.spv");
+		VkShaderModule compShaderModule = createShaderModule(compShaderCode);
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = computePipelineLayout;
+
+		if (vkCreateComputePipelines(device, pipelineManager.pipelineCache(), 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+
+		vkDestroyShaderModule(device, compShaderModule, nullptr);
 	}
 
 
 	//// Depth Image Resources
 
+	// the depth is cleared on load and never stored, it only lives inside the scene pass (a transient attachment)
 	void createDepthResources() {
 		VkFormat depthFormat = findDepthFormat();
 
-		createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+		createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
 		depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 	}
 
@@ -1515,72 +2505,224 @@ private:
 
 	//// Texture Image
 
-	void createWhiteDotImage(VkImage& targetImage, VkDeviceMemory& targetImageMemory) {
-
-		stbi_uc pixels[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
-		int texWidth = 1, texHeight = 1;
-		VkDeviceSize imageSize = 4;
+	void createDotImage(uint32_t textureIndex, std::vector<uint8_t> texel, VkFormat format) {
 
-		//  Ʒ ޼ 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		TextureMipChain chain;
+		chain.width = 1;
+		chain.height = 1;
+		chain.levels.push_back(std::move(texel));
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(device, stagingBufferMemory);
+		createTextureFromChain(chain, format, textureImage[textureIndex], textureImageMemory[textureIndex]);
+		textureMipLevels[textureIndex] = 1;
+		textureFormat[textureIndex] = format;
+	}
 
-		createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, targetImage, targetImageMemory);
+	// decodes the whole image to RGBA8
+	static bool loadTextureFile(const std::string& fileName, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height) {
+		int texWidth, texHeight, texChannels;
+		stbi_uc* data = stbi_load(fileName.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!data) return false;
 
-		transitionImageLayout(targetImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(stagingBuffer, targetImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		transitionImageLayout(targetImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		width = static_cast<uint32_t>(texWidth);
+		height = static_cast<uint32_t>(texHeight);
+		pixels.assign(data, data + size_t(texWidth) * texHeight * 4);
+		stbi_image_free(data);
+		return true;
+	}
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	// levels level .. 1x1 of an image (also called on the texture streaming thread)
+	// from the mip file of the image when there is one : only these levels are read. otherwise the whole image is decoded
+	// (stb_image cannot decode a JPEG at a reduced size)
+	static bool loadTextureLevels(const std::string& fileName, uint32_t level, TextureMipChain& chain) {
+		if (readMipFile(mipFilePath(fileName), level, chain)) return true;
 
+		std::vector<uint8_t> pixels;
+		uint32_t width, height;
+		if (!loadTextureFile(fileName, pixels, width, height)) return false;
+		chain = buildMipChain(std::move(pixels), width, height, level);
+		return true;
 	}
 
-	void createTextureImage(VkImage& targetImage, VkDeviceMemory& targetImageMemory, const char* fileName) {
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(fileName, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
+	// only the base mip chain is resident at first, TextureStreamer brings in the finer levels
+	// the size comes from the mip file or the image header, the levels finer than the base are not decoded when the mip file exists
+	void createTextureImage(uint32_t textureIndex, const char* fileName, VkFormat format) {
+		uint32_t texWidth, texHeight;
+		if (!readMipFileSize(mipFilePath(fileName), texWidth, texHeight)) {
+			int width, height, channels;
+			if (!stbi_info(fileName, &width, &height, &channels)) {
+				throw std::runtime_error("failed to load texture image!");
+			}
+			texWidth = static_cast<uint32_t>(width);
+			texHeight = static_cast<uint32_t>(height);
+			printf("> %s : no mip file (--build-mips), its loads decode the whole image\n", fileName);
+		}
 
-		if (!pixels) {
+		uint32_t baseLevel = TextureStreamer::baseLevel(texWidth, texHeight);
+		TextureMipChain chain;
+		if (!loadTextureLevels(fileName, baseLevel, chain)) {
 			throw std::runtime_error("failed to load texture image!");
 		}
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		createTextureFromChain(chain, format, textureImage[textureIndex], textureImageMemory[textureIndex]);
+		textureMipLevels[textureIndex] = static_cast<uint32_t>(chain.levels.size());
+		textureFormat[textureIndex] = format;
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(device, stagingBufferMemory);
+		textureStreamIndex[textureIndex] = textureStreamer.add(fileName, texWidth, texHeight, baseLevel);
+		streamTextureIndex.push_back(textureIndex);
+	}
+
+	void createTextureFromChain(const TextureMipChain& chain, VkFormat format, VkImage& targetImage, VkDeviceMemory& targetImageMemory) {
+		VkDeviceSize imageSize = chain.bytes();
+		uint32_t mipLevels = static_cast<uint32_t>(chain.levels.size());
+
+		// levels back to back, the order of the copy regions in copyBufferToImage()
+		StagingAllocation staging = allocateStaging(imageSize);
+		size_t offset = 0;
+		for (auto& level : chain.levels) {
+			memcpy(staging.data + offset, level.data(), level.size());
+			offset += level.size();
+		}
+
+		// transfer source : the streamer drops levels by copying the coarser ones into a smaller image
+		createImage(chain.width, chain.height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, targetImage, targetImageMemory, mipLevels);
+
+		uploadImage(staging, targetImage, chain.width, chain.height, mipLevels);
+	}
+
+	void destroyTexture(VkImage image, VkImageView view, VkDeviceMemory memory) {
+		vkDestroyImageView(device, view, nullptr);
+		vkDestroyImage(device, image, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+	// texels a body needs across the width of its textures : about its circumference on screen
+	void requestTextureDetail(const Planet& planet, const glm::mat4& model) {
+		glm::vec3 center = glm::vec3(model[3]);
+		if (!isSphereVisible(cameraInfo.projMatrix * cameraInfo.viewMatrix, center, planet.radius)) return;
+
+		float distance = -(cameraInfo.viewMatrix * glm::vec4(center, 1.0f)).z;
+		float pixels = distance > planet.radius ? planet.radius * fabs(cameraInfo.projMatrix[1][1]) * 0.5f * swapChainExtent.height / distance : float(swapChainExtent.height);
+		float texels = 2.0f * PI * pixels;
+
+		for (uint texture : { planet.texture_index, planet.alpha_index, normalTexture(planet.texture_index), bumpTexture(planet.texture_index) }) {
+			if (textureStreamIndex[texture] != UINT32_MAX) textureStreamer.request(textureStreamIndex[texture], texels);
+		}
+	}
+
+	// upload what the loader finished (or drop evicted levels), and point the descriptor sets of this image at the new textures
+	// (returns true when the command buffer of the image has to be recorded again)
+	bool streamTextures(uint32_t imageIndex) {
+		TextureStreamer::Result result;
+		while (textureStreamer.poll(result)) {
+			uint texture = streamTextureIndex[result.texture];
+
+			// the previous image stays alive until no descriptor set of any frame in flight uses it
+			retiredTextures.push_back({ texture, textureImage[texture], textureImageView[texture], textureImageMemory[texture], swapChainImages.size() });
+
+			if (result.drop) {
+				VkImage source = textureImage[texture];
+				uint32_t levelCount = 1;
+				for (uint32_t width = result.chain.width, height = result.chain.height; width > 1 || height > 1; levelCount++) {
+					width = width > 1 ? width / 2 : 1;
+					height = height > 1 ? height / 2 : 1;
+				}
+				createImage(result.chain.width, result.chain.height, textureFormat[texture], VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage[texture], textureImageMemory[texture], levelCount);
+				pendingTextureDrops.push_back({ source, textureImage[texture], textureMipLevels[texture] - levelCount, levelCount, result.chain.width, result.chain.height });
+				textureMipLevels[texture] = levelCount;
+			}
+			else {
+				createTextureFromChain(result.chain, textureFormat[texture], textureImage[texture], textureImageMemory[texture]);
+				textureMipLevels[texture] = static_cast<uint32_t>(result.chain.levels.size());
+			}
+			textureImageView[texture] = createImageView(textureImage[texture], textureFormat[texture], VK_IMAGE_ASPECT_COLOR_BIT, textureMipLevels[texture]);
+
+			for (auto& stale : staleTextureDescriptors) stale.push_back(texture);
+			printf("> texture %u : %ux%u%s, %.1f / %zu MB resident\n", texture, result.chain.width, result.chain.height, result.drop ? " (evicted)" : "", textureStreamer.residentBytes() / 1048576.0, textureStreamer.budgetBytes() >> 20);
+		}
+
+		std::vector<uint>& stale = staleTextureDescriptors[imageIndex];
+		if (stale.empty()) return false;
+
+		std::sort(stale.begin(), stale.end());
+		stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+		for (uint texture : stale) {
+			updateTextureDescriptors(imageIndex, texture);
+			for (auto& retired : retiredTextures) {
+				if (retired.texture == texture) retired.imagesLeft--;
+			}
+		}
+		stale.clear();
+
+		size_t kept = 0;
+		for (size_t i = 0; i < retiredTextures.size(); i++) {
+			if (retiredTextures[i].imagesLeft == 0) {
+				RetiredTexture retired = retiredTextures[i];
+				frameScheduler.defer([=]() { destroyTexture(retired.image, retired.view, retired.memory); });
+			}
+			else retiredTextures[kept++] = retiredTextures[i];
+		}
+		retiredTextures.resize(kept);
+		return true;
+	}
 
-		stbi_image_free(pixels);
+	// texSampler[] of a body : its colour and alpha textures, the normal and bump maps of the colour texture
+	std::array<VkDescriptorImageInfo, BODY_TEXTURE_COUNT> bodyImageInfos(uint colorTexture, uint alphaTexture) {
+		uint textures[BODY_TEXTURE_COUNT] = { colorTexture, alphaTexture, normalTexture(colorTexture), bumpTexture(colorTexture) };
+		std::array<VkDescriptorImageInfo, BODY_TEXTURE_COUNT> imageInfos = {};
+		for (uint32_t i = 0; i < BODY_TEXTURE_COUNT; i++) {
+			imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfos[i].imageView = textureImageView[textures[i]];
+			imageInfos[i].sampler = textureSampler;
+		}
+		return imageInfos;
+	}
 
-		createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, targetImage, targetImageMemory);
+	// the samplers of every descriptor set of the image that uses the texture
+	void updateTextureDescriptors(uint32_t imageIndex, uint texture) {
+		auto usesTexture = [&](uint colorTexture, uint alphaTexture) {
+			return colorTexture == texture || alphaTexture == texture || normalTexture(colorTexture) == texture || bumpTexture(colorTexture) == texture;
+		};
+		auto writeSamplers = [&](VkDescriptorSet descriptorSet, uint colorTexture, uint alphaTexture) {
+			auto imageInfos = bodyImageInfos(colorTexture, alphaTexture);
+
+			VkWriteDescriptorSet descriptorWrite = {};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = descriptorSet;
+			descriptorWrite.dstBinding = 1;
+			descriptorWrite.dstArrayElement = 0;
+			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+			descriptorWrite.pImageInfo = imageInfos.data();
+			vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+		};
 
-		transitionImageLayout(targetImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(stagingBuffer, targetImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		transitionImageLayout(targetImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		for (int n = 0; n < (int)planet_list.size(); n++) {
+			if (usesTexture(planet_list[n].texture_index, planet_list[n].alpha_index)) {
+				writeSamplers(descriptorSets[n][imageIndex], planet_list[n].texture_index, planet_list[n].alpha_index);
+			}
+		}
+		if (usesTexture(DYNAMIC_BODY_TEXTURE_INDEX, WHITE_TEXTURE_INDEX)) {
+			writeSamplers(dynamicDescriptorSets[imageIndex], DYNAMIC_BODY_TEXTURE_INDEX, WHITE_TEXTURE_INDEX);
+		}
+	}
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	void resetTextureDescriptorUpdates() {
+		staleTextureDescriptors.assign(swapChainImages.size(), {});
+		for (auto& retired : retiredTextures) {
+			frameScheduler.defer([=]() { destroyTexture(retired.image, retired.view, retired.memory); });
+		}
+		retiredTextures.clear();
 	}
 
 
-	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t mipLevels = 1) {
 		VkImageCreateInfo imageInfo = {};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageInfo.extent.width = width;
 		imageInfo.extent.height = height;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
+		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = 1;
 		imageInfo.format = format;
 		imageInfo.tiling = tiling;
@@ -1601,6 +2743,12 @@ private:
 		allocInfo.allocationSize = memRequirements.size;
 		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
+		// transient attachments take lazily allocated memory where the image can : a tile based GPU then never backs them
+		VkMemoryPropertyFlags lazyProperties = properties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+		if ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && hasMemoryType(lazyProperties, memRequirements.memoryTypeBits)) {
+			allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, lazyProperties);
+		}
+
 		if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate image memory!");
 		}
@@ -1608,76 +2756,76 @@ private:
 		vkBindImageMemory(device, image, imageMemory, 0);
 	}
 
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	// UNDEFINED -> TRANSFER_DST -> copy -> SHADER_READ_ONLY, on the transfer queue
+	// the staging allocation holds mipLevels levels back to back
+	void uploadImage(const StagingAllocation& staging, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels = 1) {
+		VkCommandBuffer commandBuffer = beginUploadCommands();
 
 		VkImageMemoryBarrier barrier = {};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.oldLayout = oldLayout;
-		barrier.newLayout = newLayout;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.image = image;
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.levelCount = mipLevels;
 		barrier.subresourceRange.baseArrayLayer = 0;
 		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-		VkPipelineStageFlags sourceStage;
-		VkPipelineStageFlags destinationStage;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		copyBufferToImage(commandBuffer, staging.buffer, staging.offset, image, width, height, mipLevels);
 
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		// the layout transition is a part of the ownership transfer : the release here and the acquire in the next frame both carry it
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		if (hasDedicatedTransferQueue()) {
+			barrier.srcQueueFamilyIndex = transferQueueFamily;
+			barrier.dstQueueFamilyIndex = graphicsQueueFamily;
 		}
-		else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		}
-		else {
-			throw std::invalid_argument("unsupported layout transition!");
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		if (hasDedicatedTransferQueue()) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			pendingImageAcquires.push_back(barrier);
 		}
 
-		vkCmdPipelineBarrier(
-			commandBuffer,
-			sourceStage, destinationStage,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
+		endUploadCommands(commandBuffer);
+	}
 
-		endSingleTimeCommands(commandBuffer);
-	}
-
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkBufferImageCopy region = {};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = {
-			width,
-			height,
-			1
-		};
+	void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels = 1) {
+		std::vector<VkBufferImageCopy> regions(mipLevels);
+
+		for (uint32_t level = 0; level < mipLevels; level++) {
+			VkBufferImageCopy& region = regions[level];
+			region.bufferOffset = offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = {
+				width,
+				height,
+				1
+			};
 
-		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+			offset += VkDeviceSize(width) * height * 4;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
 
-		endSingleTimeCommands(commandBuffer);
+		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
 	}
 
 
@@ -1686,11 +2834,11 @@ private:
 	void createTextureImageView() {
 		textureImageView.resize(textureImage.size());
 		for (int i = 0; i < (int)textureImage.size(); i++) {
-			textureImageView[i] = createImageView(textureImage[i], VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+			textureImageView[i] = createImageView(textureImage[i], textureFormat[i], VK_IMAGE_ASPECT_COLOR_BIT, textureMipLevels[i]);
 		}
 	}
 
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1) {
 		VkImageViewCreateInfo viewInfo = {};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image = image;
@@ -1698,7 +2846,7 @@ private:
 		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = aspectFlags;
 		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 
@@ -1725,6 +2873,8 @@ private:
 		samplerInfo.compareEnable = VK_FALSE;
 		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // every resident mip
 
 		if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create texture sampler!");
@@ -1734,52 +2884,87 @@ private:
 
 	//// Vertex Buffer, Index Buffer
 
-	void createVertexBuffer(std::vector<Vertex>& vertexList, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory) {
-		VkDeviceSize bufferSize = sizeof(vertexList[0]) * vertexList.size();
+	// upload the mesh in the current vertex format
+	void createMeshVertexBuffer(std::vector<Vertex>& vertexList, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory) {
+		switch (vertexFormat) {
+		case VERTEX_FORMAT_PACKED: {
+			std::vector<PackedVertex> packedList;
+			for (auto& v : vertexList) packedList.push_back(PackedVertex::pack(v));
+			createVertexBuffer(packedList, vertexBuffer, vertexBufferMemory);
+			break;
+		}
+		case VERTEX_FORMAT_POSITION: {
+			std::vector<PositionVertex> packedList;
+			for (auto& v : vertexList) packedList.push_back(PositionVertex::pack(v));
+			createVertexBuffer(packedList, vertexBuffer, vertexBufferMemory);
+			break;
+		}
+		default:
+			createVertexBuffer(vertexList, vertexBuffer, vertexBufferMemory);
+			break;
+		}
+	}
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	// vertex format changed at runtime
+	void recreateVertexBuffers() {
+
+		// the old buffers are destroyed once the frames that may use them are complete
+		VkDevice logicalDevice = device;
+		VkBuffer buffers[] = { planetVertexBuffer, ringVertexBuffer };
+		VkDeviceMemory memories[] = { planetVertexBufferMemory, ringVertexBufferMemory };
+		frameScheduler.defer([=]() {
+			for (int i = 0; i < 2; i++) {
+				vkDestroyBuffer(logicalDevice, buffers[i], nullptr);
+				vkFreeMemory(logicalDevice, memories[i], nullptr);
+			}
+		});
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertexList.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
+		createMeshVertexBuffer(planet_vertex_list, planetVertexBuffer, planetVertexBufferMemory);
+		createMeshVertexBuffer(ring_vertex_list, ringVertexBuffer, ringVertexBufferMemory);
+	}
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+	template <typename T>
+	void createVertexBuffer(std::vector<T>& vertexList, VkBuffer& vertexBuffer, VkDeviceMemory& vertexBufferMemory) {
+		VkDeviceSize bufferSize = sizeof(vertexList[0]) * vertexList.size();
+
+		StagingAllocation staging = allocateStaging(bufferSize);
+		memcpy(staging.data, vertexList.data(), (size_t)bufferSize);
 
-		copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		uploadBuffer(staging, vertexBuffer, bufferSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 	}
 
-	void createIndexBuffer(std::vector<uint>& indexList, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory) {
-		VkDeviceSize bufferSize = sizeof(indexList[0]) * indexList.size();
+	void createIndexBuffer(std::vector<uint>& indexList, VkBuffer& indexBuffer, VkDeviceMemory& indexBufferMemory, VkIndexType& indexType) {
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		// use 16-bit indices whenever the mesh fits into it (half of the index bandwidth)
+		std::vector<uint16_t> indexList16;
+		bool use16 = packIndices16(indexList, indexList16);
+		indexType = use16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indexList.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
+		VkDeviceSize bufferSize = use16 ? sizeof(indexList16[0]) * indexList16.size() : sizeof(indexList[0]) * indexList.size();
+		const void* indexData = use16 ? (const void*)indexList16.data() : (const void*)indexList.data();
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+		StagingAllocation staging = allocateStaging(bufferSize);
+		memcpy(staging.data, indexData, (size_t)bufferSize);
 
-		copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		uploadBuffer(staging, indexBuffer, bufferSize, VK_ACCESS_INDEX_READ_BIT);
 	}
 
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+	// sharedQueueFamilies : the buffer is used by more than one queue family without ownership transfers
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::vector<uint32_t>& sharedQueueFamilies = {}) {
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
 		bufferInfo.usage = usage;
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (sharedQueueFamilies.size() > 1) {
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+			bufferInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
+		}
 
 		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create buffer!");
@@ -1801,11 +2986,83 @@ private:
 	}
 
 
-	VkCommandBuffer beginSingleTimeCommands() {
+	//// Upload
+
+	// uploads are recorded on the transfer queue and signal a semaphore the next frame waits for, so neither queue is idled.
+	// their sources are sub-allocated from the staging ring, whose regions retire on the fence of the upload submission.
+	// with a transfer-only family, buffers and images are released to the graphics family here and acquired in acquireUploads().
+	static const VkPipelineStageFlags UPLOAD_DST_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	// where the frame command buffer leaves the swapchain image in present layout, and where the capture copy picks it up
+	static const VkPipelineStageFlags PRESENT_HANDOFF_STAGE = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	static const VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+	static const VkDeviceSize STAGING_ALIGNMENT = 16; // a multiple of the texel size, for the image copies
+
+	bool hasDedicatedTransferQueue() {
+		return transferQueueFamily != graphicsQueueFamily;
+	}
+
+	void createStagingRing() {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		createBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+		stagingRing.create(device, buffer, memory, STAGING_RING_SIZE);
+	}
+
+	// mapped source memory for one upload, recorded by the next uploadBuffer() or uploadImage()
+	// larger than the ring (a full resolution texture chain) : a buffer of its own, released once the next frame is complete
+	StagingAllocation allocateStaging(VkDeviceSize size) {
+		StagingAllocation allocation;
+		if (stagingRing.allocate(size, STAGING_ALIGNMENT, allocation)) return allocation;
+
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+		void* data;
+		vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+
+		// the next submitted frame waits for the upload, so its completion covers the transfer too
+		VkDevice logicalDevice = device;
+		frameScheduler.defer([=]() {
+			vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+			vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+		});
+		return { stagingBuffer, 0, static_cast<uint8_t*>(data) };
+	}
+
+	void createUploadSync() {
+		if (!timelineSemaphoreSupported) return;
+
+		VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &uploadTimeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload timeline semaphore!");
+		}
+	}
+
+	// the device must be idle, and the deferred deletions run (the pooled semaphores are back)
+	void destroyUploadSync() {
+		if (uploadTimeline != VK_NULL_HANDLE) vkDestroySemaphore(device, uploadTimeline, nullptr);
+		uploadTimeline = VK_NULL_HANDLE;
+		for (VkSemaphore semaphore : uploadSemaphorePool) vkDestroySemaphore(device, semaphore, nullptr);
+		uploadSemaphorePool.clear();
+		pendingUploadSemaphores.clear();
+	}
+
+	VkCommandBuffer beginUploadCommands() {
 		VkCommandBufferAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
+		allocInfo.commandPool = transferCommandPool;
 		allocInfo.commandBufferCount = 1;
 
 		VkCommandBuffer commandBuffer;
@@ -1820,38 +3077,204 @@ private:
 		return commandBuffer;
 	}
 
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+	void endUploadCommands(VkCommandBuffer commandBuffer) {
 		vkEndCommandBuffer(commandBuffer);
 
+		VkSemaphore uploadSemaphore = uploadTimeline;
+		if (uploadSemaphore == VK_NULL_HANDLE) {
+			if (uploadSemaphorePool.empty()) {
+				VkSemaphoreCreateInfo semaphoreInfo = {};
+				semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+				if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &uploadSemaphore) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create upload semaphore!");
+				}
+			}
+			else {
+				uploadSemaphore = uploadSemaphorePool.back();
+				uploadSemaphorePool.pop_back();
+			}
+		}
+
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &uploadSemaphore;
+
+		uint64_t signalValue = uploadValue + 1;
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+		if (uploadTimeline != VK_NULL_HANDLE) {
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &signalValue;
+			submitInfo.pNext = &timelineInfo;
+		}
 
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, stagingRing.submitFence()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+		uploadValue = signalValue;
+
+		// the next submitted frame waits for the upload, so its completion covers the transfer too
+		VkDevice logicalDevice = device;
+		VkCommandPool pool = transferCommandPool;
+		frameScheduler.defer([=]() { vkFreeCommandBuffers(logicalDevice, pool, 1, &commandBuffer); });
+		if (uploadTimeline == VK_NULL_HANDLE) {
+			pendingUploadSemaphores.push_back(uploadSemaphore);
+			std::vector<VkSemaphore>* semaphorePool = &uploadSemaphorePool;
+			frameScheduler.defer([=]() { semaphorePool->push_back(uploadSemaphore); });
+		}
+	}
 
-		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	// the kept levels of the resident image into the smaller one. the resident image is read by the earlier frames (and
+	// by the descriptor sets not updated yet), so it goes back to shader read afterwards
+	void recordTextureLevelDrop(VkCommandBuffer commandBuffer, const TextureLevelDrop& drop) {
+		std::array<VkImageMemoryBarrier, 2> barriers = {};
+		for (auto& barrier : barriers) {
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+		}
+		barriers[0].image = drop.source;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[0].subresourceRange.baseMipLevel = drop.firstLevel;
+		barriers[0].subresourceRange.levelCount = drop.levelCount;
+		barriers[1].image = drop.target;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].srcAccessMask = 0;
+		barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].subresourceRange.baseMipLevel = 0;
+		barriers[1].subresourceRange.levelCount = drop.levelCount;
+
+		// all commands : the sampling of the frames before, and the acquire barriers just recorded
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		std::vector<VkImageCopy> regions(drop.levelCount);
+		uint32_t width = drop.width, height = drop.height;
+		for (uint32_t level = 0; level < drop.levelCount; level++) {
+			VkImageCopy& region = regions[level];
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, drop.firstLevel + level, 0, 1 };
+			region.srcOffset = { 0, 0, 0 };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			region.dstOffset = { 0, 0, 0 };
+			region.extent = { width, height, 1 };
+
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		vkCmdCopyImage(commandBuffer, drop.source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, drop.target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
 	}
 
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	void uploadBuffer(const StagingAllocation& staging, VkBuffer dstBuffer, VkDeviceSize size, VkAccessFlags dstAccessMask) {
+		VkCommandBuffer commandBuffer = beginUploadCommands();
 
 		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = staging.offset;
 		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+		vkCmdCopyBuffer(commandBuffer, staging.buffer, dstBuffer, 1, &copyRegion);
 
-		endSingleTimeCommands(commandBuffer);
-	}
+		// on the same family the semaphore alone makes the copy visible
+		if (hasDedicatedTransferQueue()) {
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = transferQueueFamily;
+			barrier.dstQueueFamilyIndex = graphicsQueueFamily;
+			barrier.buffer = dstBuffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
 
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
 
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = dstAccessMask;
+			pendingBufferAcquires.push_back(barrier);
+		}
+
+		endUploadCommands(commandBuffer);
+	}
+
+	// graphics side of the pending uploads : wait for their semaphores, and record the acquire barriers ahead of the frame
+	// (and the copies of the dropped texture levels, after them)
+	// waitValues : the value of each wait semaphore (0 for the binary ones)
+	void acquireUploads(std::vector<VkSemaphore>& waitSemaphores, std::vector<uint64_t>& waitValues, std::vector<VkPipelineStageFlags>& waitStages, std::vector<VkCommandBuffer>& submitCommandBuffers) {
+		// the uploads signal the timeline in submission order : the last value covers all of them
+		if (uploadTimeline != VK_NULL_HANDLE && uploadValue > uploadWaitedValue) {
+			waitSemaphores.push_back(uploadTimeline);
+			waitValues.push_back(uploadValue);
+			waitStages.push_back(UPLOAD_DST_STAGES);
+			uploadWaitedValue = uploadValue;
+		}
+		for (auto semaphore : pendingUploadSemaphores) {
+			waitSemaphores.push_back(semaphore);
+			waitValues.push_back(0);
+			waitStages.push_back(UPLOAD_DST_STAGES);
+		}
+		pendingUploadSemaphores.clear();
+
+		if (pendingBufferAcquires.empty() && pendingImageAcquires.empty() && pendingTextureDrops.empty()) return;
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		if (!pendingBufferAcquires.empty() || !pendingImageAcquires.empty()) {
+			vkCmdPipelineBarrier(commandBuffer, UPLOAD_DST_STAGES, UPLOAD_DST_STAGES, 0, 0, nullptr,
+				static_cast<uint32_t>(pendingBufferAcquires.size()), pendingBufferAcquires.data(),
+				static_cast<uint32_t>(pendingImageAcquires.size()), pendingImageAcquires.data());
+		}
+		for (const TextureLevelDrop& drop : pendingTextureDrops) recordTextureLevelDrop(commandBuffer, drop);
+		vkEndCommandBuffer(commandBuffer);
+
+		pendingBufferAcquires.clear();
+		pendingImageAcquires.clear();
+		pendingTextureDrops.clear();
+		submitCommandBuffers.push_back(commandBuffer);
+
+		VkDevice logicalDevice = device;
+		VkCommandPool pool = commandPool;
+		frameScheduler.defer([=]() {
+			vkFreeCommandBuffers(logicalDevice, pool, 1, &commandBuffer);
+		});
+	}
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
 		}
 
 		throw std::runtime_error("failed to find suitable memory type!");
@@ -1872,47 +3295,464 @@ private:
 		}
 	}
 
-	void updateUniformBuffer(uint32_t currentImage) {
+	void createIndirectBuffers() {
+		// followed by the draw of the dynamic bodies
+		VkDeviceSize bufferSize = dynamicDrawOffset() + sizeof(VkDrawIndirectCommand);
 
-		auto checkTime = std::chrono::high_resolution_clock::now();
-		float elapsedTime = std::chrono::duration<float, std::chrono::seconds::period>(checkTime - currentTime).count();
-		currentTime = checkTime;
+		indirectBuffers.resize(swapChainImages.size());
+		indirectBuffersMemory.resize(swapChainImages.size());
+		indirectBuffersMapped.resize(swapChainImages.size());
 
-		//  ȯ ׻ ̴. rotate ׻ ߾  Ѵ.
-		for (int i = 0; i < (int)planet_list.size(); i++) {
+		// written by the compute queue, read by the graphics queue : small enough to share concurrently every frame
+		std::vector<uint32_t> sharedQueueFamilies;
+		if (computeQueueFamily != graphicsQueueFamily) sharedQueueFamilies = { graphicsQueueFamily, computeQueueFamily };
 
-			planet_list[i].time_process(elapsedTime);
-
-			UniformBufferObject ubo = {};
-			ubo.model = glm::mat4(1.0f);
-
-			// child planet process
-			if (planet_list.at(i).parent_index != -1) {
-				uint parent_index = planet_list.at(i).parent_index;
-				// parent position, revolution process
-				ubo.model = glm::rotate(ubo.model, planet_list.at(parent_index).revolution_theta, glm::vec3(0.0f, 0.0f, 1.0f));
-				ubo.model = glm::translate(ubo.model, glm::vec3(planet_list.at(parent_index).distance, 0.0f, 0.0f));
-				// child position, revolution process
-				ubo.model = glm::rotate(ubo.model, planet_list.at(i).revolution_theta, glm::vec3(0.0f, 0.0f, 1.0f));
-				ubo.model = glm::translate(ubo.model, glm::vec3(planet_list.at(i).distance, 0.0f, 0.0f));
-				// parent rotation process
-				ubo.model = glm::rotate(ubo.model, planet_list.at(parent_index).rotation_theta, glm::vec3(0.0f, 0.0f, 1.0f));
-				// child rotation process
-				ubo.model = glm::rotate(ubo.model, planet_list.at(i).rotation_theta, glm::vec3(0.0f, 0.0f, 1.0f));
-				// resize
-				ubo.model = glm::scale(ubo.model, glm::vec3(planet_list.at(i).radius, planet_list.at(i).radius, planet_list.at(i).radius));
-			}
-			// normal planet process
-			else {
-				// position, revolution process
-				ubo.model = glm::rotate(ubo.model, planet_list.at(i).revolution_theta, glm::vec3(0.0f, 0.0f, 1.0f));
-				ubo.model = glm::translate(ubo.model, glm::vec3(planet_list.at(i).distance, 0.0f, 0.0f));
-				// rotation process
-				ubo.model = glm::rotate(ubo.model, planet_list.at(i).rotation_theta, glm::vec3(0.0f, 0.0f, 1.0f));
-				// resize
-				ubo.model = glm::scale(ubo.model, glm::vec3(planet_list.at(i).radius, planet_list.at(i).radius, planet_list.at(i).radius));
+		for (size_t i = 0; i < swapChainImages.size(); i++) {
+			createBuffer(bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indirectBuffers[i], indirectBuffersMemory[i], sharedQueueFamilies);
+
+			// persistently mapped, written in updateUniformBuffer() when culling on the CPU
+			void* data;
+			vkMapMemory(device, indirectBuffersMemory[i], 0, bufferSize, 0, &data);
+			indirectBuffersMapped[i] = reinterpret_cast<BodyDrawCommands*>(data);
+		}
+	}
+
+	// culling input buffers, their descriptor sets, the timestamp queries and the prerecorded dispatches of each image
+	void createCullingResources() {
+		size_t imageCount = swapChainImages.size();
+		VkDeviceSize bufferSize = sizeof(CullingInput) + sizeof(glm::mat4) * (planet_list.size() - 1);
+
+		cullingBuffers.resize(imageCount);
+		cullingBuffersMemory.resize(imageCount);
+		cullingBuffersMapped.resize(imageCount);
+		timingQueryPools.resize(imageCount);
+		imageComputeSubmitted.assign(imageCount, false);
+
+		for (size_t i = 0; i < imageCount; i++) {
+			createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, cullingBuffers[i], cullingBuffersMemory[i]);
+
+			void* data;
+			vkMapMemory(device, cullingBuffersMemory[i], 0, bufferSize, 0, &data);
+			cullingBuffersMapped[i] = reinterpret_cast<CullingInput*>(data);
+
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 4;
+
+			if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timingQueryPools[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timestamp query pool!");
+			}
+		}
+
+		// Descriptor Pool, Sets
+		VkDescriptorPoolSize poolSize = {};
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = static_cast<uint32_t>(imageCount) * 2;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = static_cast<uint32_t>(imageCount);
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &computeDescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(imageCount, computeDescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = computeDescriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(imageCount);
+		allocInfo.pSetLayouts = layouts.data();
+
+		computeDescriptorSets.resize(imageCount);
+		if (vkAllocateDescriptorSets(device, &allocInfo, computeDescriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate compute descriptor sets!");
+		}
+
+		for (size_t i = 0; i < imageCount; i++) {
+			std::array<VkDescriptorBufferInfo, 2> bufferInfos = {};
+			bufferInfos[0].buffer = cullingBuffers[i];
+			bufferInfos[0].offset = 0;
+			bufferInfos[0].range = VK_WHOLE_SIZE;
+			bufferInfos[1].buffer = indirectBuffers[i];
+			bufferInfos[1].offset = 0;
+			bufferInfos[1].range = VK_WHOLE_SIZE;
+
+			std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+			for (uint32_t b = 0; b < 2; b++) {
+				descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrites[b].dstSet = computeDescriptorSets[i];
+				descriptorWrites[b].dstBinding = b;
+				descriptorWrites[b].dstArrayElement = 0;
+				descriptorWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptorWrites[b].descriptorCount = 1;
+				descriptorWrites[b].pBufferInfo = &bufferInfos[b];
+			}
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+
+		// Command Buffers
+		computeCommandBuffers.resize(imageCount);
+
+		VkCommandBufferAllocateInfo commandAllocInfo = {};
+		commandAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandAllocInfo.commandPool = computeCommandPool;
+		commandAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandAllocInfo.commandBufferCount = static_cast<uint32_t>(imageCount);
+
+		if (vkAllocateCommandBuffers(device, &commandAllocInfo, computeCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate compute command buffers!");
+		}
+
+		for (size_t i = 0; i < imageCount; i++) {
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+			if (vkBeginCommandBuffer(computeCommandBuffers[i], &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("failed to begin recording compute command buffer!");
+			}
+
+			if (gpuTimingSupported) {
+				vkCmdResetQueryPool(computeCommandBuffers[i], timingQueryPools[i], 2, 2);
+				vkCmdWriteTimestamp(computeCommandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timingQueryPools[i], 2);
+			}
+
+			// the culling buffer is written by the host before the submit, the draws wait for the indirect buffer with a semaphore
+			RenderGraph graph;
+			RenderGraph::Resource culling = graph.importBuffer(cullingBuffers[i], { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED });
+			RenderGraph::Resource indirect = graph.importBuffer(indirectBuffers[i], { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED });
+
+			uint32_t cull = graph.addPass("cull", [&](VkCommandBuffer commandBuffer) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSets[i], 0, nullptr);
+				vkCmdDispatch(commandBuffer, static_cast<uint32_t>((planet_list.size() + 63) / 64), 1, 1);
+			});
+			graph.read(cull, culling, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+			graph.write(cull, indirect, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+
+			// the draw commands are read back for the impostor count once the frame is complete
+			graph.exportResource(indirect, { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+			graph.compile();
+			graph.execute(computeCommandBuffers[i]);
+
+			if (gpuTimingSupported) {
+				vkCmdWriteTimestamp(computeCommandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timingQueryPools[i], 3);
+			}
+
+			if (vkEndCommandBuffer(computeCommandBuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record compute command buffer!");
+			}
+		}
+	}
+
+	//// Dynamic Bodies
+
+	VkDeviceSize dynamicDrawOffset() {
+		return sizeof(BodyDrawCommands) * planet_list.size();
+	}
+
+	// the slots live on the host : spawning or removing a body is a single slot write there, each image copies the
+	// changed slots into its own instance buffer once its last frame is complete (a frame in flight never sees them change).
+	// the command buffers draw the whole range up to the high-water mark and never change
+	void createDynamicInstanceBuffer() {
+		dynamicInstances.assign(MAX_DYNAMIC_BODIES, { glm::vec4(0.0f), glm::vec4(0.0f) });
+		bodyRegistry.init(MAX_DYNAMIC_BODIES);
+	}
+
+	// per-image uniform buffers, instance buffers and descriptor sets of the dynamic body draw
+	void createDynamicBodyResources() {
+		size_t imageCount = swapChainImages.size();
 
+		dynamicUniformBuffers.resize(imageCount);
+		dynamicUniformBuffersMemory.resize(imageCount);
+		for (size_t i = 0; i < imageCount; i++) {
+			createBuffer(sizeof(UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, dynamicUniformBuffers[i], dynamicUniformBuffersMemory[i]);
+		}
+
+		// a new image starts with every slot
+		VkDeviceSize instanceBufferSize = sizeof(DynamicBodyInstance) * MAX_DYNAMIC_BODIES;
+		dynamicInstanceBuffers.resize(imageCount);
+		dynamicInstanceBuffersMemory.resize(imageCount);
+		dynamicInstancesMapped.resize(imageCount);
+		dynamicInstanceChanges.assign(imageCount, std::vector<uint32_t>());
+		for (size_t i = 0; i < imageCount; i++) {
+			createBuffer(instanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, dynamicInstanceBuffers[i], dynamicInstanceBuffersMemory[i]);
+
+			void* data;
+			vkMapMemory(device, dynamicInstanceBuffersMemory[i], 0, instanceBufferSize, 0, &data);
+			dynamicInstancesMapped[i] = reinterpret_cast<DynamicBodyInstance*>(data);
+			memcpy(data, dynamicInstances.data(), static_cast<size_t>(instanceBufferSize));
+		}
+
+		std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		poolSizes[0].descriptorCount = static_cast<uint32_t>(imageCount) * 2;
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].descriptorCount = static_cast<uint32_t>(imageCount) * BODY_TEXTURE_COUNT;
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[2].descriptorCount = static_cast<uint32_t>(imageCount);
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = static_cast<uint32_t>(imageCount);
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &dynamicDescriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create dynamic body descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(imageCount, dynamicDescriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = dynamicDescriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(imageCount);
+		allocInfo.pSetLayouts = layouts.data();
+
+		dynamicDescriptorSets.resize(imageCount);
+		if (vkAllocateDescriptorSets(device, &allocInfo, dynamicDescriptorSets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate dynamic body descriptor sets!");
+		}
+
+		for (size_t i = 0; i < imageCount; i++) {
+			VkDescriptorBufferInfo bufferInfo = {};
+			bufferInfo.buffer = dynamicUniformBuffers[i];
+			bufferInfo.offset = 0;
+			bufferInfo.range = sizeof(UniformBufferObject);
+
+			// asteroids : moon texture, opaque
+			auto imageInfos = bodyImageInfos(DYNAMIC_BODY_TEXTURE_INDEX, WHITE_TEXTURE_INDEX);
+
+			VkDescriptorBufferInfo instanceInfo = {};
+			instanceInfo.buffer = dynamicInstanceBuffers[i];
+			instanceInfo.offset = 0;
+			instanceInfo.range = VK_WHOLE_SIZE;
+
+			std::array<VkWriteDescriptorSet, 4> descriptorWrites = {};
+			for (uint32_t b = 0; b < 4; b++) {
+				descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrites[b].dstSet = dynamicDescriptorSets[i];
+				descriptorWrites[b].dstBinding = b;
+				descriptorWrites[b].dstArrayElement = 0;
+				descriptorWrites[b].descriptorCount = 1;
+			}
+			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrites[0].pBufferInfo = &bufferInfo;
+			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			descriptorWrites[1].descriptorCount = static_cast<uint32_t>(imageInfos.size());
+			descriptorWrites[1].pImageInfo = imageInfos.data();
+			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrites[2].pBufferInfo = &bufferInfo;
+			descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[3].pBufferInfo = &instanceInfo;
+
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
+	}
+
+	// invalid handle when the instance buffer is full
+	BodyHandle spawnBody(const DynamicBodyInstance& instance) {
+		BodyHandle handle = bodyRegistry.create();
+		if (handle.valid()) {
+			dynamicInstances[handle.slot] = instance;
+			dynamicInstances[handle.slot].body.z = 1.0f; // alive
+			changeDynamicInstance(handle.slot);
+		}
+		return handle;
+	}
+
+	// the body disappears from the next frame, its slot is reused once the frames in flight are complete
+	bool destroyBody(BodyHandle handle) {
+		if (!bodyRegistry.destroy(handle)) return false;
+
+		dynamicInstances[handle.slot].body.z = 0.0f;
+		changeDynamicInstance(handle.slot);
+		uint32_t slot = handle.slot;
+		BodyRegistry* registry = &bodyRegistry;
+		frameScheduler.defer([=]() { registry->recycle(slot); });
+		return true;
+	}
+
+	void changeDynamicInstance(uint32_t slot) {
+		for (std::vector<uint32_t>& changes : dynamicInstanceChanges) changes.push_back(slot);
+	}
+
+	// a belt between Mars and Jupiter
+	void spawnAsteroids(uint count) {
+		auto random = [](float a, float b) { return a + (b - a) * float(rand()) / float(RAND_MAX); };
+
+		for (uint i = 0; i < count; i++) {
+			DynamicBodyInstance instance;
+			float distance = random(27.0f, 33.0f);
+			instance.orbit = glm::vec4(distance, 2.0f * PI / (distance * 0.2f), random(0.0f, 2.0f * PI), random(-0.05f, 0.05f));
+			instance.body = glm::vec4(random(0.05f, 0.2f), random(-3.0f, 3.0f), 1.0f, 0.0f);
+
+			BodyHandle handle = spawnBody(instance);
+			if (!handle.valid()) break;
+			asteroidHandles.push_back(handle);
+		}
+		printf("> %u dynamic bodies (draw range %u)\n", bodyRegistry.liveCount(), bodyRegistry.highWater());
+	}
+
+	// random ones, so the free list gets holes below the high-water mark
+	void removeAsteroids(uint count) {
+		for (uint i = 0; i < count && !asteroidHandles.empty(); i++) {
+			size_t k = size_t(rand()) % asteroidHandles.size();
+			destroyBody(asteroidHandles[k]);
+			asteroidHandles[k] = asteroidHandles.back();
+			asteroidHandles.pop_back();
+		}
+		printf("> %u dynamic bodies (draw range %u)\n", bodyRegistry.liveCount(), bodyRegistry.highWater());
+	}
+
+	// sphere against the six planes of the view frustum (Gribb-Hartmann, depth 0 to 1)
+	// inside : dot(plane.xyz, p) + plane.w >= 0 (left, right, top, bottom, near, far)
+	static void frustumPlanes(const glm::mat4& viewProj, glm::vec4 planes[6]) {
+		glm::vec4 row[4];
+		for (int r = 0; r < 4; r++) row[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+		planes[0] = row[3] + row[0];
+		planes[1] = row[3] - row[0];
+		planes[2] = row[3] + row[1];
+		planes[3] = row[3] - row[1];
+		planes[4] = row[2];
+		planes[5] = row[3] - row[2];
+	}
+
+	static bool isSphereVisible(const glm::mat4& viewProj, const glm::vec3& center, float radius) {
+		glm::vec4 planes[6];
+		frustumPlanes(viewProj, planes);
+
+		for (int i = 0; i < 6; i++) {
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius * glm::length(glm::vec3(planes[i]))) return false;
+		}
+		return true;
+	}
+
+	// choose mesh or impostor by the projected radius of the body
+	void updateDrawCommands(BodyDrawCommands& commands, const glm::mat4& model, float radius) {
+
+		glm::vec3 center = glm::vec3(model[3]);
+		if (!isSphereVisible(cameraInfo.projMatrix * cameraInfo.viewMatrix, center, radius)) {
+			commands.mesh = { static_cast<uint32_t>(planet_index_list.size()), 0, 0, 0, 0 };
+			commands.procedural = { activeVariant.proceduralTess * (activeVariant.proceduralTess / 2) * 6, 0, 0, 0 };
+			commands.impostor = { 6, 0, 0, 0 };
+			culledCount++;
+			return;
+		}
+
+		bool useMesh = true;
+		if (bImpostor) {
+			glm::vec4 center = cameraInfo.viewMatrix * model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			float distance = -center.z;
+			if (distance > radius) {
+				float pixels = radius * fabs(cameraInfo.projMatrix[1][1]) * 0.5f * swapChainExtent.height / distance;
+				useMesh = pixels >= IMPOSTOR_RADIUS_PIXELS;
 			}
+		}
+
+		commands.mesh = { static_cast<uint32_t>(planet_index_list.size()), useMesh ? 1u : 0u, 0, 0, 0 };
+		commands.procedural = { activeVariant.proceduralTess * (activeVariant.proceduralTess / 2) * 6, useMesh ? 1u : 0u, 0, 0 };
+		commands.impostor = { 6, useMesh ? 0u : 1u, 0, 0 };
+
+		if (!useMesh) impostorCount++;
+	}
+
+	// the shader evaluates the dynamic bodies from a float time : keep it short by advancing the phases (in double, modulo
+	// a turn in double too, so no error builds up from one origin to the next) to a new origin once the simulation time is DYNAMIC_TIME_SPAN away, every image takes all the slots again
+	void rebaseDynamicTime() {
+		double elapsed = simulationTime - dynamicTimeOrigin;
+		if (fabs(elapsed) < DYNAMIC_TIME_SPAN) return;
+
+		for (uint32_t slot = 0; slot < bodyRegistry.highWater(); slot++) {
+			DynamicBodyInstance& instance = dynamicInstances[slot];
+			instance.orbit.z = float(fmod(instance.orbit.z + instance.orbit.y * elapsed, glm::two_pi<double>()));
+			instance.body.w = float(fmod(instance.body.w + instance.body.y * elapsed, glm::two_pi<double>()));
+			changeDynamicInstance(slot);
+		}
+		dynamicTimeOrigin = simulationTime;
+	}
+
+	// jump to another simulation time : nothing is integrated, so the next frame simply evaluates there
+	void seek(double seconds) {
+		simulationTime += seconds;
+		printf("> simulation time %.1f s\n", simulationTime);
+	}
+
+	// center of a body at an absolute time, from the closed form of its orbit (and the orbit of its parent)
+	glm::vec3 bodyCenter(uint planetIndex, double time) {
+		glm::vec3 center;
+		::bodyCenter(planet_list, planetIndex, time, &center.x);
+		return center;
+	}
+
+	// the closed form of SolarSystem.h (the same transforms as trackball)
+	glm::mat4 bodyModel(uint planetIndex, double time) {
+		glm::mat4 model;
+		::bodyModel(planet_list, planetIndex, time, &model[0][0]);
+		return model;
+	}
+
+	// the body under the cursor (x, y : 0 .. 1 across the window), from the spheres of the last simulated frame
+	void pickBody(float x, float y) {
+		glm::mat4 inverseViewProj = glm::inverse(cameraInfo.projMatrix * cameraInfo.viewMatrix);
+		glm::vec4 nearPoint = inverseViewProj * glm::vec4(x * 2.0f - 1.0f, y * 2.0f - 1.0f, 0.0f, 1.0f);
+		glm::vec4 farPoint = inverseViewProj * glm::vec4(x * 2.0f - 1.0f, y * 2.0f - 1.0f, 1.0f, 1.0f);
+		glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+		glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+		float distance;
+		pickedBody = bodyBvh.raycast(origin, direction, distance);
+		if (pickedBody == BodyBvh::NO_BODY) {
+			printf("> no body picked\n");
+			return;
+		}
+
+		const glm::vec4& sphere = bodySpheres[pickedBody];
+		bodyBvh.queryRadius(glm::vec3(sphere), sphere.w * PICK_NEIGHBOR_RADII, queryResult);
+		printf("> picked body %u (radius %.2f, %.1f away, %zu other bodies within %.0f radii)\n", pickedBody, sphere.w, distance, queryResult.size() - 1, PICK_NEIGHBOR_RADII);
+	}
+
+	// evaluate the bodies at the simulation time and build their uniform data, without touching the buffers of any image
+	// only the centers of all the spheres are needed to refit the BVH and cull : the full transforms, texture requests
+	// and draws are made for the visible ones (the rings are always drawn)
+	void updateSimulation() {
+
+		advanceFrame();
+		rebaseDynamicTime();
+
+		bodyUniforms.resize(planet_list.size());
+		renderQueue.clear();
+		glm::mat4 viewProj = cameraInfo.projMatrix * cameraInfo.viewMatrix;
+
+		bodySpheres.resize(planet_list.size());
+		for (int i = 0; i < (int)planet_list.size(); i++) {
+			const Planet& planet = planet_list[i];
+			bodySpheres[i] = glm::vec4(bodyCenter(i, simulationTime), isTransparent(planet) || planet.vertex_index != 0 ? 0.0f : planet.radius);
+		}
+		bodyBvh.update(bodySpheres);
+
+		glm::vec4 planes[6];
+		frustumPlanes(viewProj, planes);
+		bodyBvh.queryFrustum(planes, queryResult);
+		bodyVisible.assign(planet_list.size(), 0);
+		for (uint32_t body : queryResult) bodyVisible[body] = 1;
+
+		for (int i = 0; i < (int)planet_list.size(); i++) {
+
+			UniformBufferObject& ubo = bodyUniforms[i];
+			ubo = {};
+
+			// a culled sphere only keeps its position and size (what the culling dispatch reads)
+			const Planet& planet = planet_list[i];
+			glm::vec3 center = glm::vec3(bodySpheres[i]);
+			bool visible = isTransparent(planet) || planet.vertex_index != 0 || bodyVisible[i];
+			ubo.model = visible ? bodyModel(i, simulationTime) : glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(planet.radius));
+
+			if (visible) requestTextureDetail(planet_list[i], ubo.model);
 
 			// camera
 			ubo.view = cameraInfo.viewMatrix;
@@ -1924,16 +3764,177 @@ private:
 			ubo.diffuse = { 1.0f, 1.0f, 1.0f, 1.0f };
 			ubo.specular = { 1.0f, 1.0f, 1.0f, 1.0f };
 			ubo.shininess = 1000.0f;
-			ubo.applyLight = i != 0;
+			ubo.applyLight = planetShading(i) == SHADING_LIT; // the shaders use the pipeline variant
+
+			if (visible) queueDraws(i, ubo.model);
+		}
+
+		// the runtime bodies are one draw, culled in the vertex shader
+		renderQueue.add(DRAW_PASS_OPAQUE, DRAW_DYNAMIC, 0, 0, 0.0f, 0);
+		renderQueue.sort();
+
+		// loads and evictions for the texture sizes this frame asked for
+		textureStreamer.update();
+
+	}
+
+
+	// the simulation time of the next frame, and the newest camera of the window thread : this frame shows its input
+	void advanceFrame() {
+		auto checkTime = std::chrono::high_resolution_clock::now();
+		double elapsedTime = std::chrono::duration<double, std::chrono::seconds::period>(checkTime - currentTime).count();
+		currentTime = checkTime;
+		simulationTime += fixedTimeStep > 0.0 ? fixedTimeStep : elapsedTime * timeScale;
+
+		CameraInput camera;
+		uint64_t version = cameraInput.read(camera);
+		bFrameHasInput = version != cameraVersion;
+		if (bFrameHasInput) {
+			cameraInfo.viewMatrix = camera.viewMatrix;
+			frameInputTime = camera.inputTime;
+			cameraVersion = version;
+			cameraInputTaken.store(version, std::memory_order_release);
+		}
+	}
+
+	// --null : the work of drawFrame() up to the submit (simulation, uniform and indirect data, command recording)
+	// for the images in turn ; nothing is acquired, uploaded, submitted or presented, so no frame is ever waited for
+	void nullFrame() {
+		uint32_t imageIndex = static_cast<uint32_t>(nullFrameCount++ % swapChainImages.size());
+
+		if (!bSimulateBeforeWait) {
+			processInput();
+			updateSimulation();
+		}
+
+		updateUniformBuffer(imageIndex);
+
+		if (recordedVersion[imageIndex] != recordVersion || !sameDraws(recordedDraws[imageIndex], renderQueue.items())) {
+			recordCommandBuffer(imageIndex);
+			nullRecordCount++;
+		}
+
+		frameCheckCount += 1;
+		auto checkTime = std::chrono::high_resolution_clock::now();
+		float elapsedTime = std::chrono::duration<float, std::chrono::seconds::period>(checkTime - frameCheckTime).count();
+		if (elapsedTime > 1) {
+			printf("Frame rate (null mode) : %.2f/s (%zu draws queued, %u command buffers recorded)\n", frameCheckCount / elapsedTime, renderQueue.items().size(), nullRecordCount);
+			nullRecordCount = 0;
+			frameCheckTime = checkTime;
+			frameCheckCount = 0;
+		}
+	}
+
+	// the draws of a visible planet
+	// (the mesh and impostor draws of a sphere are both queued, its indirect commands pick one)
+	void queueDraws(uint planetIndex, const glm::mat4& model) {
+		const Planet& planet = planet_list[planetIndex];
+		glm::vec3 center = glm::vec3(model[3]);
+		float depth = -(cameraInfo.viewMatrix * glm::vec4(center, 1.0f)).z;
+		uint32_t material = planet.texture_index << 8 | planet.alpha_index;
+		uint32_t shading = planetShading(planetIndex);
+
+		if (isTransparent(planet)) {
+			renderQueue.add(DRAW_PASS_TRANSPARENT, DRAW_TRANSPARENT, planet.vertex_index, material, depth, planetIndex);
+		}
+		else if (planet.vertex_index != 0) {
+			renderQueue.add(DRAW_PASS_OPAQUE, DRAW_MESH + shading, planet.vertex_index, material, depth, planetIndex);
+		}
+		else {
+			uint32_t pipeline = (bProceduralSphere ? DRAW_PROCEDURAL : DRAW_MESH) + shading;
+			renderQueue.add(DRAW_PASS_OPAQUE, pipeline, 0, material, depth, planetIndex);
+			renderQueue.add(DRAW_PASS_IMPOSTOR, DRAW_IMPOSTOR + shading, 0, material, depth, planetIndex);
+		}
+	}
 
+	// copy the simulated frame to the buffers of the image
+	void updateUniformBuffer(uint32_t currentImage) {
+
+		impostorCount = 0;
+		culledCount = 0;
+
+		// the last frame of this image is complete : count what its culling dispatch chose
+		if (bAsyncCompute && imageComputeSubmitted[currentImage]) {
+			for (int i = 0; i < (int)planet_list.size(); i++) {
+				if (isTransparent(planet_list[i]) || planet_list[i].vertex_index != 0) continue;
+				const BodyDrawCommands& commands = indirectBuffersMapped[currentImage][i];
+				if (commands.impostor.instanceCount != 0) impostorCount++;
+				else if (commands.mesh.instanceCount == 0) culledCount++;
+			}
+		}
+
+		for (int i = 0; i < (int)planet_list.size(); i++) {
+
+			const UniformBufferObject& ubo = bodyUniforms[i];
 
 			void* data;
 			vkMapMemory(device, uniformBuffersMemory[i][currentImage], 0, sizeof(ubo), 0, &data);
 			memcpy(data, &ubo, sizeof(ubo));
 			vkUnmapMemory(device, uniformBuffersMemory[i][currentImage]);
 
+			if (bAsyncCompute) {
+				cullingBuffersMapped[currentImage]->models[i] = ubo.model;
+			}
+			else if (!isTransparent(planet_list[i]) && planet_list[i].vertex_index == 0) {
+				updateDrawCommands(indirectBuffersMapped[currentImage][i], ubo.model, planet_list[i].radius);
+			}
+		}
+
+		if (bAsyncCompute) {
+			CullingInput* input = cullingBuffersMapped[currentImage];
+			input->view = cameraInfo.viewMatrix;
+			input->proj = cameraInfo.projMatrix;
+			input->params = glm::vec4(float(swapChainExtent.height), IMPOSTOR_RADIUS_PIXELS, bImpostor ? 1.0f : 0.0f, 0.0f);
+			input->counts[0] = static_cast<uint32_t>(planet_list.size());
+			input->counts[1] = static_cast<uint32_t>(planet_index_list.size());
+			input->counts[2] = activeVariant.proceduralTess * (activeVariant.proceduralTess / 2) * 6;
+			input->counts[3] = 0;
 		}
 
+		// dynamic bodies : camera and light like the planets, the orbits come from the time
+		UniformBufferObject dynamicUbo = {};
+		dynamicUbo.model = glm::mat4(1.0f);
+		dynamicUbo.view = cameraInfo.viewMatrix;
+		dynamicUbo.proj = cameraInfo.projMatrix;
+		dynamicUbo.light = { 0.0f, 0.0f, 0.0f, 1.0f };
+		dynamicUbo.ambient = { 0.0f, 0.0f, 0.0f, 1.0f };
+		dynamicUbo.diffuse = { 1.0f, 1.0f, 1.0f, 1.0f };
+		dynamicUbo.specular = { 1.0f, 1.0f, 1.0f, 1.0f };
+		dynamicUbo.shininess = 1000.0f;
+		dynamicUbo.applyLight = true;
+		dynamicUbo.time = float(simulationTime - dynamicTimeOrigin); // within DYNAMIC_TIME_SPAN
+
+		void* data;
+		vkMapMemory(device, dynamicUniformBuffersMemory[currentImage], 0, sizeof(dynamicUbo), 0, &data);
+		memcpy(data, &dynamicUbo, sizeof(dynamicUbo));
+		vkUnmapMemory(device, dynamicUniformBuffersMemory[currentImage]);
+
+		// the last frame of this image is complete : its instance buffer catches up with the spawned and removed bodies
+		for (uint32_t slot : dynamicInstanceChanges[currentImage]) dynamicInstancesMapped[currentImage][slot] = dynamicInstances[slot];
+		dynamicInstanceChanges[currentImage].clear();
+
+		VkDrawIndirectCommand* dynamicDraw = reinterpret_cast<VkDrawIndirectCommand*>(reinterpret_cast<char*>(indirectBuffersMapped[currentImage]) + dynamicDrawOffset());
+		*dynamicDraw = { DYNAMIC_BODY_TESS * (DYNAMIC_BODY_TESS / 2) * 6, bodyRegistry.highWater(), 0, 0 };
+	}
+
+	// timestamps of the last frame of the image, once it is complete
+	void readGpuTiming(uint32_t imageIndex, uint64_t frame) {
+		if (!gpuTimingSupported || frame == 0) return;
+
+		uint64_t timestamps[4];
+		uint32_t queryCount = imageComputeSubmitted[imageIndex] ? 4 : 2;
+		if (vkGetQueryPoolResults(device, timingQueryPools[imageIndex], 0, queryCount, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) return;
+
+		FrameGpuTiming timing;
+		timing.frame = frame;
+		timing.graphics_begin = double(timestamps[0]) * timestampPeriod;
+		timing.graphics_end = double(timestamps[1]) * timestampPeriod;
+		timing.has_compute = imageComputeSubmitted[imageIndex];
+		if (timing.has_compute) {
+			timing.compute_begin = double(timestamps[2]) * timestampPeriod;
+			timing.compute_end = double(timestamps[3]) * timestampPeriod;
+		}
+		computeOverlap.add(timing);
 	}
 
 
@@ -1944,7 +3945,7 @@ private:
 		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
 		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * 2;
+		poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * BODY_TEXTURE_COUNT;
 		poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		poolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
 
@@ -1979,18 +3980,8 @@ private:
 			bufferInfo.offset = 0;
 			bufferInfo.range = sizeof(UniformBufferObject);
 
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = textureImageView[targetPlanet.texture_index];
-			imageInfo.sampler = textureSampler;
-
-			VkDescriptorImageInfo imageInfoAlpha = {};
-			imageInfoAlpha.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfoAlpha.imageView = textureImageView[targetPlanet.alpha_index];
-			imageInfoAlpha.sampler = textureSampler;
-
 			std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
-			std::array<VkDescriptorImageInfo, 2> imageInfos = { imageInfo, imageInfoAlpha };
+			auto imageInfos = bodyImageInfos(targetPlanet.texture_index, targetPlanet.alpha_index);
 
 			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrites[0].dstSet = targetDescriptorSets[i];
@@ -2036,101 +4027,354 @@ private:
 			throw std::runtime_error("failed to allocate command buffers!");
 		}
 
+		recordedDraws.assign(commandBuffers.size(), {});
+		recordedVersion.assign(commandBuffers.size(), 0);
 		for (size_t i = 0; i < commandBuffers.size(); i++) {
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-				throw std::runtime_error("failed to begin recording command buffer!");
-			}
-
-			VkRenderPassBeginInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
-
-			std::array<VkClearValue, 2> clearValues = {};
-			clearValues[0].color = { 3 / 255.0f, 4 / 255.0f, 3 / 255.0f, 1.0f };
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
-
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+			recordCommandBuffer(i);
+		}
+	}
 
-			VkBuffer planetVertexBuffers[] = { planetVertexBuffer };
-			VkBuffer ringVertexBuffers[] = { ringVertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
+	// record the draws of a swapchain image (again when the transparent order changes)
+	void recordCommandBuffer(size_t i) {
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-			// Draw Planet
+		if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
 
-			for (int n = 0; n < (int)planet_list.size(); n++) {
+		if (gpuTimingSupported) {
+			vkCmdResetQueryPool(commandBuffers[i], timingQueryPools[i], 0, 2);
+			vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timingQueryPools[i], 0);
+		}
 
-				switch (planet_list[n].vertex_index) {
-				case 0:
-					vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, planetVertexBuffers, offsets); 
-					vkCmdBindIndexBuffer(commandBuffers[i], planetIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-					vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[n][i], 0, nullptr);
-					vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(planet_index_list.size()), 1, 0, 0, 0);
-					break;
-				case 1:
-					vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, ringVertexBuffers, offsets); 
-					vkCmdBindIndexBuffer(commandBuffers[i], ringIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-					vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[n][i], 0, nullptr);
-					vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(ring_index_list.size()), 1, 0, 0, 0);
-					break;
-				}
+		// the swapchain image comes from the acquire (waited for at color output), every frame shares the depth image
+		RenderGraph graph;
+		RenderGraph::Resource color = graph.importImage(swapChainImages[i], VK_IMAGE_ASPECT_COLOR_BIT,
+			{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED });
+		RenderGraph::Resource depth = graph.importImage(depthImage, VK_IMAGE_ASPECT_DEPTH_BIT,
+			{ VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+
+		uint32_t scene = graph.addPass("scene", [&](VkCommandBuffer commandBuffer) { recordScene(i, commandBuffer); });
+		graph.write(scene, color, { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		graph.write(scene, depth, { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL });
+
+		// transfer rather than bottom of pipe : the capture copy comes after this transition in the same submit
+		// and its barrier has to chain with it (present waits for the whole submit either way)
+		graph.exportResource(color, { PRESENT_HANDOFF_STAGE, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+		graph.compile();
+		graph.execute(commandBuffers[i]);
+
+		if (gpuTimingSupported) {
+			vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timingQueryPools[i], 1);
+		}
 
+		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
 
+		recordedDraws[i] = renderQueue.items();
+		recordedVersion[i] = recordVersion;
+	}
 
+	// the render pass of the scene, its attachments are in the layouts the graph put them in
+	void recordScene(size_t i, VkCommandBuffer commandBuffer) {
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = swapChainFramebuffers[i];
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = swapChainExtent;
+
+		std::array<VkClearValue, 2> clearValues = {};
+		clearValues[0].color = { 3 / 255.0f, 4 / 255.0f, 3 / 255.0f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = { 0.0f, 0.0f, (float)swapChainExtent.width, (float)swapChainExtent.height, 0.0f, 1.0f };
+		VkRect2D scissor = { { 0, 0 }, swapChainExtent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Draw the render queue
+		// state changes only between draws that differ : pipeline, then the mesh buffers (every body has its own descriptor set)
+
+		const PipelineSet& pipelines = activePipelines;
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		int boundMesh = -1;
+
+		VkBuffer planetVertexBuffers[] = { planetVertexBuffer };
+		VkBuffer ringVertexBuffers[] = { ringVertexBuffer };
+		VkDeviceSize offsets[] = { 0 };
+
+		for (const DrawItem& draw : renderQueue.items()) {
+			VkPipeline pipeline = drawPipeline(pipelines, draw.pipeline);
+			if (pipeline != boundPipeline) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				boundPipeline = pipeline;
+			}
 
+			// one instance per registry slot up to the high-water mark, free slots are clipped in the vertex shader
+			if (draw.pipeline == DRAW_DYNAMIC) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, dynamicPipelineLayout, 0, 1, &dynamicDescriptorSets[i], 0, nullptr);
+				vkCmdDrawIndirect(commandBuffer, indirectBuffers[i], dynamicDrawOffset(), 1, 0);
+				continue;
 			}
 
-			////
+			uint n = draw.body;
+			VkDeviceSize commandOffset = sizeof(BodyDrawCommands) * n;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[n][i], 0, nullptr);
 
-			vkCmdEndRenderPass(commandBuffers[i]);
+			bool usesMesh = draw.pipeline < DRAW_PROCEDURAL || draw.pipeline == DRAW_TRANSPARENT;
+			if (usesMesh && boundMesh != draw.mesh) {
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, draw.mesh == 0 ? planetVertexBuffers : ringVertexBuffers, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, draw.mesh == 0 ? planetIndexBuffer : ringIndexBuffer, 0, draw.mesh == 0 ? planetIndexType : ringIndexType);
+				boundMesh = draw.mesh;
+			}
+			uint32_t indexCount = static_cast<uint32_t>(draw.mesh == 0 ? planet_index_list.size() : ring_index_list.size());
 
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to record command buffer!");
+			if (draw.pipeline >= DRAW_IMPOSTOR && draw.pipeline < DRAW_TRANSPARENT) {
+				// instanceCount is 1 only for the spheres that are too small on screen this frame
+				vkCmdDrawIndirect(commandBuffer, indirectBuffers[i], commandOffset + offsetof(BodyDrawCommands, impostor), 1, 0);
+			}
+			else if (draw.pipeline >= DRAW_PROCEDURAL && draw.pipeline < DRAW_DYNAMIC) {
+				vkCmdDrawIndirect(commandBuffer, indirectBuffers[i], commandOffset + offsetof(BodyDrawCommands, procedural), 1, 0);
+			}
+			else if (draw.pipeline < DRAW_PROCEDURAL && draw.mesh == 0) {
+				// instanceCount is 0 when the body is drawn as an impostor
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffers[i], commandOffset + offsetof(BodyDrawCommands, mesh), 1, 0);
+			}
+			else {
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
 			}
 		}
+
+		////
+
+		vkCmdEndRenderPass(commandBuffer);
 	}
 
 
 	//// SyncObjects (Semaphore, Fence)
 
 	void createSyncObjects() {
-		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+		imageAvailableSemaphores.resize(framesInFlight);
+		renderFinishedSemaphores.resize(framesInFlight);
+		computeFinishedSemaphores.resize(framesInFlight);
+		imageFrameValues.assign(swapChainImages.size(), 0);
 
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo fenceInfo = {};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		// frame completion is tracked by frameScheduler, acquire and present still need binary semaphores
+		for (size_t i = 0; i < framesInFlight; i++) {
 			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
 				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &computeFinishedSemaphores[i]) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create synchronization objects for a frame!");
 			}
 		}
 	}
 
+	void cleanupSyncObjects() {
+		for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
+			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+			vkDestroySemaphore(device, computeFinishedSemaphores[i], nullptr);
+			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+		}
+	}
+
+
+
+	//// Frame Capture
+
+	// the Y4M rate : one frame per fixed time step, otherwise the refresh rate of the monitor
+	// (the main thread, before the render thread starts : GLFW)
+	void startCapture() {
+		const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		uint32_t refreshRate = mode != nullptr && mode->refreshRate > 0 ? uint32_t(mode->refreshRate) : 60;
+		if (fixedTimeStep > 0.0) captureWriter.start(captureFormat, "capture", uint32_t(1000.0 / fixedTimeStep + 0.5), 1000);
+		else captureWriter.start(captureFormat, "capture", refreshRate, 1);
+	}
+
+	// CAPTURE_RING_SIZE readback buffers of the swapchain size, host cached when there is such memory
+	void createCaptureResources() {
+		captureSlots.clear();
+		if (!captureSupported) return;
+
+		VkDeviceSize size = VkDeviceSize(swapChainExtent.width) * swapChainExtent.height * 4;
+		captureSlots.resize(CAPTURE_RING_SIZE);
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		for (auto& slot : captureSlots) {
+			slot.coherent = !hasMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+			VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | (slot.coherent ? VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+			createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer, slot.memory);
+
+			void* data;
+			vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, &data);
+			slot.mapped = static_cast<uint8_t*>(data);
+			slot.size = size;
+			slot.state = CAPTURE_FREE;
+			slot.frameValue = 0;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate capture command buffer!");
+			}
+		}
+	}
+
+	// the device must be idle
+	void destroyCaptureResources() {
+		collectCaptures();
+		captureWriter.flush();
+		uint32_t slotIndex;
+		while (captureWriter.released(slotIndex)) {}
+
+		for (auto& slot : captureSlots) {
+			vkFreeCommandBuffers(device, commandPool, 1, &slot.commandBuffer);
+			vkUnmapMemory(device, slot.memory);
+			vkDestroyBuffer(device, slot.buffer, nullptr);
+			vkFreeMemory(device, slot.memory, nullptr);
+		}
+		captureSlots.clear();
+	}
+
+	bool hasMemoryType(VkMemoryPropertyFlags properties, uint32_t typeFilter = ~0u) {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return true;
+		}
+		return false;
+	}
+
+	// copy the rendered image to a free slot, in the same submit as the frame (before present)
+	// nothing waits for the copy : collectCaptures() hands the slot to the capture thread once the frame is complete
+	void captureFrame(uint32_t imageIndex, std::vector<VkCommandBuffer>& submitCommandBuffers) {
+		CaptureSlot* slot = nullptr;
+		for (auto& candidate : captureSlots) {
+			if (candidate.state == CAPTURE_FREE) {
+				slot = &candidate;
+				break;
+			}
+		}
+		if (slot == nullptr) {
+			droppedCaptures++;
+			capturedFrames++;
+			return;
+		}
+
+		VkCommandBuffer commandBuffer = slot->commandBuffer;
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		// the frame command buffer left the image ready to present (its last barrier ends at the hand-off stage, the color
+		// writes already made available by it), the host is done with the free slot
+		RenderGraph graph;
+		RenderGraph::Resource image = graph.importImage(swapChainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+			{ PRESENT_HANDOFF_STAGE, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+		RenderGraph::Resource readback = graph.importBuffer(slot->buffer, { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED });
+
+		uint32_t copy = graph.addPass("capture", [&](VkCommandBuffer target) {
+			VkBufferImageCopy region = {};
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+			vkCmdCopyImageToBuffer(target, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+		});
+		graph.read(copy, image, { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL });
+		graph.write(copy, readback, { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+
+		// back to present, and the copy visible to the host (one barrier)
+		graph.exportResource(image, { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+		graph.exportResource(readback, { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+		graph.compile();
+		graph.execute(commandBuffer);
+
+		vkEndCommandBuffer(commandBuffer);
+		submitCommandBuffers.push_back(commandBuffer);
+
+		slot->state = CAPTURE_GPU;
+		slot->frameValue = frameScheduler.nextValue();
+		slot->frame = ++capturedFrames;
+	}
+
+	// completed copies go to the capture thread in frame order, written slots come back
+	void collectCaptures() {
+		uint32_t slotIndex;
+		while (captureWriter.released(slotIndex)) {
+			if (slotIndex < captureSlots.size()) captureSlots[slotIndex].state = CAPTURE_FREE;
+		}
+
+		uint64_t completed = frameScheduler.completedValue();
+		bool bgra = swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+		captureReady.clear();
+		for (uint32_t i = 0; i < captureSlots.size(); i++) {
+			if (captureSlots[i].state == CAPTURE_GPU && captureSlots[i].frameValue <= completed) captureReady.push_back(i);
+		}
+		std::sort(captureReady.begin(), captureReady.end(), [&](uint32_t a, uint32_t b) { return captureSlots[a].frame < captureSlots[b].frame; });
+
+		for (uint32_t i : captureReady) {
+			CaptureSlot& slot = captureSlots[i];
+
+			if (!slot.coherent) {
+				VkMappedMemoryRange range = {};
+				range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+				range.memory = slot.memory;
+				range.offset = 0;
+				range.size = VK_WHOLE_SIZE;
+				vkInvalidateMappedMemoryRanges(device, 1, &range);
+			}
+
+			slot.state = CAPTURE_WRITING;
+			captureWriter.write(i, slot.mapped, swapChainExtent.width, swapChainExtent.height, swapChainExtent.width * 4, bgra, slot.frame);
+		}
+	}
 
 
 	//// Drawing
 
 	void drawFrame() {
-		vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+
+		// present mode, swapchain images or frames in flight changed
+		if (framePacingChanged) {
+			framePacingChanged = false;
+			vkDeviceWaitIdle(device);
+			cleanupSyncObjects();
+			recreateSwapChain();
+			frameScheduler.setSlotCount(framesInFlight);
+			createSyncObjects();
+		}
+
+		updatePipelineVariant();
+
+		// throughput : the CPU works on this frame while the GPU still renders the previous ones
+		if (bSimulateBeforeWait) updateSimulation();
+
+		if (bNullBackend) {
+			nullFrame();
+			return;
+		}
+
+		// wait for the frame that used this slot, and release what it was holding
+		currentFrame = frameScheduler.slot();
+		frameScheduler.beginFrame();
+		collectCaptures();
 
 
 		// Get Next Image
@@ -2145,35 +4389,71 @@ private:
 			throw std::runtime_error("failed to acquire swap chain image!");
 		}
 
+		// the image may still be used by the other frame in flight
+		frameScheduler.wait(imageFrameValues[imageIndex]);
+		readGpuTiming(imageIndex, imageFrameValues[imageIndex]);
+		imageFrameValues[imageIndex] = frameScheduler.nextValue();
+
+		// latency : take the newest input right before the simulation
+		if (!bSimulateBeforeWait) {
+			processInput();
+			updateSimulation();
+		}
+
 		updateUniformBuffer(imageIndex);
 
-		if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		bool texturesChanged = streamTextures(imageIndex);
+
+		if (texturesChanged || recordedVersion[imageIndex] != recordVersion || !sameDraws(recordedDraws[imageIndex], renderQueue.items())) {
+			recordCommandBuffer(imageIndex);
 		}
-		imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
 		// Submit Info
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
+		std::vector<VkSemaphore> waitSemaphores = { imageAvailableSemaphores[currentFrame] };
+		std::vector<uint64_t> waitValues = { 0 };
+		std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		std::vector<VkCommandBuffer> submitCommandBuffers;
+
+		// buffers and textures uploaded since the last frame
+		acquireUploads(waitSemaphores, waitValues, waitStages, submitCommandBuffers);
+
+		// culling runs on the compute queue beside the graphics work of the previous frame,
+		// only the indirect draws of this frame wait for it
+		imageComputeSubmitted[imageIndex] = bAsyncCompute;
+		if (bAsyncCompute) {
+			VkSubmitInfo computeSubmitInfo = {};
+			computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			computeSubmitInfo.commandBufferCount = 1;
+			computeSubmitInfo.pCommandBuffers = &computeCommandBuffers[imageIndex];
+			computeSubmitInfo.signalSemaphoreCount = 1;
+			computeSubmitInfo.pSignalSemaphores = &computeFinishedSemaphores[currentFrame];
+
+			if (vkQueueSubmit(computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit compute command buffer!");
+			}
 
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+			waitSemaphores.push_back(computeFinishedSemaphores[currentFrame]);
+			waitValues.push_back(0);
+			waitStages.push_back(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+		}
+		submitCommandBuffers.push_back(commandBuffers[imageIndex]);
+		if (bCapture) captureFrame(imageIndex, submitCommandBuffers);
+
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+
+		submitInfo.commandBufferCount = static_cast<uint32_t>(submitCommandBuffers.size());
+		submitInfo.pCommandBuffers = submitCommandBuffers.data();
 
 		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		vkResetFences(device, 1, &inFlightFences[currentFrame]);
-
-		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to submit draw command buffer!");
-		}
+		frameScheduler.submit(graphicsQueue, submitInfo, waitValues.data());
 
 		// Present Info
 		VkPresentInfoKHR presentInfo = {};
@@ -2191,24 +4471,50 @@ private:
 		// Present
 		result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized || wireframeModeChanged) {
+		// the present call has returned : the image is queued, not on screen
+		if (bFrameHasInput) {
+			float latency = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - frameInputTime).count();
+			latencyInfo.count++;
+			latencyInfo.sum_ms += latency;
+			latencyInfo.max_ms = max(latencyInfo.max_ms, latency);
+		}
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
 			framebufferResized = false;
-			wireframeModeChanged = false;
 			recreateSwapChain();
 		}
 		else if (result != VK_SUCCESS) {
 			throw std::runtime_error("failed to present swap chain image!");
 		}
 
-		// Frame Update
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-
 		// Frame display
 		frameCheckCount += 1;
 		auto checkTime = std::chrono::high_resolution_clock::now();
 		float elapsedTime = std::chrono::duration<float, std::chrono::seconds::period>(checkTime - frameCheckTime).count();
 		if (elapsedTime > 1) {
-			printf("Frame rate : %.2f/s\n", frameCheckCount / elapsedTime);
+			printf("Frame rate : %.2f/s (impostors : %u, culled : %u, dynamic bodies : %u)\n", frameCheckCount / elapsedTime, impostorCount, culledCount, bodyRegistry.liveCount());
+			if (bLatencyReport && latencyInfo.count > 0) {
+				printf("  input to present call : avg %.2f ms, max %.2f ms (%zu frames)\n", latencyInfo.sum_ms / latencyInfo.count, latencyInfo.max_ms, latencyInfo.count);
+			}
+			if (bGpuTimingReport && computeOverlap.count > 0) {
+				double compute_ms = computeOverlap.compute_ns / computeOverlap.count * 1e-6;
+				double graphics_ms = computeOverlap.graphics_ns / computeOverlap.count * 1e-6;
+				if (computeOverlap.correlated) {
+					double hidden = computeOverlap.compute_ns > 0.0 ? computeOverlap.overlapped_ns / computeOverlap.compute_ns : 0.0;
+					printf("  async compute : avg %.3f ms, %.0f%% overlapped with graphics, %.3f ms added (%zu frames)\n", compute_ms, hidden * 100.0, compute_ms * (1.0 - hidden), computeOverlap.count);
+				}
+				else {
+					printf("  async compute : avg %.3f ms, graphics : avg %.3f ms (%zu frames)\n", compute_ms, graphics_ms, computeOverlap.count);
+				}
+			}
+			if (bCapture || droppedCaptures > 0) {
+				printf("  capture : %zu frames written, %zu dropped%s\n", captureWriter.written(), droppedCaptures, captureSupported ? "" : " (swapchain images cannot be copied)");
+			}
+			droppedCaptures = 0;
+			computeOverlap.reset();
+			latencyInfo.count = 0;
+			latencyInfo.sum_ms = 0.0f;
+			latencyInfo.max_ms = 0.0f;
 			frameCheckTime = checkTime;
 			frameCheckCount = 0;
 		}
@@ -2225,11 +4531,71 @@ private:
 
 
 
-int main() {
+// frame pacing options
+// --present immediate|mailbox|fifo|fifo_relaxed, --frames N, --images N, --simulate-early, --latency
+// --cpu-culling, --gpu-timing, --texture-budget MB, --build-mips, --capture png|y4m
+// --time SECONDS, --time-scale S, --time-step SECONDS, --null
+void parseArguments(int argc, char* argv[]) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		std::string value = i + 1 < argc ? argv[i + 1] : "";
+
+		if (arg == "--present") {
+			if (value == "immediate")			presentModePreference = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else if (value == "mailbox")		presentModePreference = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (value == "fifo")			presentModePreference = VK_PRESENT_MODE_FIFO_KHR;
+			else if (value == "fifo_relaxed")	presentModePreference = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			else throw std::runtime_error("unknown present mode : " + value);
+			i++;
+		}
+		else if (arg == "--frames") {
+			framesInFlight = clamp(uint(atoi(value.c_str())), 1u, uint(MAX_FRAMES_IN_FLIGHT));
+			i++;
+		}
+		else if (arg == "--images") {
+			swapChainImageRequest = uint(atoi(value.c_str()));
+			i++;
+		}
+		else if (arg == "--simulate-early")	bSimulateBeforeWait = true;
+		else if (arg == "--latency")			bLatencyReport = true;
+		else if (arg == "--cpu-culling")		bAsyncCompute = false;
+		else if (arg == "--gpu-timing")			bGpuTimingReport = true;
+		else if (arg == "--texture-budget") {
+			textureBudgetMB = size_t(atoi(value.c_str()));
+			i++;
+		}
+		else if (arg == "--build-mips")		bBuildMips = true;
+		else if (arg == "--capture") {
+			if (value == "png")					captureFormat = CaptureWriter::FORMAT_PNG;
+			else if (value == "y4m")			captureFormat = CaptureWriter::FORMAT_Y4M;
+			else throw std::runtime_error("unknown capture format : " + value);
+			bCapture = true;
+			i++;
+		}
+		else if (arg == "--time") {
+			startTime = atof(value.c_str());
+			i++;
+		}
+		else if (arg == "--time-scale") {
+			timeScale = atof(value.c_str());
+			i++;
+		}
+		else if (arg == "--time-step") {
+			fixedTimeStep = atof(value.c_str());
+			i++;
+		}
+		else if (arg == "--null")				bNullBackend = true;
+		else throw std::runtime_error("unknown option : " + arg);
+	}
+}
+
+int main(int argc, char* argv[]) {
 	HelloTriangleApplication app;
 
 	try {
-		app.run();
+		parseArguments(argc, argv);
+		if (bBuildMips) HelloTriangleApplication::buildMipFiles();
+		else app.run();
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
@@ -1,3 +1,10 @@
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader.vert -o vert.spv
 C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader_packed.vert -o vert_packed.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader_position.vert -o vert_position.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader_procedural.vert -o vert_procedural.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader_impostor.vert -o vert_impostor.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader_impostor.frag -o frag_impostor.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader_cull.comp -o comp_cull.spv
+C:/VulkanSDK/1.1.130.0/Bin32/glslc.exe shader_dynamic.vert -o vert_dynamic.spv
 pause
\ No newline at end of file
@@ -0,0 +1,18 @@
+// Blinn-Phong of shader.frag and shader_impostor.frag (#include, GL_GOOGLE_include_directive)
+// the including shader declares ubo first
+
+// the texture color lit at the eye-coordinate position p, with the normalized eye-coordinate normal n
+vec4 blinnPhong(vec4 light_texture, vec3 p, vec3 n) {
+
+	vec4 lpos = ubo.view * ubo.light;                             // light position in the eye-space coordinate
+
+	vec3 l = normalize(lpos.xyz - (lpos.a == 0.0 ? vec3(0) : p)); // lpos.a==0 means directional light
+	vec3 v = normalize(-p);                                       // eye-epos = vec3(0)-epos
+	vec3 h = normalize(l + v);                                    // the halfway vector
+
+	vec4 Ira = light_texture * ubo.ambient;                                         // ambient reflection
+	vec4 Ird = max(light_texture * dot(l, n) * ubo.diffuse, 0.0);                   // diffuse reflection
+	vec4 Irs = max(light_texture * pow(dot(h, n), ubo.shininess) * ubo.specular, 0.0);  // specular reflection
+
+	return Ira + Ird + Irs;
+}
@@ -1,7 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
-layout(binding = 1) uniform sampler2D texSampler[2]; // 0: Color, 1: Alpha
+layout(binding = 1) uniform sampler2D texSampler[4]; // 0: Color, 1: Alpha, 2: Normal, 3: Bump (flat ones when the body has none)
 
 layout(binding = 2) uniform UniformBufferObject {
     mat4 model;
@@ -25,25 +26,41 @@ layout(location = 2) in vec2 tc;   // used for texture coordinate visualization
 
 layout(location = 0) out vec4 outColor;
 
+// pipeline variants (VkSpecializationInfo) : the branch and the alpha fetch are compiled out
+layout(constant_id = 0) const bool APPLY_LIGHT = true; // false for the Sun only
+layout(constant_id = 1) const bool ALPHA_MAP = false;  // alpha-mapped bodies (rings)
+
+#include "lighting.glsl"
+
+const float PARALLAX_SCALE = 0.004; // texture coordinate shift of the whole bump range, looking along the surface
+
+// tangent frame from the screen-space derivatives of the position and the texture coordinates (the vertices carry no tangent)
+mat3 cotangentFrame(vec3 n, vec3 p, vec2 uv) {
+	vec3 dp1 = dFdx(p), dp2 = dFdy(p);
+	vec2 duv1 = dFdx(uv), duv2 = dFdy(uv);
+	vec3 dp2perp = cross(dp2, n), dp1perp = cross(n, dp1);
+	vec3 t = dp2perp * duv1.x + dp1perp * duv2.x;
+	vec3 b = dp2perp * duv1.y + dp1perp * duv2.y;
+	float scale = inversesqrt(max(dot(t, t), dot(b, b)));
+	return mat3(t * scale, b * scale, n);
+}
+
 void main() {
 
-	if(ubo.applyLight) {
+	if(APPLY_LIGHT) {
 	
 		//   ؽ 
-		vec4 lpos = ubo.view * ubo.light;                             // light position in the eye-space coordinate
-
 		vec3 n = normalize(norm);                                     // norm interpolated via rasterizer should be normalized again here
-		vec3 p = epos.xyz;                                            // 3D position of this fragment
-		vec3 l = normalize(lpos.xyz - (lpos.a == 0.0 ? vec3(0) : p)); // lpos.a==0 means directional light
-		vec3 v = normalize(-p);                                       // eye-epos = vec3(0)-epos
-		vec3 h = normalize(l + v);                                    // the halfway vector
+		mat3 tbn = cotangentFrame(n, epos.xyz, tc);
 
-		vec4 light_texture = texture(texSampler[0], tc);
-		vec4 Ira = light_texture * ubo.ambient;                                         // ambient reflection
-		vec4 Ird = max(light_texture * dot(l, n) * ubo.diffuse, 0.0);                   // diffuse reflection
-		vec4 Irs = max(light_texture * pow(dot(h, n), ubo.shininess) * ubo.specular, 0.0);  // specular reflection
+		// parallax : the bump map moves the texture coordinates along the view direction in the tangent plane
+		vec3 v = normalize(-epos.xyz) * tbn;
+		vec2 uv = tc + v.xy * (texture(texSampler[3], tc).r - 0.5) * PARALLAX_SCALE;
 
-		outColor = Ira + Ird + Irs;
+		// the normal map is stored top row first like the other images : its green axis points to -v
+		vec3 m = texture(texSampler[2], uv).xyz * 2.0 - 1.0;
+		n = normalize(tbn * vec3(m.x, -m.y, m.z));
+		outColor = blinnPhong(texture(texSampler[0], uv), epos.xyz, n);
 
 	} else {
 
@@ -63,7 +80,11 @@ void main() {
     // outColor = vec4(fragColor * texture(texSampler[0], norm).rgb, 1.0);
 
 	//  ؽ
-	vec4 alpha_texture = texture(texSampler[1], tc);
-	outColor.a = alpha_texture.r;
+	if(ALPHA_MAP) {
+		vec4 alpha_texture = texture(texSampler[1], tc);
+		outColor.a = alpha_texture.r;
+	} else {
+		outColor.a = 1.0;
+	}
 
 }
\ No newline at end of file
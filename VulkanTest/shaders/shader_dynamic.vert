@@ -0,0 +1,76 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// runtime bodies : one instance per registry slot, buffer-less sphere like shader_procedural.vert
+// the orbit is evaluated here from ubo.time, so a body costs nothing on the CPU after its slot is written
+// ubo.time : seconds since the time of the phases, kept short by the CPU (the angles stay precise in float)
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	vec4 light;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+	bool applyLight;
+	float time;
+} ubo;
+
+// same layout as DynamicBodyInstance
+struct DynamicBody {
+	vec4 orbit;  // distance, revolution speed (rad/s), phase, inclination
+	vec4 body;   // radius, rotation speed (rad/s), alive, rotation phase
+};
+
+layout(std430, binding = 3) readonly buffer DynamicBodies {
+	DynamicBody bodies[];
+};
+
+// tessellation factor of the sphere, same parameterization as createVerticesAndIndices()
+layout(constant_id = 0) const uint NUM_TESS = 72;
+
+layout(location = 0) out vec4 epos;	  // eye-coordinate position
+layout(location = 1) out vec3 norm;   // per-vertex normal before interpolation
+layout(location = 2) out vec2 tc;     // used for texture coordinate visualization
+
+const float PI = 3.1415926535897932384626433832795;
+
+// corners of the two triangles of a quad : (longitude, latitude) offsets
+const uvec2 corner[6] = uvec2[6](uvec2(0, 0), uvec2(0, 1), uvec2(1, 1), uvec2(1, 1), uvec2(1, 0), uvec2(0, 0));
+
+void main() {
+
+	DynamicBody b = bodies[gl_InstanceIndex];
+
+	// free slot below the high-water mark : outside of the clip volume
+	if (b.body.z == 0.0) {
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		epos = vec4(0.0);
+		norm = vec3(0.0, 0.0, 1.0);
+		tc = vec2(0.0);
+		return;
+	}
+
+	uint quad = uint(gl_VertexIndex) / 6;
+	uvec2 ik = uvec2(quad / (NUM_TESS / 2), quad % (NUM_TESS / 2)) + corner[uint(gl_VertexIndex) % 6];
+
+	float t = PI * 2.0 / float(NUM_TESS) * float(ik.x);
+	float p = PI * 2.0 / float(NUM_TESS) * float(ik.y);
+	vec3 position = vec3(sin(p) * cos(t), sin(p) * sin(t), cos(p));
+
+	// revolution on the inclined orbit plane, rotation around z
+	float angle = b.orbit.y * ubo.time + b.orbit.z;
+	vec3 center = b.orbit.x * vec3(cos(angle), sin(angle) * cos(b.orbit.w), sin(angle) * sin(b.orbit.w));
+
+	float spin = b.body.y * ubo.time + b.body.w;
+	mat3 rotation = mat3(cos(spin), sin(spin), 0.0, -sin(spin), cos(spin), 0.0, 0.0, 0.0, 1.0);
+	vec3 normal = rotation * position;
+
+	epos = ubo.view * vec4(center + normal * b.body.x, 1.0);
+	gl_Position = ubo.proj * epos;
+
+	norm = normalize(mat3(ubo.view) * normal);
+	tc = vec2(t / 2.0 / PI, p / PI);
+}
@@ -0,0 +1,64 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+layout(binding = 1) uniform sampler2D texSampler[2]; // 0: Color, 1: Alpha
+
+layout(binding = 2) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	vec4 light;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+	bool applyLight;
+} ubo;
+
+layout(location = 0) in vec3 qpos;          // eye-coordinate position on the quad
+layout(location = 1) flat in vec4 sphere;   // eye-coordinate center and radius of the sphere
+
+layout(location = 0) out vec4 outColor;
+
+const float PI = 3.1415926535897932384626433832795;
+
+// same constant as shader.frag, impostors are only drawn for opaque bodies (no alpha map)
+layout(constant_id = 0) const bool APPLY_LIGHT = true;
+
+#include "lighting.glsl"
+
+void main() {
+
+	// ray from the eye through this fragment
+	vec3 dir = normalize(qpos);
+	vec3 c = sphere.xyz;
+	float b = dot(dir, c);
+	float disc = b * b - (dot(c, c) - sphere.w * sphere.w);
+	if (disc < 0.0) discard;
+
+	vec3 p = dir * (b - sqrt(disc));   // nearest hit, 3D position of this fragment
+	vec3 n = (p - c) / sphere.w;        // eye-coordinate normal
+
+	// correct depth so the impostor intersects the other geometry like the mesh would
+	vec4 clip = ubo.proj * vec4(p, 1.0);
+	gl_FragDepth = clip.z / clip.w;
+
+	// texture coordinate of the sphere mesh, from the object-space direction
+	// (model-view is rotation and uniform scale, so its transpose rotates back)
+	vec3 o = normalize(transpose(mat3(ubo.view * ubo.model)) * n);
+	float t = atan(o.y, o.x);
+	vec2 tc = vec2((t < 0.0 ? t + 2.0 * PI : t) / (2.0 * PI), acos(clamp(o.z, -1.0, 1.0)) / PI);
+
+	if(APPLY_LIGHT) {
+
+		outColor = blinnPhong(texture(texSampler[0], tc), p, n);
+
+	} else {
+
+		outColor = texture(texSampler[0], tc);
+
+	}
+
+	outColor.a = 1.0;
+}
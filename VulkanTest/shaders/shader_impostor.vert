@@ -0,0 +1,42 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	vec4 light;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+	bool applyLight;
+} ubo;
+
+// camera-facing quad of the sphere impostor, no vertex buffer
+layout(location = 0) out vec3 qpos;                 // eye-coordinate position on the quad
+layout(location = 1) flat out vec4 sphere;          // eye-coordinate center and radius of the sphere
+
+const vec2 corner[6] = vec2[6](vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(1, 1), vec2(-1, 1), vec2(-1, -1));
+
+void main() {
+
+	mat4 modelView = ubo.view * ubo.model;
+	vec3 center = (modelView * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+	float radius = length(modelView[0].xyz); // unit sphere scaled by the model matrix
+
+	// quad perpendicular to the view ray through the center,
+	// enlarged so that it covers the silhouette cone of the sphere
+	float d = length(center);
+	vec3 dir = center / d;
+	vec3 hint = abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	vec3 right = normalize(cross(dir, hint));
+	vec3 up = cross(right, dir);
+	float size = radius * d / sqrt(max(d * d - radius * radius, 1e-6));
+
+	vec2 c = corner[gl_VertexIndex];
+	qpos = center + (right * c.x + up * c.y) * size;
+	sphere = vec4(center, radius);
+
+	gl_Position = ubo.proj * vec4(qpos, 1.0);
+}
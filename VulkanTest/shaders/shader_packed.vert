@@ -0,0 +1,40 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	vec4 light;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+	bool applyLight;
+} ubo;
+
+// PackedVertex : snorm16 position, octahedral normal, unorm16 texcoord (normalized by the vertex fetch)
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNorm;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 epos;	  // eye-coordinate position
+layout(location = 1) out vec3 norm;   // per-vertex normal before interpolation
+layout(location = 2) out vec2 tc;     // used for texture coordinate visualization
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main() {
+
+	epos = ubo.view * ubo.model * vec4(inPosition.xyz, 1.0);
+	gl_Position = ubo.proj * epos;
+
+	// pass eye-coordinate normal to fragment shader
+	norm = normalize(mat3(ubo.view * ubo.model) * octDecode(inNorm));
+	tc = inTexCoord;
+}
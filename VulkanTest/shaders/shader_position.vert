@@ -0,0 +1,35 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	vec4 light;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+	bool applyLight;
+} ubo;
+
+// PositionVertex : snorm16 position, texcoord.x in w
+layout(location = 0) in vec4 inPosition;
+
+layout(location = 0) out vec4 epos;	  // eye-coordinate position
+layout(location = 1) out vec3 norm;   // per-vertex normal before interpolation
+layout(location = 2) out vec2 tc;     // used for texture coordinate visualization
+
+const float PI = 3.1415926535897932384626433832795;
+
+void main() {
+
+	epos = ubo.view * ubo.model * vec4(inPosition.xyz, 1.0);
+	gl_Position = ubo.proj * epos;
+
+	// unit sphere (and flat ring) : normal is the position itself
+	norm = normalize(mat3(ubo.view * ubo.model) * inPosition.xyz);
+
+	// latitude from z, longitude is stored to keep the texture seam
+	tc = vec2(inPosition.w, acos(clamp(inPosition.z, -1.0, 1.0)) / PI);
+}
@@ -0,0 +1,45 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	vec4 light;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float shininess;
+	bool applyLight;
+} ubo;
+
+// tessellation factor of the sphere, same parameterization as createVerticesAndIndices()
+layout(constant_id = 0) const uint NUM_TESS = 72;
+
+layout(location = 0) out vec4 epos;	  // eye-coordinate position
+layout(location = 1) out vec3 norm;   // per-vertex normal before interpolation
+layout(location = 2) out vec2 tc;     // used for texture coordinate visualization
+
+const float PI = 3.1415926535897932384626433832795;
+
+// corners of the two triangles of a quad : (longitude, latitude) offsets
+const uvec2 corner[6] = uvec2[6](uvec2(0, 0), uvec2(0, 1), uvec2(1, 1), uvec2(1, 1), uvec2(1, 0), uvec2(0, 0));
+
+void main() {
+
+	// no vertex buffer : quad and corner come from the vertex index
+	uint quad = uint(gl_VertexIndex) / 6;
+	uvec2 ik = uvec2(quad / (NUM_TESS / 2), quad % (NUM_TESS / 2)) + corner[uint(gl_VertexIndex) % 6];
+
+	// t : theta - angle of longitude, p : pi - angle of latitude
+	float t = PI * 2.0 / float(NUM_TESS) * float(ik.x);
+	float p = PI * 2.0 / float(NUM_TESS) * float(ik.y);
+	vec3 position = vec3(sin(p) * cos(t), sin(p) * sin(t), cos(p));
+
+	epos = ubo.view * ubo.model * vec4(position, 1.0);
+	gl_Position = ubo.proj * epos;
+
+	// pass eye-coordinate normal to fragment shader
+	norm = normalize(mat3(ubo.view * ubo.model) * position);
+	tc = vec2(t / 2.0 / PI, p / PI);
+}
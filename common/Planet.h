@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// parent_index of a body that orbits the Sun
+static const uint32_t NO_PARENT = UINT32_MAX;
+
+// one body of the solar system, shared by the Vulkan and the OpenGL renderer
+// (no math library here : VulkanTest uses glm, trackball uses cgmath)
+class Planet {
+
+public:
+
+	uint32_t parent_index; // parent planet index (NO_PARENT : none)
+	uint32_t vertex_index; // mesh of the planet (MESH_SPHERE, MESH_RING)
+	uint32_t texture_index; // planet texture index
+	uint32_t alpha_index; // planet alpha index (WHITE_TEXTURE_INDEX : opaque)
+
+	float distance; // distance from Sun
+	float radius;   // size proportional to Earth
+	float rotation_cycle; // rotation cycle of planet
+	float revolution_cycle; // revolution cycle of planet
+
+	Planet() {}
+
+	Planet(uint32_t parent_index, uint32_t vertex_index, uint32_t texture_index, uint32_t alpha_index, float distance, float radius, float rotation_cycle, float revolution_cycle) {
+
+		this->parent_index = parent_index;
+		this->vertex_index = vertex_index;
+		this->texture_index = texture_index;
+		this->alpha_index = alpha_index;
+		this->distance = distance;
+		this->radius = radius;
+		this->rotation_cycle = rotation_cycle;
+		this->revolution_cycle = revolution_cycle;
+	}
+
+	// rotation and revolution angles at an absolute simulation time (seconds, angle 0 at time 0)
+	// nothing is accumulated, so any time can be evaluated directly and long runs do not drift
+	float rotation_theta(double time) const { return cycle_angle(time, rotation_cycle); }
+	float revolution_theta(double time) const { return cycle_angle(time, revolution_cycle); }
+
+	// the whole turns are dropped in double precision, only the fraction is converted
+	static float cycle_angle(double time, float cycle) {
+
+		// prevent divided by 0
+		if (cycle <= 0) return 0.0f;
+
+		double turns = time / cycle;
+		return float((turns - floor(turns)) * 2 * 3.141592653589793);
+	}
+
+
+};
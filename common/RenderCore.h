@@ -0,0 +1,188 @@
+#pragma once
+
+// the CPU side of a frame, the same for every graphics API : simulation, culling, sorting and the draw list
+// a RenderBackend only turns the finished FramePacket into API calls (or, in a null mode, into the same commands
+// without submitting them, to measure what the frame costs before any driver work)
+// the ordering step is a hook : DepthSorter uses the radix sort of VulkanTest's render queue
+
+#include "RenderQueue.h"
+#include "SolarSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// one instanced draw : every visible body of a mesh, texture, alpha map and shading
+struct DrawBatch {
+	uint32_t mesh;          // SolarMesh
+	uint32_t texture;
+	uint32_t alpha_texture; // WHITE_TEXTURE_INDEX : opaque
+	bool lit;
+	uint32_t first_instance; // into FramePacket::models
+	uint32_t instance_count; // 0 when every body of the batch is culled
+};
+
+struct FramePacket {
+	double time;
+	std::vector<float> models;      // 16 floats per instance (column-major model matrix, radius included), in batch order
+	std::vector<DrawBatch> batches; // the same batches in the same order every frame : opaque ones first
+	uint32_t visible_count;
+};
+
+class RenderBackend {
+
+public:
+
+	virtual ~RenderBackend() {}
+	virtual void submit(const FramePacket& frame) = 0;
+};
+
+// the order of the visible bodies, kept within each batch by the counting sort (body order without one)
+class FrameSorter {
+
+public:
+
+	virtual ~FrameSorter() {}
+	virtual void sort(const std::vector<Planet>& planets, const std::vector<float>& spheres, const float view_projection[16], std::vector<uint32_t>& visible) = 0;
+};
+
+// the keys of VulkanTest's render queue : opaque bodies front to back, transparent ones back to front
+class DepthSorter : public FrameSorter {
+
+public:
+
+	void sort(const std::vector<Planet>& planets, const std::vector<float>& spheres, const float view_projection[16], std::vector<uint32_t>& visible) override {
+		queue.clear();
+		for (uint32_t i : visible) {
+			const Planet& planet = planets[i];
+			const float* sphere = &spheres[i * 4];
+			float depth = view_projection[3] * sphere[0] + view_projection[7] * sphere[1] + view_projection[11] * sphere[2] + view_projection[15]; // clip w
+			uint32_t material = planet.texture_index << 8 | planet.alpha_index;
+			queue.add(isTransparent(planet) ? DRAW_PASS_TRANSPARENT : DRAW_PASS_OPAQUE, 0, planet.vertex_index, material, depth, i);
+		}
+		queue.sort();
+
+		visible.clear();
+		for (const DrawItem& draw : queue.items()) visible.push_back(draw.body);
+	}
+
+private:
+
+	RenderQueue queue;
+};
+
+class RenderCore {
+
+public:
+
+	// the batches are fixed here : the bodies are sorted once by (transparent, mesh, shading, texture, alpha map)
+	// and every frame only counts and places its visible bodies into them
+	void setScene(const std::vector<Planet>& planets) {
+		this->planets = planets;
+
+		std::vector<uint32_t> order(planets.size());
+		for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return batchKey(a) < batchKey(b); });
+
+		packet.batches.clear();
+		body_batch.assign(planets.size(), 0);
+		uint64_t key = UINT64_MAX;
+		for (uint32_t i : order) {
+			const Planet& planet = planets[i];
+			if (batchKey(i) != key) {
+				key = batchKey(i);
+				packet.batches.push_back({ planet.vertex_index, planet.texture_index, planet.alpha_index, isLit(i), 0, 0 });
+			}
+			body_batch[i] = static_cast<uint32_t>(packet.batches.size() - 1);
+		}
+		packet.models.resize(planets.size() * 16);
+		placed.resize(packet.batches.size());
+		centers.resize(planets.size() * 4);
+	}
+
+	// nullptr : body order
+	void setSorter(FrameSorter* sorter) {
+		this->sorter = sorter;
+	}
+
+	const std::vector<Planet>& scene() const { return planets; }
+	const std::vector<DrawBatch>& batches() const { return packet.batches; }
+
+	// view_projection : column-major, clip space -w <= x, y, z <= w (a Vulkan projection only culls less near the camera)
+	const FramePacket& buildFrame(double time, const float view_projection[16]) {
+		packet.time = time;
+
+		// simulation : the bounding sphere of every body (the model matrix is only built for the visible ones)
+		for (uint32_t i = 0; i < planets.size(); i++) {
+			bodyCenter(planets, i, time, &centers[i * 4]);
+			centers[i * 4 + 3] = planets[i].radius;
+		}
+
+		// culling : against the six planes of the view frustum
+		float planes[6][4];
+		frustumPlanes(view_projection, planes);
+		visible.clear();
+		for (uint32_t i = 0; i < planets.size(); i++) {
+			const float* sphere = &centers[i * 4];
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++) {
+				inside = planes[p][0] * sphere[0] + planes[p][1] * sphere[1] + planes[p][2] * sphere[2] + planes[p][3] >= -sphere[3];
+			}
+			if (inside) visible.push_back(i);
+		}
+		if (sorter != nullptr) sorter->sort(planets, centers, view_projection, visible);
+
+		// sorting : a counting sort into the fixed batches (stable, the order of the visible bodies within each batch)
+		for (DrawBatch& batch : packet.batches) batch.instance_count = 0;
+		for (uint32_t i : visible) packet.batches[body_batch[i]].instance_count++;
+		uint32_t first = 0;
+		for (size_t b = 0; b < packet.batches.size(); b++) {
+			packet.batches[b].first_instance = first;
+			placed[b] = first;
+			first += packet.batches[b].instance_count;
+		}
+
+		// draw list : the model matrices in batch order
+		for (uint32_t i : visible) {
+			uint32_t slot = placed[body_batch[i]]++;
+			bodyModel(planets, i, time, &packet.models[slot * 16]);
+		}
+		packet.visible_count = static_cast<uint32_t>(visible.size());
+		return packet;
+	}
+
+	void render(RenderBackend& backend, double time, const float view_projection[16]) {
+		backend.submit(buildFrame(time, view_projection));
+	}
+
+private:
+
+	uint64_t batchKey(uint32_t i) const {
+		const Planet& planet = planets[i];
+		return uint64_t(isTransparent(planet) ? 1 : 0) << 48 | uint64_t(planet.vertex_index & 0xff) << 40 |
+			uint64_t(isLit(i) ? 1 : 0) << 32 | uint64_t(planet.texture_index & 0xffff) << 16 | (planet.alpha_index & 0xffff);
+	}
+
+	// rows of the matrix added to and subtracted from the w row, normalized so the distances are in world units
+	static void frustumPlanes(const float m[16], float planes[6][4]) {
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 4; c++) {
+				planes[r * 2][c] = m[c * 4 + 3] + m[c * 4 + r];
+				planes[r * 2 + 1][c] = m[c * 4 + 3] - m[c * 4 + r];
+			}
+		}
+		for (int p = 0; p < 6; p++) {
+			float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+			for (int c = 0; c < 4; c++) planes[p][c] /= length;
+		}
+	}
+
+	std::vector<Planet> planets;
+	std::vector<uint32_t> body_batch; // batch of each body
+	std::vector<float> centers;       // bounding sphere of each body this frame (center, radius)
+	std::vector<uint32_t> visible;
+	std::vector<uint32_t> placed;     // next free instance of each batch
+	FramePacket packet;
+	FrameSorter* sorter = nullptr;
+};
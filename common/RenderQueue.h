@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// passes in recording order
+enum DrawPass { DRAW_PASS_OPAQUE, DRAW_PASS_IMPOSTOR, DRAW_PASS_TRANSPARENT };
+
+// one draw of the frame : the key orders it, the other fields say what to bind
+struct DrawItem {
+	uint64_t key;
+	uint32_t body;     // planet index (or whatever the owner draws)
+	uint8_t pass;
+	uint8_t pipeline;
+	uint8_t mesh;
+};
+
+// the sequence of binds and draws is the same (the depths may differ)
+inline bool sameDraws(const std::vector<DrawItem>& a, const std::vector<DrawItem>& b) {
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].body != b[i].body || a[i].pass != b[i].pass || a[i].pipeline != b[i].pipeline || a[i].mesh != b[i].mesh) return false;
+	}
+	return true;
+}
+
+// draws of a frame ordered by 64-bit sort keys
+//   opaque passes : pass 4 | pipeline 8 | mesh 4 | depth 24 | material 24  (front to back within a state)
+//   transparent   : pass 4 | depth 24 (back to front) | pipeline 8 | mesh 4 | material 24
+// every body binds its own descriptor set anyway, so the material only breaks ties.
+// the depth is the top 24 bits of the positive float distance, whose bit pattern orders like the value.
+class RenderQueue {
+
+public:
+
+	void clear() { draws.clear(); }
+
+	void add(DrawPass pass, uint32_t pipeline, uint32_t mesh, uint32_t material, float depth, uint32_t body) {
+		uint64_t depthBits = quantizeDepth(depth);
+		uint64_t key = uint64_t(pass) << 60;
+		if (pass == DRAW_PASS_TRANSPARENT) {
+			key |= ((~depthBits) & 0xFFFFFF) << 36 | uint64_t(pipeline & 0xFF) << 28 | uint64_t(mesh & 0xF) << 24;
+		}
+		else {
+			key |= uint64_t(pipeline & 0xFF) << 52 | uint64_t(mesh & 0xF) << 48 | depthBits << 24;
+		}
+		key |= material & 0xFFFFFF;
+
+		draws.push_back({ key, body, uint8_t(pass), uint8_t(pipeline), uint8_t(mesh) });
+	}
+
+	// LSD radix sort, 8 bits per pass (stable, a pass is skipped when every key has the same digit)
+	void sort() {
+		scratch.resize(draws.size());
+
+		for (uint32_t shift = 0; shift < 64; shift += 8) {
+			uint32_t count[256] = {};
+			for (auto& draw : draws) count[(draw.key >> shift) & 0xFF]++;
+			if (count[(draws.empty() ? 0 : draws[0].key >> shift) & 0xFF] == draws.size()) continue;
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; digit++) {
+				uint32_t n = count[digit];
+				count[digit] = offset;
+				offset += n;
+			}
+			for (auto& draw : draws) scratch[count[(draw.key >> shift) & 0xFF]++] = draw;
+			draws.swap(scratch);
+		}
+	}
+
+	const std::vector<DrawItem>& items() const { return draws; }
+
+private:
+
+	static uint64_t quantizeDepth(float depth) {
+		if (!(depth > 0.0f)) return 0; // behind the eye (or NaN) : nearest
+		uint32_t bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return bits >> 7; // sign bit is 0 : 31 bits left, keep 24
+	}
+
+	std::vector<DrawItem> draws;
+	std::vector<DrawItem> scratch;
+};
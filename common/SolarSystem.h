@@ -0,0 +1,238 @@
+#pragma once
+
+// the scene both renderers draw : the bodies, their meshes and their transforms
+// plain floats only, each renderer converts into its own vertex and matrix types
+
+#include "Planet.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// Planet::vertex_index
+enum SolarMesh { MESH_SPHERE = 0, MESH_RING = 1, MESH_COUNT };
+
+static const uint32_t NUM_SOLAR_TEXTURES = 15;
+static const uint32_t WHITE_TEXTURE_INDEX = 12; // 1x1 white texture, the alpha map of the opaque bodies
+
+// image of each texture index (nullptr : the white texture, made by the renderer)
+static const char* const SOLAR_TEXTURE_PATHS[NUM_SOLAR_TEXTURES] = {
+	"./textures/sun.jpg",
+	"./textures/mercury.jpg",
+	"./textures/venus.jpg",
+	"./textures/earth.jpg",
+	"./textures/mars.jpg",
+	"./textures/jupiter.jpg",
+	"./textures/saturn.jpg",
+	"./textures/uranus.jpg",
+	"./textures/neptune.jpg",
+	"./textures/moon.jpg",
+	"./textures/saturn-ring.jpg",
+	"./textures/saturn-ring-alpha.jpg",
+	nullptr,
+	"./textures/uranus-ring.jpg",
+	"./textures/uranus-ring-alpha.jpg",
+};
+
+// normal and bump (height) maps of each colour texture index (nullptr : none, a flat one is made by the renderer)
+static const char* const SOLAR_NORMAL_PATHS[NUM_SOLAR_TEXTURES] = {
+	nullptr,
+	"./textures/mercury-normal.jpg",
+	"./textures/venus-normal.jpg",
+	"./textures/earth-normal.jpg",
+	"./textures/mars-normal.jpg",
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	"./textures/moon-normal.jpg",
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+};
+
+static const char* const SOLAR_BUMP_PATHS[NUM_SOLAR_TEXTURES] = {
+	nullptr,
+	"./textures/mercury-bump.jpg",
+	"./textures/venus-bump.jpg",
+	"./textures/earth-bump.jpg",
+	"./textures/mars-bump.jpg",
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	"./textures/moon-bump.jpg",
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+};
+
+struct SceneVertex {
+	float pos[3];
+	float norm[3];
+	float tex[2]; // the images are stored top row first : v grows downwards
+};
+
+// bodies with a real alpha map are drawn after the opaque ones, with blending
+inline bool isTransparent(const Planet& planet) { return planet.alpha_index != WHITE_TEXTURE_INDEX; }
+
+// the Sun is the light, every other body is lit
+inline bool isLit(uint32_t planetIndex) { return planetIndex != 0; }
+
+// unit sphere, tess longitudes and tess / 2 latitudes (each longitude has tess / 2 + 1 vertices)
+inline void createSphereMesh(uint32_t tess, std::vector<SceneVertex>& vertices, std::vector<uint32_t>& indices) {
+	const float pi = 3.141592653589793f;
+
+	// i : longitude, k : latitude
+	vertices.clear();
+	for (uint32_t i = 0; i <= tess; i++) {
+
+		// t : theta - angle of longitude
+		float t = pi * 2.0f / float(tess) * float(i);
+
+		for (uint32_t k = 0; k <= tess / 2; k++) {
+
+			// p : pi - angle of latitude
+			float p = pi * 2.0f / float(tess) * float(k);
+
+			float x = sinf(p) * cosf(t), y = sinf(p) * sinf(t), z = cosf(p);
+			vertices.push_back({ { x, y, z }, { x, y, z }, { t / 2 / pi, p / pi } });
+		}
+	}
+
+	indices.clear();
+	const uint32_t stride = tess / 2 + 1;
+	for (uint32_t i = 0; i < tess; i++) {
+		for (uint32_t k = 0; k < tess / 2; k++) {
+			indices.push_back(i * stride + k);
+			indices.push_back(i * stride + k + 1);
+			indices.push_back((i + 1) * stride + k + 1);
+
+			indices.push_back((i + 1) * stride + k + 1);
+			indices.push_back((i + 1) * stride + k);
+			indices.push_back(i * stride + k);
+		}
+	}
+}
+
+// flat ring of outer radius 1 and inner radius 0.6, both faces (the ring texture only varies along u)
+inline void createRingMesh(uint32_t tess, std::vector<SceneVertex>& vertices, std::vector<uint32_t>& indices) {
+	const float pi = 3.141592653589793f;
+
+	// i : longitude
+	vertices.clear();
+	for (uint32_t i = 0; i <= tess; i++) {
+
+		// t : theta - angle of longitude
+		float t = pi * 2.0f / float(tess) * float(i);
+
+		float x = cosf(t), y = sinf(t);
+
+		// v in [0,1] so it can be stored as unorm
+		float v = t / 2 / pi;
+
+		vertices.push_back({ { x * 1.0f, y * 1.0f, 0 }, { x * 1.0f, y * 1.0f, 0 }, { 0, v } });
+		vertices.push_back({ { x * 0.6f, y * 0.6f, 0 }, { x * 0.6f, y * 0.6f, 0 }, { 1, v } });
+	}
+
+	// like flatten doughnut
+	indices.clear();
+	for (uint32_t i = 0; i < tess; i++) {
+		uint32_t quad[12] = {
+			i * 2, i * 2 + 1, (i + 1) * 2 + 1,
+			(i + 1) * 2 + 1, i * 2 + 1, i * 2,
+			(i + 1) * 2 + 1, (i + 1) * 2, i * 2,
+			i * 2, (i + 1) * 2, (i + 1) * 2 + 1,
+		};
+		indices.insert(indices.end(), quad, quad + 12);
+	}
+}
+
+// the Sun, the planets, their satellites and rings, and count tiny planets around random planets
+inline void createSolarSystem(std::vector<Planet>& planets, unsigned int seed, int count = 1000) {
+
+	const uint32_t W = WHITE_TEXTURE_INDEX;
+	planets.clear();
+
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 0, W, 0.0f, 5.4f, 5.2f, 0.0f));       // Sun
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 1, W, 9.9f, 0.6f, 7.7f, 3.1f));       // Mercury
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 2, W, 15.8f, 1.0f, 15.6f, 3.9f));     // Venus
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 3, W, 19.3f, 1.0f, 1.0f, 4.4f));      // Earth
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 4, W, 24.2f, 0.7f, 1.0f, 5.1f));      // Mars
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 5, W, 36.8f, 3.3f, 0.6f, 8.1f));      // Jupiter
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 6, W, 61.4f, 3.1f, 0.6f, 10.2f));     // Saturn
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 7, W, 82.6f, 2.0f, 0.8f, 13.2f));     // Uranus
+	planets.push_back(Planet(NO_PARENT, MESH_SPHERE, 8, W, 103.6f, 2.0f, 0.8f, 15.6f));    // Neptune
+
+	// Setellite instance
+	planets.push_back(Planet(3, MESH_SPHERE, 9, W, 2.5f, 0.3f, 27.3f, 1.0f));  // Moon (Setellite of the Earth)
+
+	planets.push_back(Planet(5, MESH_SPHERE, 9, W, 4.0f, 0.4f, 0.4f, 0.4f));  // Io (Setellite of the Jupiter)
+	planets.push_back(Planet(5, MESH_SPHERE, 9, W, 8.5f, 0.5f, 4.0f, 4.0f));  // Callisto (Setellite of the Jupiter)
+	planets.push_back(Planet(5, MESH_SPHERE, 9, W, 5.0f, 0.3f, 0.8f, 0.8f));  // Europa (Setellite of the Jupiter)
+	planets.push_back(Planet(5, MESH_SPHERE, 9, W, 7.0f, 0.6f, 2.0f, 2.0f));  // Ganymede (Setellite of the Jupiter)
+
+	planets.push_back(Planet(7, MESH_SPHERE, 9, W, 3.8f, 0.3f, 0.4f, 0.4f));  // Miranda (Setellite of the Uranus)
+	planets.push_back(Planet(7, MESH_SPHERE, 9, W, 5.0f, 0.5f, 0.5f, 0.5f));  // Ariel (Setellite of the Uranus)
+	planets.push_back(Planet(7, MESH_SPHERE, 9, W, 6.5f, 0.5f, 0.6f, 0.6f));  // Umbriel (Setellite of the Uranus)
+	planets.push_back(Planet(7, MESH_SPHERE, 9, W, 8.0f, 0.7f, 0.8f, 0.8f));  // Titania (Setellite of the Uranus)
+	planets.push_back(Planet(7, MESH_SPHERE, 9, W, 10.0f, 0.7f, 1.3f, 1.3f)); // Oberon (Setellite of the Uranus)
+
+	planets.push_back(Planet(8, MESH_SPHERE, 9, W, 5.0f, 0.8f, -0.6f, -0.6f)); // Triton (Setellite of the Neptune)
+	planets.push_back(Planet(8, MESH_SPHERE, 9, W, 7.0f, 0.5f, 1.1f, 30.0f));  // Nereid (Setellite of the Neptune)
+
+	// Ring
+	planets.push_back(Planet(6, MESH_RING, 10, 11, 0.0f, 6.2f, 0.0f, 0.0f));   // Saturn
+	planets.push_back(Planet(7, MESH_RING, 13, 14, 0.0f, 3.6f, 0.0f, 0.0f));   // Uranus
+
+	// other tiny planets
+	srand(seed);
+	for (int i = 0; i < count; i++) {
+		int parent = rand() % 9;
+		planets.push_back(Planet(parent, MESH_SPHERE, 9, W, planets.at(parent).radius + 1 + rand() % 500 / 100.0f, 0.01f + rand() % 10 / 100.0f, 1.0f + rand() % 1000 / 100.0f, 1.0f + rand() % 1000 / 100.0f));
+	}
+}
+
+// position of a body at an absolute simulation time (the bodies move in the z = 0 plane)
+inline void bodyCenter(const std::vector<Planet>& planets, uint32_t planetIndex, double time, float center[3]) {
+	const Planet& planet = planets[planetIndex];
+	float revolution = planet.revolution_theta(time);
+	center[0] = cosf(revolution) * planet.distance;
+	center[1] = sinf(revolution) * planet.distance;
+	center[2] = 0.0f;
+	if (planet.parent_index == NO_PARENT) return;
+
+	const Planet& parent = planets[planet.parent_index];
+	float parentRevolution = parent.revolution_theta(time);
+	center[0] = cosf(parentRevolution) * parent.distance + cosf(parentRevolution + revolution) * planet.distance;
+	center[1] = sinf(parentRevolution) * parent.distance + sinf(parentRevolution + revolution) * planet.distance;
+}
+
+// column-major model matrix, scaled by the radius
+// rotate(parent revolution) translate(parent distance) rotate(revolution) translate(distance) rotate(parent rotation)
+// rotate(rotation) : every rotation is about z, so this is the translation to the center and one rotation by the sum
+inline void bodyModel(const std::vector<Planet>& planets, uint32_t planetIndex, double time, float model[16]) {
+	const Planet& planet = planets[planetIndex];
+	float revolution = planet.revolution_theta(time);
+	float angle = revolution + planet.rotation_theta(time);
+	float center[3] = { cosf(revolution) * planet.distance, sinf(revolution) * planet.distance, 0.0f };
+	if (planet.parent_index != NO_PARENT) {
+		const Planet& parent = planets[planet.parent_index];
+		float parentRevolution = parent.revolution_theta(time);
+		angle += parentRevolution + parent.rotation_theta(time);
+		center[0] = cosf(parentRevolution) * parent.distance + cosf(parentRevolution + revolution) * planet.distance;
+		center[1] = sinf(parentRevolution) * parent.distance + sinf(parentRevolution + revolution) * planet.distance;
+	}
+
+	float c = cosf(angle) * planet.radius, s = sinf(angle) * planet.radius;
+
+	model[0] = c;     model[1] = s;     model[2] = 0.0f;           model[3] = 0.0f;
+	model[4] = -s;    model[5] = c;     model[6] = 0.0f;           model[7] = 0.0f;
+	model[8] = 0.0f;  model[9] = 0.0f;  model[10] = planet.radius; model[11] = 0.0f;
+	model[12] = center[0]; model[13] = center[1]; model[14] = center[2]; model[15] = 1.0f;
+}
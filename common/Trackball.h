@@ -1,6 +1,8 @@
 #pragma once
 #include "cgmath.h"
 
+// virtual trackball shared by the Vulkan and the OpenGL renderer, on cgmath (VulkanTest converts its glm camera)
+
 #define MODE_ROTATION   0
 #define MODE_ZOOM       1
 #define MODE_PANNING    2
@@ -40,7 +42,8 @@ struct Trackball
 			p1 = vec3(p1.x, p1.y, sqrtf(max(0, 1.0f - length2(p1)))).normalize();	// adjust z to make unit sphere
 
 			// find rotation axis and angle (with inverse view rotation to the world coordinate)
-			vec3 n = p0.cross(p1)*((mat3)view_matrix0);
+			vec3 axis = p0.cross(p1); mat3 view_rotation = (mat3)view_matrix0;
+			vec3 n = axis*view_rotation;
 			float angle = asin(min(n.length(), 0.999f));
 
 			// return resulting rotation matrix
@@ -61,7 +64,8 @@ struct Trackball
 
 			// panning
 			p1 = vec3(p1.y, -p1.x, sqrtf(max(0, 1.0f - length2(p1)))).normalize() * 10;	// adjust z to make unit sphere
-			vec3 n = p0.cross(p1) * ((mat3)view_matrix0) * 3;
+			vec3 axis = p0.cross(p1); mat3 view_rotation = (mat3)view_matrix0;
+			vec3 n = axis * view_rotation * 3;
 
 			return view_matrix0 * mat4::translate(n.x, n.y, n.z);
 
@@ -32,6 +32,17 @@
 #elif defined(__GNUC__)&&!defined(__forceinline)
 	#define __forceinline inline __attribute__((__always_inline__))
 #endif
+// SIMD of mat4 (define CGMATH_NO_SIMD for plain floats)
+#if !defined(CGMATH_NO_SIMD)&&(defined(__SSE__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=1))
+	#include <immintrin.h>
+	#define CGMATH_SSE
+	#if defined(__AVX__)
+		#define CGMATH_AVX
+	#endif
+#elif !defined(CGMATH_NO_SIMD)&&(defined(__ARM_NEON)||defined(_M_ARM64))
+	#include <arm_neon.h>
+	#define CGMATH_NEON
+#endif
 // common macros
 #ifndef PI
 	#define PI 3.141592653589793f
@@ -303,6 +314,156 @@ struct mat3
 	}
 };
 
+//*******************************************************************
+// 4-wide float operations of mat4: SSE (two rows at once with AVX), NEON, or plain floats
+// every path runs the same lane operations in the same order, so they all give the same results
+// (the products, rotate and lookAt also match the scalar formulas, unless the compiler contracts them into FMAs)
+namespace simd
+{
+#if defined(CGMATH_SSE)
+	typedef __m128 f4;
+	__forceinline f4 load( const float* p ){ return _mm_loadu_ps(p); }
+	__forceinline void store( float* p, f4 v ){ _mm_storeu_ps(p,v); }
+	__forceinline f4 set( float x, float y, float z, float w ){ return _mm_setr_ps(x,y,z,w); }
+	__forceinline f4 splat( float f ){ return _mm_set1_ps(f); }
+	__forceinline f4 add( f4 a, f4 b ){ return _mm_add_ps(a,b); }
+	__forceinline f4 sub( f4 a, f4 b ){ return _mm_sub_ps(a,b); }
+	__forceinline f4 mul( f4 a, f4 b ){ return _mm_mul_ps(a,b); }
+	__forceinline f4 div( f4 a, f4 b ){ return _mm_div_ps(a,b); }
+	__forceinline float first( f4 v ){ return _mm_cvtss_f32(v); }
+	template <int i, int j, int k, int l> __forceinline f4 shuffle( f4 a, f4 b ){ return _mm_shuffle_ps(a,b,_MM_SHUFFLE(l,k,j,i)); } // (a[i],a[j],b[k],b[l])
+#elif defined(CGMATH_NEON)
+	typedef float32x4_t f4;
+	__forceinline f4 load( const float* p ){ return vld1q_f32(p); }
+	__forceinline void store( float* p, f4 v ){ vst1q_f32(p,v); }
+	__forceinline f4 set( float x, float y, float z, float w ){ float p[4]={x,y,z,w}; return vld1q_f32(p); }
+	__forceinline f4 splat( float f ){ return vdupq_n_f32(f); }
+	__forceinline f4 add( f4 a, f4 b ){ return vaddq_f32(a,b); }
+	__forceinline f4 sub( f4 a, f4 b ){ return vsubq_f32(a,b); }
+	__forceinline f4 mul( f4 a, f4 b ){ return vmulq_f32(a,b); }
+#if defined(__aarch64__)||defined(_M_ARM64)
+	__forceinline f4 div( f4 a, f4 b ){ return vdivq_f32(a,b); }
+#else
+	__forceinline f4 div( f4 a, f4 b ){ return set(vgetq_lane_f32(a,0)/vgetq_lane_f32(b,0),vgetq_lane_f32(a,1)/vgetq_lane_f32(b,1),vgetq_lane_f32(a,2)/vgetq_lane_f32(b,2),vgetq_lane_f32(a,3)/vgetq_lane_f32(b,3)); }
+#endif
+	__forceinline float first( f4 v ){ return vgetq_lane_f32(v,0); }
+	template <int i, int j, int k, int l> __forceinline f4 shuffle( f4 a, f4 b ){ return set(vgetq_lane_f32(a,i),vgetq_lane_f32(a,j),vgetq_lane_f32(b,k),vgetq_lane_f32(b,l)); }
+#else
+	struct f4 { float v[4]; };
+	inline f4 load( const float* p ){ f4 r={{p[0],p[1],p[2],p[3]}}; return r; }
+	inline void store( float* p, f4 v ){ p[0]=v.v[0]; p[1]=v.v[1]; p[2]=v.v[2]; p[3]=v.v[3]; }
+	inline f4 set( float x, float y, float z, float w ){ f4 r={{x,y,z,w}}; return r; }
+	inline f4 splat( float f ){ f4 r={{f,f,f,f}}; return r; }
+	inline f4 add( f4 a, f4 b ){ for( int k=0; k<4; k++ ) a.v[k]+=b.v[k]; return a; }
+	inline f4 sub( f4 a, f4 b ){ for( int k=0; k<4; k++ ) a.v[k]-=b.v[k]; return a; }
+	inline f4 mul( f4 a, f4 b ){ for( int k=0; k<4; k++ ) a.v[k]*=b.v[k]; return a; }
+	inline f4 div( f4 a, f4 b ){ for( int k=0; k<4; k++ ) a.v[k]/=b.v[k]; return a; }
+	inline float first( f4 v ){ return v.v[0]; }
+	template <int i, int j, int k, int l> inline f4 shuffle( f4 a, f4 b ){ f4 r={{a.v[i],a.v[j],b.v[k],b.v[l]}}; return r; }
+#endif
+
+	// composite operations : the same on every path
+	template <int i, int j, int k, int l> __forceinline f4 swizzle( f4 v ){ return shuffle<i,j,k,l>(v,v); }
+	template <int i> __forceinline f4 broadcast( f4 v ){ return shuffle<i,i,i,i>(v,v); }
+	__forceinline f4 hsum( f4 v ){ v=add(v,swizzle<1,0,3,2>(v)); return add(v,swizzle<2,3,0,1>(v)); }	// (x+y)+(z+w) in every lane
+	__forceinline f4 dot3( f4 a, f4 b ){ return hsum(mul(a,b)); }										// w must be 0
+	__forceinline f4 cross3( f4 a, f4 b ){ return sub(mul(swizzle<1,2,0,3>(a),swizzle<2,0,1,3>(b)),mul(swizzle<2,0,1,3>(a),swizzle<1,2,0,3>(b))); }
+	__forceinline f4 normalize3( f4 v ){ return div(v,splat(sqrt(first(dot3(v,v))))); }
+	__forceinline f4 load3( const float* p ){ return set(p[0],p[1],p[2],0); }
+	__forceinline void transpose( f4& r0, f4& r1, f4& r2, f4& r3 )
+	{
+		f4 t0=shuffle<0,1,0,1>(r0,r1), t1=shuffle<2,3,2,3>(r0,r1), t2=shuffle<0,1,0,1>(r2,r3), t3=shuffle<2,3,2,3>(r2,r3);
+		r0=shuffle<0,2,0,2>(t0,t2); r1=shuffle<1,3,1,3>(t0,t2); r2=shuffle<0,2,0,2>(t1,t3); r3=shuffle<1,3,1,3>(t1,t3);
+	}
+
+	// r = a*b (row-major): row i of r is a[i][0]*b.row0 + a[i][1]*b.row1 + a[i][2]*b.row2 + a[i][3]*b.row3
+	inline void mat4_mul( const float* a, const float* b, float* r )
+	{
+#if defined(CGMATH_AVX)
+		__m256 b0=_mm256_broadcast_ps((const __m128*)(b)), b1=_mm256_broadcast_ps((const __m128*)(b+4)), b2=_mm256_broadcast_ps((const __m128*)(b+8)), b3=_mm256_broadcast_ps((const __m128*)(b+12));
+		for( int i=0; i<16; i+=8 )	// rows i/4 and i/4+1, one in each 128-bit half
+		{
+			__m256 ai=_mm256_loadu_ps(a+i);
+			__m256 ri=_mm256_mul_ps(_mm256_shuffle_ps(ai,ai,0x00),b0);
+			ri=_mm256_add_ps(ri,_mm256_mul_ps(_mm256_shuffle_ps(ai,ai,0x55),b1));
+			ri=_mm256_add_ps(ri,_mm256_mul_ps(_mm256_shuffle_ps(ai,ai,0xaa),b2));
+			_mm256_storeu_ps(r+i,_mm256_add_ps(ri,_mm256_mul_ps(_mm256_shuffle_ps(ai,ai,0xff),b3)));
+		}
+#else
+		f4 b0=load(b), b1=load(b+4), b2=load(b+8), b3=load(b+12);
+		for( int i=0; i<16; i+=4 )	// one load of the row, its elements broadcast in registers (as the AVX path)
+		{
+			f4 ai=load(a+i);
+			store(r+i,add(add(add(mul(broadcast<0>(ai),b0),mul(broadcast<1>(ai),b1)),mul(broadcast<2>(ai),b2)),mul(broadcast<3>(ai),b3)));
+		}
+#endif
+	}
+
+	// r = a*v: the columns of a weighted by v
+	inline void mat4_mul_vec4( const float* a, const float* v, float* r )
+	{
+		f4 c0=load(a), c1=load(a+4), c2=load(a+8), c3=load(a+12), x=load(v); transpose(c0,c1,c2,c3);
+		store(r,add(add(add(mul(c0,broadcast<0>(x)),mul(c1,broadcast<1>(x))),mul(c2,broadcast<2>(x))),mul(c3,broadcast<3>(x))));
+	}
+
+	// rotation about a unit axis: row i is axis[i]*axis*(1-c) plus the cosine and sine terms
+	inline void mat4_rotate( const float* axis, float angle, float* r )
+	{
+		float c=cos(angle), s=sin(angle), x=axis[0], y=axis[1], z=axis[2];
+		f4 v=load3(axis), t=splat(1-c);
+		store(r,add(mul(mul(splat(x),v),t),set(c,-z*s,y*s,0)));
+		store(r+4,add(mul(mul(splat(y),v),t),set(z*s,c,-x*s,0)));
+		store(r+8,add(mul(mul(splat(z),v),t),set(-y*s,x*s,c,0)));
+		store(r+12,set(0,0,0,1.0f));
+	}
+
+	// view matrix: the rows are the camera frame, translated by the eye
+	inline void mat4_look_at( const float* eye, const float* at, const float* up, float* r )
+	{
+		f4 e=load3(eye), n=normalize3(sub(e,load3(at))), u=normalize3(cross3(load3(up),n)), v=normalize3(cross3(n,u)), minus=splat(-1.0f);
+		f4 du=mul(dot3(u,e),minus), dv=mul(dot3(v,e),minus), dn=mul(dot3(n,e),minus);
+		store(r,shuffle<0,1,0,2>(u,shuffle<2,2,0,0>(u,du)));	// (u.x, u.y, u.z, -u.eye)
+		store(r+4,shuffle<0,1,0,2>(v,shuffle<2,2,0,0>(v,dv)));
+		store(r+8,shuffle<0,1,0,2>(n,shuffle<2,2,0,0>(n,dn)));
+		store(r+12,set(0,0,0,1.0f));
+	}
+
+	// 2x2 blocks (row-major, one per f4): a*b, adj(a)*b and a*adj(b)
+	__forceinline f4 mat2_mul( f4 a, f4 b ){ return add(mul(a,swizzle<0,3,0,3>(b)),mul(swizzle<1,0,3,2>(a),swizzle<2,1,2,1>(b))); }
+	__forceinline f4 mat2_adj_mul( f4 a, f4 b ){ return sub(mul(swizzle<3,3,0,0>(a),b),mul(swizzle<1,1,2,2>(a),swizzle<2,3,0,1>(b))); }
+	__forceinline f4 mat2_mul_adj( f4 a, f4 b ){ return sub(mul(a,swizzle<3,0,3,0>(b)),mul(swizzle<1,0,3,2>(a),swizzle<2,1,2,1>(b))); }
+
+	// inverse by 2x2 blocks [A B; C D] and their adjugates, returns the determinant (r is not written when it is 0)
+	inline float mat4_inverse( const float* m, float* r )
+	{
+		f4 r0=load(m), r1=load(m+4), r2=load(m+8), r3=load(m+12);
+		f4 A=shuffle<0,1,0,1>(r0,r1), B=shuffle<2,3,2,3>(r0,r1), C=shuffle<0,1,0,1>(r2,r3), D=shuffle<2,3,2,3>(r2,r3);
+
+		// |A| |B| |C| |D|
+		f4 det_sub=sub(mul(shuffle<0,2,0,2>(r0,r2),shuffle<1,3,1,3>(r1,r3)),mul(shuffle<1,3,1,3>(r0,r2),shuffle<0,2,0,2>(r1,r3)));
+		f4 det_a=broadcast<0>(det_sub), det_b=broadcast<1>(det_sub), det_c=broadcast<2>(det_sub), det_d=broadcast<3>(det_sub);
+
+		f4 d_c=mat2_adj_mul(D,C), a_b=mat2_adj_mul(A,B);
+		f4 x=sub(mul(det_d,A),mat2_mul(B,d_c));		// |D|A - B(D#C)
+		f4 w=sub(mul(det_a,D),mat2_mul(C,a_b));		// |A|D - C(A#B)
+		f4 y=sub(mul(det_b,C),mat2_mul_adj(D,a_b));	// |B|C - D(A#B)#
+		f4 z=sub(mul(det_c,B),mat2_mul_adj(A,d_c));	// |C|B - A(D#C)#
+
+		// |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+		float det=first(sub(add(mul(det_a,det_d),mul(det_b,det_c)),hsum(mul(a_b,swizzle<0,2,1,3>(d_c)))));
+		if(det==0) return det;
+
+		// adjugate signs, then the blocks back into rows
+		f4 s=mul(set(1.0f,-1.0f,-1.0f,1.0f),splat(1.0f/det));
+		x=mul(x,s); y=mul(y,s); z=mul(z,s); w=mul(w,s);
+		store(r,shuffle<3,1,3,1>(x,y));
+		store(r+4,shuffle<2,0,2,0>(x,y));
+		store(r+8,shuffle<3,1,3,1>(z,w));
+		store(r+12,shuffle<2,0,2,0>(z,w));
+		return det;
+	}
+}
+
 //*******************************************************************
 // matrix 4x4: uses a standard row-major notation
 struct mat4
@@ -346,13 +507,13 @@ struct mat4
 
 	// multiplication operators
 	inline mat4 operator*( float f ) const { mat4 r; for( int k=0; k < std::extent<decltype(a)>::value; k++ ) r[k]=a[k]*f; return r; }
-	inline vec4 operator*( const vec4& v ) const { return vec4(rvec4(0).dot(v), rvec4(1).dot(v), rvec4(2).dot(v), rvec4(3).dot(v)); }
-	inline mat4 operator*( const mat4& m ) const { mat4 t=m.transpose(), r; for(uint k=0;k<4;k++) r.rvec4(k)=t.operator*(rvec4(k)); return r; } // a bit tricky implementation
+	inline vec4 operator*( const vec4& v ) const { vec4 r; simd::mat4_mul_vec4(a,&v.x,&r.x); return r; }
+	inline mat4 operator*( const mat4& m ) const { mat4 r; simd::mat4_mul(a,m.a,r.a); return r; }
 	inline mat4& operator*=( const mat4& m ){ return *this=operator*(m); }
 	
 	// determinant and inverse: see below for implementations
 	inline float determinant() const;
-	inline mat4 inverse() const; 
+	inline mat4 inverse() const; // the identity (and a warning) when singular, the formula before simd:: divided by a zero determinant
 
 	// static row-major transformations
 	static mat4 translate( const vec3& v ){ return mat4().setTranslate(v); }
@@ -375,32 +536,11 @@ struct mat4
 	inline mat4& setRotateY( float theta ){ return setRotate(vec3(0,1,0),theta); }
 	inline mat4& setRotateZ( float theta ){ return setRotate(vec3(0,0,1),theta); }
 	
-	inline mat4& setRotate( const vec3& axis, float angle )
-	{
-		float c=cos(angle), s=sin(angle), x=axis.x, y=axis.y, z=axis.z;
-		a[0] = x*x*(1-c)+c;		a[1] = x*y*(1-c)-z*s;		a[2] = x*z*(1-c)+y*s;	a[3] = 0.0f;
-		a[4] = x*y*(1-c)+z*s;	a[5] = y*y*(1-c)+c;			a[6] = y*z*(1-c)-x*s;	a[7] = 0.0f;
-		a[8] = x*z*(1-c)-y*s;	a[9] = y*z*(1-c)+x*s;		a[10] = z*z*(1-c)+c;		a[11] = 0.0f;
-		a[12] = 0;				a[13] = 0;					a[14] = 0;				a[15] = 1.0f;
-		return *this;
-	}
+	// a[0..2] = x*x*(1-c)+c, x*y*(1-c)-z*s, x*z*(1-c)+y*s, and so on for the other rows
+	inline mat4& setRotate( const vec3& axis, float angle ){ simd::mat4_rotate(&axis.x,angle,a); return *this; }
 
-	mat4& setLookAt( const vec3& eye, const vec3& at, const vec3& up )
-	{
-		setIdentity();
-		
-		// define camera frame
-		vec3 n = (eye - at).normalize();
-		vec3 u = (up ^ n).normalize();
-		vec3 v = (n ^ u).normalize();
-
-		// calculate lookAt matrix
-		_11 = u.x;  _12 = u.y;  _13 = u.z;  _14 = -u.dot(eye);
-		_21 = v.x;  _22 = v.y;  _23 = v.z;  _24 = -v.dot(eye);
-		_31 = n.x;  _32 = n.y;  _33 = n.z;  _34 = -n.dot(eye);
-		
-		return *this;
-	};
+	// camera frame n = (eye-at).normalize(), u = (up^n).normalize(), v = (n^u).normalize() in the rows, translated by -eye
+	inline mat4& setLookAt( const vec3& eye, const vec3& at, const vec3& up ){ simd::mat4_look_at(&eye.x,&at.x,&up.x,a); return *this; }
 	
 	mat4& setPerspective( float fovy, float aspectRatio, float dNear, float dFar )
 	{
@@ -427,28 +567,11 @@ inline float mat4::determinant() const
 	_31 * _12 * _23 * _44 - _11 * _32 * _23 * _44 - _21 * _12 * _33 * _44 + _11 * _22 * _33 * _44 ;
 }
 
+// by 2x2 blocks (simd::mat4_inverse), the identity when m is singular
 inline mat4 mat4::inverse() const 
 {
-	float det=determinant(), s=1.0f/det; if(det==0) printf( "mat4::inverse() might be singular.\n" );
-	return mat4((_32*_43*_24 - _42*_33*_24 + _42*_23*_34 - _22*_43*_34 - _32*_23*_44 + _22*_33*_44)*s,
-				(_42*_33*_14 - _32*_43*_14 - _42*_13*_34 + _12*_43*_34 + _32*_13*_44 - _12*_33*_44)*s,
-				(_22*_43*_14 - _42*_23*_14 + _42*_13*_24 - _12*_43*_24 - _22*_13*_44 + _12*_23*_44)*s,
-				(_32*_23*_14 - _22*_33*_14 - _32*_13*_24 + _12*_33*_24 + _22*_13*_34 - _12*_23*_34)*s,
-
-				(_41*_33*_24 - _31*_43*_24 - _41*_23*_34 + _21*_43*_34 + _31*_23*_44 - _21*_33*_44)*s,
-				(_31*_43*_14 - _41*_33*_14 + _41*_13*_34 - _11*_43*_34 - _31*_13*_44 + _11*_33*_44)*s,
-				(_41*_23*_14 - _21*_43*_14 - _41*_13*_24 + _11*_43*_24 + _21*_13*_44 - _11*_23*_44)*s,
-				(_21*_33*_14 - _31*_23*_14 + _31*_13*_24 - _11*_33*_24 - _21*_13*_34 + _11*_23*_34)*s,
-
-				(_31*_42*_24 - _41*_32*_24 + _41*_22*_34 - _21*_42*_34 - _31*_22*_44 + _21*_32*_44)*s,
-				(_41*_32*_14 - _31*_42*_14 - _41*_12*_34 + _11*_42*_34 + _31*_12*_44 - _11*_32*_44)*s,
-				(_21*_42*_14 - _41*_22*_14 + _41*_12*_24 - _11*_42*_24 - _21*_12*_44 + _11*_22*_44)*s,
-				(_31*_22*_14 - _21*_32*_14 - _31*_12*_24 + _11*_32*_24 + _21*_12*_34 - _11*_22*_34)*s,
-
-				(_41*_32*_23 - _31*_42*_23 - _41*_22*_33 + _21*_42*_33 + _31*_22*_43 - _21*_32*_43)*s,
-				(_31*_42*_13 - _41*_32*_13 + _41*_12*_33 - _11*_42*_33 - _31*_12*_43 + _11*_32*_43)*s,
-				(_41*_22*_13 - _21*_42*_13 - _41*_12*_23 + _11*_42*_23 + _21*_12*_43 - _11*_22*_43)*s,
-				(_21*_32*_13 - _31*_22*_13 + _31*_12*_23 - _11*_32*_23 - _21*_12*_33 + _11*_22*_33)*s );
+	mat4 r; if(simd::mat4_inverse(a,r.a)==0) printf( "mat4::inverse() might be singular.\n" );
+	return r;
 }
 
 //*******************************************************************
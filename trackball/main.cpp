@@ -1,15 +1,19 @@
-#include "cgmath.h"			// slee's simple math library
+#include <thread>			// texture decoding threads (before cgmath.h and its min/max macros)
+#include "../common/RenderCore.h"	// scene and CPU frame shared with VulkanTest (before cgmath.h as well)
+#include "../common/cgmath.h"	// slee's simple math library, shared with VulkanTest
 #include "cgut.h"			// slee's OpenGL utility
-#include "trackball.h"		// virtual trackball
-#include "Planet.h"         // Planet info
+#include "../common/Trackball.h"	// virtual trackball, shared with VulkanTest
 
 //*******************************************************************
 // global constants
 static const char*	window_name = "cgbase - trackball";
 static const char*	vert_shader_path = "./shaders/trackball.vert";
 static const char*	frag_shader_path = "./shaders/trackball.frag";
+static const char*	mdi_vert_shader_path = "./shaders/trackball_mdi.vert";
+static const char*	mdi_frag_shader_path = "./shaders/trackball_mdi.frag";
 static const uint	NUM_TESS = 72 * 8;		// initial tessellation factor of the "sphere" as a "polyhedron"
-static const uint   NUM_TEXTURE = 12;  // number of texture
+static const uint   NUM_TEXTURE = NUM_SOLAR_TEXTURES;  // number of texture
+static const uint	NUM_FRAME_REGIONS = 3;	// frames in the persistent buffer of the AZDO mode (CPU writes one while the GPU reads the others)
 
 //*******************************************************************
 // include stb_image with the implementation preprocessor definition
@@ -40,6 +44,27 @@ struct LightInfo
 	vec4	specular = vec4(1.0f, 1.0f, 1.0f, 1.0f);
 };
 
+// uniform and attribute locations, looked up once after the program is linked
+struct ProgramLocations
+{
+	GLint	view_matrix, projection_matrix;
+	GLint	light_position, Ia, Id, Is, shininess;
+	GLint	use_shader, use_alpha_tex, TEX, TEX_ALPHA;
+	GLint	texture_array;	// sampler2DArray of the AZDO program
+	GLint	position, normal, texcoord;
+	GLint	model_matrix;	// per-instance attribute, 4 locations (one per column)
+};
+
+// layout of a glMultiDrawElementsIndirect command
+struct DrawElementsIndirectCommand
+{
+	GLuint	count;
+	GLuint	instance_count;
+	GLuint	first_index;
+	GLint	base_vertex;
+	GLuint	base_instance;
+};
+
 
 //*******************************************************************
 // window objects
@@ -53,6 +78,22 @@ GLuint	planet_vertex_buffer = 0;	// ID holder for vertex buffer (Planet)
 GLuint	planet_index_buffer = 0;	// ID holder for index buffer (Planet)
 GLuint	ring_vertex_buffer = 0;	// ID holder for vertex buffer (Ring)
 GLuint	ring_index_buffer = 0;	// ID holder for index buffer (Ring)
+GLuint	instance_buffer = 0;	// ID holder for instance buffer (model matrices of the visible bodies)
+GLuint	planet_vertex_array = 0;	// ID holder for vertex array (Planet : attributes, index buffer, instances)
+GLuint	ring_vertex_array = 0;	// ID holder for vertex array (Ring : attributes, index buffer, instances)
+
+//*******************************************************************
+// OpenGL objects of the AZDO mode : one vertex array, one multi-draw per frame
+GLuint	mdi_program = 0;			// ID holder for GPU program (AZDO mode)
+GLuint	mdi_vertex_array = 0;		// ID holder for vertex array (the meshes and the persistent buffer)
+GLuint	mdi_vertex_buffer = 0;		// ID holder for vertex buffer (Planet, then Ring)
+GLuint	mdi_index_buffer = 0;		// ID holder for index buffer (Planet, then Ring)
+GLuint	draw_parameter_buffer = 0;	// ID holder for shader storage buffer (texture and shading of each draw)
+GLuint	texture_array = 0;			// ID holder for 2D array texture (every texture as one layer, on unit NUM_TEXTURE)
+GLuint	persistent_buffer = 0;		// ID holder for persistently mapped buffer (instances and draw commands, per frame)
+GLubyte*	persistent_data = nullptr;	// coherent mapping of persistent_buffer
+GLsizeiptr	frame_region_size = 0;		// bytes of one frame in persistent_buffer (a multiple of sizeof(mat4))
+GLsync	frame_fences[NUM_FRAME_REGIONS] = {};	// the GPU is done with a region once its fence signals
 
 //*******************************************************************
 // global variables
@@ -61,7 +102,9 @@ float	RADIUS = 1.0f;
 bool	bWireframe = false;			// this is the default
 bool    bShiftKeyPressed = false;      // state of shift key pressed
 bool    bCtrlKeyPressed = false;      // state of ctrl key pressed
-float   current_time = 0.0f;
+bool	bAzdo = false;				// persistent buffers and multi-draw-indirect instead of per-group draws
+bool	bNull = false;				// record every frame into host memory, no GL call (null mode of the backend)
+double  current_time = 0.0;
 GLuint  textures[NUM_TEXTURE]; // texture array
 
 
@@ -77,10 +120,16 @@ std::vector<uint>	ring_index_list;		// host-side indices (Ring)
 CameraInfo cameraInfo;
 Trackball trackball;
 LightInfo lightInfo;
-std::vector<Planet> planet_list;    // planet list
 float planet_shininess = 1000.0f;   // shininess of planet
-uint saturn_ring_parent_index = -1;// parent index of saturn ring (saturn index)
-float saturn_ring_radius = 0.0f;    // radius of saturn ring
+
+//*******************************************************************
+// the frame : built by render_core, drawn by a backend
+RenderCore render_core;             // the planets, culling and the draw batches (common/RenderCore.h)
+DepthSorter depth_sorter;           // the ordering step of VulkanTest's frame as well (its render queue sort)
+std::vector<GLubyte> null_frame;    // null mode : the instances and draw commands of the frame, never submitted
+mat4 view_projection_matrix;        // column-major, for culling
+ProgramLocations locations;
+ProgramLocations mdi_locations;
 
 
 int frameCheckCount = 0;
@@ -94,137 +143,149 @@ void update()
 	cameraInfo.aspect_ratio = window_size.x/float(window_size.y);
 	cameraInfo.projection_matrix = mat4::perspective( cameraInfo.fovy, cameraInfo.aspect_ratio, cameraInfo.dNear, cameraInfo.dFar );
 
-	// update planet rotation, revolution
-	float elapsed_time = (float)glfwGetTime() - current_time;
-	for (int i = 0; i < (int)planet_list.size(); i++) {
-		planet_list.at(i).time_process(elapsed_time);
-	}
-	current_time += elapsed_time;
-
-	// update uniform variables in vertex/fragment shaders
-	GLint uloc;
-	uloc = glGetUniformLocation( program, "view_matrix" );			if(uloc>-1) glUniformMatrix4fv( uloc, 1, GL_TRUE, cameraInfo.view_matrix );
-	uloc = glGetUniformLocation( program, "projection_matrix" );	if(uloc>-1) glUniformMatrix4fv( uloc, 1, GL_TRUE, cameraInfo.projection_matrix );
+	// planet rotation, revolution : evaluated from the time in render()
+	current_time = glfwGetTime();
 
-	// setup light properties
-	uloc = glGetUniformLocation(program, "light_position");			if (uloc>-1) glUniform4fv(uloc, 1, lightInfo.position);
-	uloc = glGetUniformLocation(program, "Ia");						if (uloc>-1) glUniform4fv(uloc, 1, lightInfo.ambient);
-	uloc = glGetUniformLocation(program, "Id");						if (uloc>-1) glUniform4fv(uloc, 1, lightInfo.diffuse);
-	uloc = glGetUniformLocation(program, "Is");						if (uloc>-1) glUniform4fv(uloc, 1, lightInfo.specular);
+	// update uniform variables in vertex/fragment shaders (light and material are set once in user_init())
+	// null mode : no GL call at all
+	if(!bNull)
+	{
+		const ProgramLocations& loc = bAzdo ? mdi_locations : locations;
+		glUseProgram( bAzdo ? mdi_program : program );
+		if(loc.view_matrix>-1)			glUniformMatrix4fv( loc.view_matrix, 1, GL_TRUE, cameraInfo.view_matrix );
+		if(loc.projection_matrix>-1)	glUniformMatrix4fv( loc.projection_matrix, 1, GL_TRUE, cameraInfo.projection_matrix );
+	}
 
-	// setup material properties
-	uloc = glGetUniformLocation(program, "shininess");				if (uloc>-1) glUniform1f(uloc, planet_shininess);
+	// render_core takes column-major matrices (cgmath stores rows)
+	view_projection_matrix = (cameraInfo.projection_matrix*cameraInfo.view_matrix).transpose();
+}
 
+// vertex array and index count of a mesh
+GLuint mesh_vertex_array( uint mesh ) { return mesh==MESH_RING ? ring_vertex_array : planet_vertex_array; }
+size_t mesh_index_count( uint mesh ) { return mesh==MESH_RING ? ring_index_list.size() : planet_index_list.size(); }
 
+// draw the batch's instances at once (the vertex array of the mesh is bound)
+void draw_batch( const DrawBatch& batch )
+{
+	if(locations.TEX>-1)			glUniform1i( locations.TEX, batch.texture );
+	if(locations.TEX_ALPHA>-1)		glUniform1i( locations.TEX_ALPHA, batch.alpha_texture );
+	if(locations.use_shader>-1)		glUniform1i( locations.use_shader, batch.lit );
+	if(locations.use_alpha_tex>-1)	glUniform1i( locations.use_alpha_tex, batch.alpha_texture!=WHITE_TEXTURE_INDEX );
+
+	// the instances start at the batch's first one : base instance (GL 4.2), or the model matrix pointed there
+	GLsizei index_count = GLsizei(mesh_index_count(batch.mesh));
+	if(GLAD_GL_VERSION_4_2)
+	{
+		glDrawElementsInstancedBaseInstance( GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr, batch.instance_count, batch.first_instance );
+		return;
+	}
+	glBindBuffer( GL_ARRAY_BUFFER, instance_buffer );
+	for( GLint c=0; c<4 && locations.model_matrix>-1; c++ )
+		glVertexAttribPointer( locations.model_matrix+c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (GLvoid*)(sizeof(mat4)*batch.first_instance + sizeof(vec4)*c) );
+	glDrawElementsInstanced( GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr, batch.instance_count );
 }
 
-void render()
+// one instanced draw per non-empty batch, the instances are uploaded every frame
+void render_instanced( const FramePacket& packet )
 {
-	// clear screen (with background color) and clear depth buffer
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-	
 	// notify GL that we use our own program
 	glUseProgram( program );
 
-	// bind "planet" vertex attributes to your shader program
-	const char*	vertex_attrib[]	= { "position", "normal", "texcoord" };
-	size_t		attrib_size[]	= { sizeof(vertex().pos), sizeof(vertex().norm), sizeof(vertex().tex) };
-	for( size_t k=0, kn=std::extent<decltype(vertex_attrib)>::value, byte_offset=0; k<kn; k++, byte_offset+=attrib_size[k-1] )
+	// model matrices of this frame in batch order, uploaded into fresh storage (the previous frame may still read the old one)
+	glBindBuffer( GL_ARRAY_BUFFER, instance_buffer );
+	glBufferData( GL_ARRAY_BUFFER, sizeof(mat4)*render_core.scene().size(), nullptr, GL_STREAM_DRAW );
+	if(packet.visible_count) glBufferSubData( GL_ARRAY_BUFFER, 0, sizeof(mat4)*packet.visible_count, &packet.models[0] );
+
+	// the opaque batches, then the transparent ones (rings)
+	for( const DrawBatch& batch : packet.batches )
 	{
-		GLuint loc = glGetAttribLocation( program, vertex_attrib[k] ); if(loc>=kn) continue;
-		glEnableVertexAttribArray( loc );
-		glBindBuffer( GL_ARRAY_BUFFER, planet_vertex_buffer );
-		glVertexAttribPointer( loc, attrib_size[k]/sizeof(GLfloat), GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*) byte_offset );
+		if(batch.instance_count==0) continue;
+		glBindVertexArray( mesh_vertex_array(batch.mesh) );
+		draw_batch( batch );
 	}
-	
-	// use "planet" index buffer
-	if (planet_index_buffer) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planet_index_buffer);
-
-	// render each "planet"(sphere)
-	GLint uloc;
-	for (int i = 0; i < (int)planet_list.size(); i++) {
-
-		// radius, model matrix for planet
-		mat4 model_matrix = mat4::translate(0, 0, 0);
-
-		// child planet process
-		if (planet_list.at(i).parent_index != -1) {
+	glBindVertexArray( 0 );
+}
 
-			uint parent_index = planet_list.at(i).parent_index;
+// the instances of the frame, then one draw command per batch (empty ones included : the draw parameters are indexed by gl_DrawID)
+// the instance attribute starts at the beginning of the buffer, base_instance selects the region
+DrawElementsIndirectCommand* write_frame( const FramePacket& packet, GLubyte* data, GLuint base )
+{
+	memcpy(data, packet.models.data(), sizeof(mat4) * packet.visible_count);
+
+	DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)(data + sizeof(mat4) * render_core.scene().size());
+	for (size_t b = 0; b < packet.batches.size(); b++) {
+		const DrawBatch& batch = packet.batches[b];
+		bool ring = batch.mesh == MESH_RING; // the ring follows the planet in the mesh buffers
+		commands[b] = { GLuint(mesh_index_count(batch.mesh)), batch.instance_count, ring ? GLuint(planet_index_list.size()) : 0,
+			ring ? GLint(planet_vertex_list.size()) : 0, base + batch.first_instance };
+	}
+	return commands;
+}
 
-			// parent position, revolution process
-			model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(parent_index).revolution_theta) * mat4::translate(planet_list.at(parent_index).distance, 0, 0);
-			// child position, revolution process
-			model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(i).revolution_theta) * mat4::translate(planet_list.at(i).distance, 0, 0);
-			// parent rotation process
-			model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(parent_index).rotation_theta);
-			// child rotation process
-			model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(i).rotation_theta);
-		}
-		// normal planet process
-		else {
-			// position, revolution process
-			model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(i).revolution_theta) * mat4::translate(planet_list.at(i).distance, 0, 0); 
-			// rotation process
-			model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(i).rotation_theta);
-		}
+// write this frame's instances and draw commands into a free region of the persistent buffer, then draw everything at once
+void render_azdo( const FramePacket& packet )
+{
+	// wait until the GPU is done with the frame that used this region NUM_FRAME_REGIONS frames ago
+	uint region = frame % NUM_FRAME_REGIONS;
+	if (frame_fences[region]) {
+		while (glClientWaitSync(frame_fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+		glDeleteSync(frame_fences[region]);
+		frame_fences[region] = 0;
+	}
 
-		uloc = glGetUniformLocation(program, "use_alpha_tex");				if (uloc > -1) glUniform1i(uloc, false); // do not use alpha tex
-		uloc = glGetUniformLocation(program, "use_shader");					if (uloc > -1) glUniform1i(uloc, i != 0); // do not apply shader to the Sun
-		uloc = glGetUniformLocation(program, "planet_radius");				if (uloc > -1) glUniform1f(uloc, planet_list.at(i).radius);
-		uloc = glGetUniformLocation(program, "model_matrix");				if (uloc > -1) glUniformMatrix4fv(uloc, 1, GL_TRUE, model_matrix);
-		uloc = glGetUniformLocation(program, "TEX");						if (uloc > -1) glUniform1i(uloc, planet_list.at(i).planet_texture_index);
+	// the mapping is coherent : no flush, the writes are visible to the commands issued after them
+	GLuint base = GLuint(frame_region_size / sizeof(mat4) * region);
+	DrawElementsIndirectCommand* commands = write_frame(packet, persistent_data + frame_region_size * region, base);
 
-		// render vertices: trigger shader programs to process vertex data
-		glDrawElements(GL_TRIANGLES, planet_index_list.size(), GL_UNSIGNED_INT, nullptr);
-	}
+	glUseProgram(mdi_program);
+	glBindVertexArray(mdi_vertex_array);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, persistent_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, draw_parameter_buffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)((GLubyte*)commands - persistent_data), GLsizei(packet.batches.size()), 0);
+	glBindVertexArray(0);
 
+	frame_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
 
-	// bind "ring" vertex attributes to your shader program
-	for (size_t k = 0, kn = std::extent<decltype(vertex_attrib)>::value, byte_offset = 0; k<kn; k++, byte_offset += attrib_size[k - 1])
+// the OpenGL backend of render_core : the instanced or the AZDO path
+// null mode : the frame the AZDO path would draw is written into host memory and goes nowhere
+struct GLBackend : public RenderBackend
+{
+	void submit( const FramePacket& packet ) override
 	{
-		GLuint loc = glGetAttribLocation(program, vertex_attrib[k]); if (loc >= kn) continue;
-		glEnableVertexAttribArray(loc);
-		glBindBuffer(GL_ARRAY_BUFFER, ring_vertex_buffer);
-		glVertexAttribPointer(loc, attrib_size[k] / sizeof(GLfloat), GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*)byte_offset);
+		if(bNull)
+		{
+			null_frame.resize(sizeof(mat4)*render_core.scene().size() + sizeof(DrawElementsIndirectCommand)*packet.batches.size());
+			write_frame(packet, null_frame.data(), 0);
+		}
+		else if(bAzdo) render_azdo(packet);
+		else render_instanced(packet);
 	}
+} gl_backend;
 
-	// use "ring" index buffer
-	if (ring_index_buffer) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ring_index_buffer);
-
-	// render "ring"
-	mat4 model_matrix = mat4::translate(0, 0, 0);
-	// position, revolution process
-	model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(saturn_ring_parent_index).revolution_theta) * mat4::translate(planet_list.at(saturn_ring_parent_index).distance, 0, 0);
-	// rotation process
-	model_matrix = model_matrix * mat4::rotate(vec3(0, 0, 1), planet_list.at(saturn_ring_parent_index).rotation_theta);
-
-	uloc = glGetUniformLocation(program, "use_alpha_tex");				if (uloc > -1) glUniform1i(uloc, true); // use alpha tex
-	uloc = glGetUniformLocation(program, "use_shader");					if (uloc > -1) glUniform1i(uloc, true); // use shader
-	uloc = glGetUniformLocation(program, "planet_radius");				if (uloc > -1) glUniform1f(uloc, saturn_ring_radius);
-	uloc = glGetUniformLocation(program, "model_matrix");				if (uloc > -1) glUniformMatrix4fv(uloc, 1, GL_TRUE, model_matrix);
-	uloc = glGetUniformLocation(program, "TEX");						if (uloc > -1) glUniform1i(uloc, 10); // index of the saturn ring
-	uloc = glGetUniformLocation(program, "TEX_ALPHA");					if (uloc > -1) glUniform1i(uloc, 11); // index of the saturn ring alpha
-
-	// render vertices: trigger shader programs to process vertex data
-	glDrawElements(GL_TRIANGLES, ring_index_list.size(), GL_UNSIGNED_INT, nullptr);
+void render()
+{
+	// null mode : the whole CPU frame (simulation, culling, sorting, draw commands), no GL call and no swap
+	// clear screen (with background color) and clear depth buffer
+	if(!bNull) glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
+	render_core.render(gl_backend, current_time, view_projection_matrix);
 
 	// swap front and back buffers, and display to screen
-	glfwSwapBuffers( window );
-
+	if(!bNull) glfwSwapBuffers( window );
 
 	// Frame display
 	frameCheckCount += 1;
 	float checkTime = (float)glfwGetTime();
 	float elapsedTime = checkTime - frameCheckTime;
 	if (elapsedTime > 1) {
-		printf("Frame rate : %.2f/s\n", frameCheckCount / elapsedTime);
+		printf("Frame rate%s : %.2f/s\n", bNull ? " (null mode)" : "", frameCheckCount / elapsedTime);
 		frameCheckTime = checkTime;
 		frameCheckCount = 0;
 	}
 }
 
+
 void reshape( GLFWwindow* window, int width, int height )
 {
 	// set current viewport in pixels (win_x, win_y, win_width, win_height)
@@ -239,6 +300,8 @@ void print_help()
 	printf( "- press ESC or 'q' to terminate the program\n" );
 	printf( "- press F1 or 'h' to see help\n" );
 	printf( "- press 'w' to toggle wireframe\n" );
+	printf( "- press 'm' to toggle the AZDO mode (persistent buffers, multi-draw-indirect)\n" );
+	printf( "- press 'n' to toggle the null mode (CPU frame and draw commands only, nothing submitted)\n" );
 	printf( "- press Home to reset camera\n" );
 	printf( "\n" );
 }
@@ -256,6 +319,16 @@ void keyboard( GLFWwindow* window, int key, int scancode, int action, int mods )
 			glPolygonMode(GL_FRONT_AND_BACK, bWireframe ? GL_LINE : GL_FILL);
 			printf("> using %s mode\n", bWireframe ? "wireframe" : "solid");
 		}
+		else if (key == GLFW_KEY_M)
+		{
+			if (mdi_program) bAzdo = !bAzdo;
+			printf("> using %s draws\n", bAzdo ? "AZDO (multi-draw-indirect)" : "instanced");
+		}
+		else if (key == GLFW_KEY_N)
+		{
+			bNull = !bNull;
+			printf("> null mode %s\n", bNull ? "on" : "off");
+		}
 		else if (key == GLFW_KEY_LEFT_SHIFT || key == GLFW_KEY_RIGHT_SHIFT) {
 			bShiftKeyPressed = true;
 		}
@@ -317,6 +390,37 @@ void motion( GLFWwindow* window, double x, double y )
 	cameraInfo.view_matrix = trackball.update( npos.x, npos.y );
 }
 
+// vertex array of a mesh : its attributes, its index buffer and the per-instance model matrix
+GLuint create_vertex_array( GLuint vertex_buffer, GLuint index_buffer )
+{
+	GLuint vertex_array;
+	glGenVertexArrays( 1, &vertex_array );
+	glBindVertexArray( vertex_array );
+
+	GLint	loc[]			= { locations.position, locations.normal, locations.texcoord };
+	size_t	attrib_size[]	= { sizeof(vertex().pos), sizeof(vertex().norm), sizeof(vertex().tex) };
+	glBindBuffer( GL_ARRAY_BUFFER, vertex_buffer );
+	for( size_t k=0, byte_offset=0; k<3; byte_offset+=attrib_size[k], k++ )
+	{
+		if(loc[k]<0) continue;
+		glEnableVertexAttribArray( loc[k] );
+		glVertexAttribPointer( loc[k], attrib_size[k]/sizeof(GLfloat), GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*) byte_offset );
+	}
+
+	// the model matrix advances once per instance
+	glBindBuffer( GL_ARRAY_BUFFER, instance_buffer );
+	for( GLint c=0; c<4 && locations.model_matrix>-1; c++ )
+	{
+		glEnableVertexAttribArray( locations.model_matrix+c );
+		glVertexAttribPointer( locations.model_matrix+c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (GLvoid*)(sizeof(vec4)*c) );
+		glVertexAttribDivisor( locations.model_matrix+c, 1 );
+	}
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, index_buffer );
+	glBindVertexArray( 0 );
+	return vertex_array;
+}
+
 void update_vertex_buffer()
 {
 	// clear and create new buffers
@@ -324,47 +428,13 @@ void update_vertex_buffer()
 	if (planet_index_buffer)	glDeleteBuffers(1, &planet_index_buffer);	planet_index_buffer = 0;
 	if (ring_vertex_buffer)	glDeleteBuffers(1, &ring_vertex_buffer);	ring_vertex_buffer = 0;
 	if (ring_index_buffer)	glDeleteBuffers(1, &ring_index_buffer);	ring_index_buffer = 0;
+	if (instance_buffer)	glDeleteBuffers(1, &instance_buffer);	instance_buffer = 0;
+	if (planet_vertex_array)	glDeleteVertexArrays(1, &planet_vertex_array);	planet_vertex_array = 0;
+	if (ring_vertex_array)	glDeleteVertexArrays(1, &ring_vertex_array);	ring_vertex_array = 0;
 
 	// check exceptions
 	if (planet_vertex_list.empty() || ring_vertex_list.empty()) { printf("[error] vertex_list is empty.\n"); return; }
 
-	// create buffers
-	// i : longitude, k : latitude
-	planet_index_list.clear();
-	for (uint i = 0; i <= NUM_TESS + 1; i++) {
-		for (uint k = 0; k < NUM_TESS / 2; k++) {
-			planet_index_list.push_back(i * (NUM_TESS / 2) + k);
-			planet_index_list.push_back(i * (NUM_TESS / 2) + k + 1);
-			planet_index_list.push_back((i + 1) * (NUM_TESS / 2) + k + 1);
-
-			planet_index_list.push_back((i + 1) * (NUM_TESS / 2) + k + 1);
-			planet_index_list.push_back((i + 1) * (NUM_TESS / 2) + k);
-			planet_index_list.push_back(i * (NUM_TESS / 2) + k);
-		}
-	}
-	ring_index_list.clear();
-	for (uint i = 0; i <= NUM_TESS; i++) {
-
-		// like flatten doughnut
-
-		ring_index_list.push_back(i * 2);
-		ring_index_list.push_back(i * 2 + 1);
-		ring_index_list.push_back((i + 1) * 2 + 1);
-
-		ring_index_list.push_back((i + 1) * 2 + 1);
-		ring_index_list.push_back(i * 2 + 1);
-		ring_index_list.push_back(i * 2);
-
-		ring_index_list.push_back((i + 1) * 2 + 1);
-		ring_index_list.push_back((i + 1) * 2);
-		ring_index_list.push_back(i * 2);
-
-		ring_index_list.push_back(i * 2);
-		ring_index_list.push_back((i + 1) * 2);
-		ring_index_list.push_back((i + 1) * 2 + 1);
-	}
-
-
 	// generation of vertex buffer: use vertex_list as it is
 	glGenBuffers(1, &planet_vertex_buffer);
 	glBindBuffer(GL_ARRAY_BUFFER, planet_vertex_buffer);
@@ -380,89 +450,239 @@ void update_vertex_buffer()
 	glGenBuffers(1, &ring_index_buffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ring_index_buffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*ring_index_list.size(), &ring_index_list[0], GL_STATIC_DRAW);
-}
 
-void mapping_texture(GLuint* target, const char* filePath) {
-
-	// Texture
-	int mip_levels = get_mip_levels(window_size.x, window_size.y);
-
-	// load image
-	int width, height, comp = 3;
-	unsigned char* image0 = stbi_load(filePath, &width, &height, &comp, 3);
-	if (comp == 1) comp = 3;
-
-	// vertical flip
-	int stride0 = width*comp, stride1 = (stride0 + 3)&(~3);	// 4-byte aligned stride
-	unsigned char* image = (unsigned char*)malloc(sizeof(unsigned char)*stride1*height);
-	for (int y = 0; y < height; y++) memcpy(image + (height - 1 - y)*stride1, image0 + y*stride0, stride0); // vertical flip
-
-	glGenTextures(1, target);
-	glBindTexture(GL_TEXTURE_2D, *target);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-
-	for (int k = 1, w = width >> 1, h = height >> 1; k<mip_levels; k++, w = max(1, w >> 1), h = max(1, h >> 1))
-		glTexImage2D(GL_TEXTURE_2D, k, GL_RGB8 /* GL_RGB for legacy GL */, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	free(image0);
-	free(image);
+	// generation of instance buffer: filled every frame in render() (at most every body)
+	glGenBuffers(1, &instance_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(mat4)*render_core.scene().size(), nullptr, GL_STREAM_DRAW);
 
+	// vertex arrays : the attribute setup is recorded once, render() only binds them
+	planet_vertex_array = create_vertex_array(planet_vertex_buffer, planet_index_buffer);
+	ring_vertex_array = create_vertex_array(ring_vertex_buffer, ring_index_buffer);
 }
 
-
-void update_circle_vertices()
+// look up the uniform and attribute locations of a linked program
+ProgramLocations get_program_locations( GLuint program )
 {
-	planet_vertex_list.clear();
-	ring_vertex_list.clear();
+	ProgramLocations locations;
+	locations.view_matrix = glGetUniformLocation(program, "view_matrix");
+	locations.projection_matrix = glGetUniformLocation(program, "projection_matrix");
+	locations.light_position = glGetUniformLocation(program, "light_position");
+	locations.Ia = glGetUniformLocation(program, "Ia");
+	locations.Id = glGetUniformLocation(program, "Id");
+	locations.Is = glGetUniformLocation(program, "Is");
+	locations.shininess = glGetUniformLocation(program, "shininess");
+	locations.use_shader = glGetUniformLocation(program, "use_shader");
+	locations.use_alpha_tex = glGetUniformLocation(program, "use_alpha_tex");
+	locations.TEX = glGetUniformLocation(program, "TEX");
+	locations.TEX_ALPHA = glGetUniformLocation(program, "TEX_ALPHA");
+	locations.texture_array = glGetUniformLocation(program, "texture_array");
+
+	locations.position = glGetAttribLocation(program, "position");
+	locations.normal = glGetAttribLocation(program, "normal");
+	locations.texcoord = glGetAttribLocation(program, "texcoord");
+	locations.model_matrix = glGetAttribLocation(program, "model_matrix");
+	return locations;
+}
 
-	// Sphere Init
-	// i : longitude, k : latitude
-	for (uint i = 0; i <= NUM_TESS; i++) {
+// light and material properties, and the texture units (they do not change)
+void set_constant_uniforms( GLuint program, const ProgramLocations& locations )
+{
+	glUseProgram(program);
+	if (locations.light_position > -1)	glUniform4fv(locations.light_position, 1, lightInfo.position);
+	if (locations.Ia > -1)				glUniform4fv(locations.Ia, 1, lightInfo.ambient);
+	if (locations.Id > -1)				glUniform4fv(locations.Id, 1, lightInfo.diffuse);
+	if (locations.Is > -1)				glUniform4fv(locations.Is, 1, lightInfo.specular);
+	if (locations.shininess > -1)		glUniform1f(locations.shininess, planet_shininess);
+
+	if (locations.texture_array > -1)	glUniform1i(locations.texture_array, NUM_TEXTURE);
+}
 
-		// t : theta - angle of longitude
-		float t = PI*2.0f / float(NUM_TESS) * float(i);
+// AZDO mode : both meshes in one vertex/index buffer, per-draw parameters in a shader storage buffer,
+// and NUM_FRAME_REGIONS regions of instances and draw commands in one persistently mapped buffer
+void create_azdo_resources()
+{
+	// meshes : the ring after the planet (draws address it with first_index and base_vertex)
+	glGenBuffers(1, &mdi_vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mdi_vertex_buffer);
+	glBufferStorage(GL_ARRAY_BUFFER, sizeof(vertex)*(planet_vertex_list.size() + ring_vertex_list.size()), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertex)*planet_vertex_list.size(), &planet_vertex_list[0]);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(vertex)*planet_vertex_list.size(), sizeof(vertex)*ring_vertex_list.size(), &ring_vertex_list[0]);
+
+	glGenBuffers(1, &mdi_index_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mdi_index_buffer);
+	glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*(planet_index_list.size() + ring_index_list.size()), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(uint)*planet_index_list.size(), &planet_index_list[0]);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*planet_index_list.size(), sizeof(uint)*ring_index_list.size(), &ring_index_list[0]);
+
+	// draw parameters in the order of the draw commands (the batches of render_core) : texture, use_shader, use_alpha_tex, alpha texture
+	std::vector<ivec4> draw_parameters;
+	for (const DrawBatch& batch : render_core.batches())
+		draw_parameters.push_back(ivec4(batch.texture, batch.lit, batch.alpha_texture != WHITE_TEXTURE_INDEX, batch.alpha_texture));
+	glGenBuffers(1, &draw_parameter_buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_parameter_buffer);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(ivec4)*draw_parameters.size(), &draw_parameters[0], 0);
+
+	// textures : one layer each of a 2D array at the largest size (the blit stretches the smaller images)
+	// a fragment wave can span draws, so the texture index is not dynamically uniform : a layer may vary, a sampler array index may not
+	// (the work is done on unit NUM_TEXTURE, units 0..NUM_TEXTURE-1 keep the textures of the instanced path)
+	glActiveTexture(GL_TEXTURE0 + NUM_TEXTURE);
+	ivec2 size(1, 1);
+	for (uint i = 0; i < NUM_TEXTURE; i++) {
+		GLint width, height;
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		size = ivec2(max(size.x, width), max(size.y, height));
+	}
+	glGenTextures(1, &texture_array);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, get_mip_levels(size.x, size.y), GL_RGBA8, size.x, size.y, NUM_TEXTURE);
+
+	GLuint framebuffers[2];
+	glGenFramebuffers(2, framebuffers);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+	for (uint i = 0; i < NUM_TEXTURE; i++) {
+		GLint width, height;
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_array, 0, i);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(2, framebuffers);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glActiveTexture(GL_TEXTURE0);
+
+	// per frame : the instances (at most every body), then the draw commands
+	GLsizeiptr frame_bytes = sizeof(mat4)*render_core.scene().size() + sizeof(DrawElementsIndirectCommand)*draw_parameters.size();
+	frame_region_size = (frame_bytes + sizeof(mat4) - 1) / sizeof(mat4) * sizeof(mat4);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &persistent_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, persistent_buffer);
+	glBufferStorage(GL_ARRAY_BUFFER, frame_region_size * NUM_FRAME_REGIONS, nullptr, flags);
+	persistent_data = (GLubyte*)glMapBufferRange(GL_ARRAY_BUFFER, 0, frame_region_size * NUM_FRAME_REGIONS, flags);
+
+	// vertex array : the attribute locations are fixed in trackball_mdi.vert
+	glGenVertexArrays(1, &mdi_vertex_array);
+	glBindVertexArray(mdi_vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, mdi_vertex_buffer);
+	size_t attrib_size[] = { sizeof(vertex().pos), sizeof(vertex().norm), sizeof(vertex().tex) };
+	for (GLuint k = 0, byte_offset = 0; k < 3; byte_offset += GLuint(attrib_size[k]), k++) {
+		glEnableVertexAttribArray(k);
+		glVertexAttribPointer(k, GLint(attrib_size[k] / sizeof(GLfloat)), GL_FLOAT, GL_FALSE, sizeof(vertex), (GLvoid*)(size_t)byte_offset);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, persistent_buffer);
+	for (GLuint c = 0; c < 4; c++) {
+		glEnableVertexAttribArray(3 + c);
+		glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (GLvoid*)(sizeof(vec4)*c));
+		glVertexAttribDivisor(3 + c, 1);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mdi_index_buffer);
+	glBindVertexArray(0);
+}
 
-		for (uint k = 0; k <= NUM_TESS / 2; k++) {
+void destroy_azdo_resources()
+{
+	for (GLsync& fence : frame_fences) { if (fence) glDeleteSync(fence); fence = 0; }
+	if (persistent_buffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, persistent_buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		persistent_data = nullptr;
+	}
 
-			// p : pi - angle of latitude
-			float p = PI*2.0f / float(NUM_TESS) * float(k);
+	GLuint buffers[] = { mdi_vertex_buffer, mdi_index_buffer, draw_parameter_buffer, persistent_buffer };
+	glDeleteBuffers(4, buffers);
+	glDeleteVertexArrays(1, &mdi_vertex_array);
+	glDeleteTextures(1, &texture_array);
+	texture_array = 0;
+	mdi_vertex_buffer = mdi_index_buffer = draw_parameter_buffer = persistent_buffer = mdi_vertex_array = 0;
+}
 
-			// position, texcoord
-			float x = RADIUS * sin(p) * cos(t), y = RADIUS * sin(p) * sin(t), z = RADIUS * cos(p);
-			float c1 = t / 2 / PI;
-			float c2 = 1 - p / PI;
+// decode the images on worker threads straight into one pixel unpack buffer, then create immutable textures from it
+// the uploads are queued without waiting for the copies, and the vertical flip is in the texture coordinates
+// a null path (or an image that fails to load) is a 1x1 white texture
+void load_textures(GLuint* targets, const char* const* paths, uint count) {
+
+	// image sizes from the headers (RGB, rows tightly packed)
+	std::vector<ivec2> sizes(count, ivec2(1, 1));
+	std::vector<size_t> offsets(count + 1, 0);
+	for (uint i = 0; i < count; i++) {
+		int comp;
+		if (paths[i] && !stbi_info(paths[i], &sizes[i].x, &sizes[i].y, &comp)) { printf("[error] failed to load %s\n", paths[i]); sizes[i] = ivec2(1, 1); }
+		offsets[i + 1] = offsets[i] + size_t(sizes[i].x) * sizes[i].y * 3;
+	}
 
-			planet_vertex_list.push_back({ vec3(x, y, z), vec3(x, y, z), vec2(c1, c2) });
+	GLuint pixel_buffer;
+	glGenBuffers(1, &pixel_buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, offsets[count], nullptr, GL_STREAM_DRAW);
+	unsigned char* pixels = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, offsets[count], GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	// load image : one thread per image, each into its own range of the buffer
+	std::vector<std::thread> workers;
+	for (uint i = 0; i < count; i++) {
+		workers.emplace_back([&, i]() {
+			int width, height, comp;
+			unsigned char* image = paths[i] ? stbi_load(paths[i], &width, &height, &comp, 3) : nullptr;
+			if (image && width == sizes[i].x && height == sizes[i].y) memcpy(pixels + offsets[i], image, offsets[i + 1] - offsets[i]);
+			else memset(pixels + offsets[i], 255, offsets[i + 1] - offsets[i]);
+			stbi_image_free(image);
+		});
+	}
+	for (auto& worker : workers) worker.join();
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	// immutable storage with the whole mip chain (GL 4.2), level 0 copied from the buffer
+	// before 4.2 : level 0 defined from the buffer, glGenerateMipmap defines the others of the mutable texture
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glGenTextures(count, targets);
+	for (uint i = 0; i < count; i++) {
+		glBindTexture(GL_TEXTURE_2D, targets[i]);
+		if (GLAD_GL_VERSION_4_2)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, get_mip_levels(sizes[i].x, sizes[i].y), GL_RGB8, sizes[i].x, sizes[i].y);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sizes[i].x, sizes[i].y, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)offsets[i]);
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, sizes[i].x, sizes[i].y, 0, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)offsets[i]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, get_mip_levels(sizes[i].x, sizes[i].y) - 1);
 		}
+		glGenerateMipmap(GL_TEXTURE_2D);
 	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-	// Ring Init
-	// i : longitude
-	for (uint i = 0; i <= NUM_TESS; i++) {
+	// the buffer is released once the copies are done
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &pixel_buffer);
+}
 
-		// t : theta - angle of longitude
-		float t = PI*2.0f / float(NUM_TESS) * float(i);
 
-		float x = RADIUS * cos(t), y = RADIUS * sin(t);
+// the meshes and the bodies shared with VulkanTest (common/SolarSystem.h), and the textures
+void update_circle_vertices()
+{
+	// Sphere, Ring : converted to the vertex of cgut.h
+	std::vector<SceneVertex> vertices;
+	createSphereMesh(NUM_TESS, vertices, planet_index_list);
+	planet_vertex_list.clear();
+	for (const SceneVertex& v : vertices) planet_vertex_list.push_back({ vec3(v.pos[0], v.pos[1], v.pos[2]) * RADIUS, vec3(v.norm[0], v.norm[1], v.norm[2]), vec2(v.tex[0], v.tex[1]) });
 
-		ring_vertex_list.push_back({ vec3(x * 1.0f, y * 1.0f, 0), vec3(x * 1.0f, y * 1.0f, 0), vec2(0, t) });
-		ring_vertex_list.push_back({ vec3(x * 0.6f, y * 0.6f, 0), vec3(x * 0.6f, y * 0.6f, 0), vec2(1, t) });
-	}
+	createRingMesh(NUM_TESS, vertices, ring_index_list);
+	ring_vertex_list.clear();
+	for (const SceneVertex& v : vertices) ring_vertex_list.push_back({ vec3(v.pos[0], v.pos[1], v.pos[2]) * RADIUS, vec3(v.norm[0], v.norm[1], v.norm[2]), vec2(v.tex[0], v.tex[1]) });
 
 	// texture initialize
-	mapping_texture(&textures[0], "./textures/sun.jpg");
-	mapping_texture(&textures[1], "./textures/mercury.jpg");
-	mapping_texture(&textures[2], "./textures/venus.jpg");
-	mapping_texture(&textures[3], "./textures/earth.jpg");
-	mapping_texture(&textures[4], "./textures/mars.jpg");
-	mapping_texture(&textures[5], "./textures/jupiter.jpg");
-	mapping_texture(&textures[6], "./textures/saturn.jpg");
-	mapping_texture(&textures[7], "./textures/uranus.jpg");
-	mapping_texture(&textures[8], "./textures/neptune.jpg");
-	mapping_texture(&textures[9], "./textures/moon.jpg");
-	mapping_texture(&textures[10], "./textures/saturn-ring.jpg");
-	mapping_texture(&textures[11], "./textures/saturn-ring-alpha.jpg");
+	load_textures(textures, SOLAR_TEXTURE_PATHS, NUM_TEXTURE);
 
 	// texture bind
 	for (int i = 0; i < NUM_TEXTURE; i++) {
@@ -470,45 +690,11 @@ void update_circle_vertices()
 		glBindTexture(GL_TEXTURE_2D, textures[i]);
 	}
 
-	// Planet instance
-	planet_list.push_back(Planet(-1, 0, 0.0f, 5.4f, 5.2f, 0.0f));       // Sun
-	planet_list.push_back(Planet(-1, 1, 9.9f, 0.6f, 7.7f, 3.1f));       // Mercury
-	planet_list.push_back(Planet(-1, 2, 15.8f, 1.0f, 15.6f, 3.9f));     // Venus
-	planet_list.push_back(Planet(-1, 3, 19.3f, 1.0f, 1.0f, 4.4f));      // Earth
-	planet_list.push_back(Planet(-1, 4, 24.2f, 0.7f, 1.0f, 5.1f));      // Mars
-	planet_list.push_back(Planet(-1, 5, 36.8f, 3.3f, 0.6f, 8.1f));      // Jupiter
-	planet_list.push_back(Planet(-1, 6, 61.4f, 3.1f, 0.6f, 10.2f));     // Saturn
-	planet_list.push_back(Planet(-1, 7, 82.6f, 2.0f, 0.8f, 13.2f));     // Uranus
-	planet_list.push_back(Planet(-1, 8, 103.6f, 2.0f, 0.8f, 15.6f));     // Neptune
-
-	// Setellite instance
-	planet_list.push_back(Planet(3, 9, 2.5f, 0.3f, 27.3f, 1.0f));  // Moon (Setellite of the Earth)
-
-	planet_list.push_back(Planet(5, 9, 4.0f, 0.4f, 0.4f, 0.4f));  // Io (Setellite of the Jupiter)
-	planet_list.push_back(Planet(5, 9, 8.5f, 0.5f, 4.0f, 4.0f));  // Callisto (Setellite of the Jupiter)
-	planet_list.push_back(Planet(5, 9, 5.0f, 0.3f, 0.8f, 0.8f));  // Europa (Setellite of the Jupiter)
-	planet_list.push_back(Planet(5, 9, 7.0f, 0.6f, 2.0f, 2.0f));  // Ganymede (Setellite of the Jupiter)
-
-	planet_list.push_back(Planet(7, 9, 3.8f, 0.3f, 0.4f, 0.4f));  // Miranda (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 9, 5.0f, 0.5f, 0.5f, 0.5f));  // Ariel (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 9, 6.5f, 0.5f, 0.6f, 0.6f));  // Umbriel (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 9, 8.0f, 0.7f, 0.8f, 0.8f));  // Titania (Setellite of the Uranus)
-	planet_list.push_back(Planet(7, 9, 10.0f, 0.7f, 1.3f, 1.3f));  // Oberon (Setellite of the Uranus)
-
-	planet_list.push_back(Planet(8, 9, 5.0f, 0.8f, -0.6f, -0.6f));  // Triton (Setellite of the Uranus)
-	planet_list.push_back(Planet(8, 9, 7.0f, 0.5f, 1.1f, 30.0f));  // Oberon (Setellite of the Uranus)
-
-	// Ring info
-	saturn_ring_parent_index = 6;
-	saturn_ring_radius = planet_list.at(6).radius * 2.0f;
-
-	// other tiny planets
-	srand((int)time(NULL));
-	for (int i = 0; i < 1000; i++) {
-		int parent = rand() % 9;
-		planet_list.push_back(Planet(parent, 9, planet_list.at(parent).radius + 1 + rand() % 500 / 100.0f, 0.01f + rand() % 10 / 100.0f, 1.0f + rand() % 1000 / 100.0f, 1.0f + rand() % 1000 / 100.0f));
-	}
-
+	// Planet, Setellite and Ring instance, other tiny planets
+	std::vector<Planet> planet_list;
+	createSolarSystem(planet_list, (unsigned int)time(NULL));
+	render_core.setScene(planet_list);
+	render_core.setSorter(&depth_sorter);
 }
 
 
@@ -540,11 +726,21 @@ bool user_init()
 	// create vertex buffer
 	update_vertex_buffer();
 
+	// setup light and material properties (they do not change)
+	set_constant_uniforms(program, locations);
+
+	// AZDO mode
+	if (mdi_program) {
+		set_constant_uniforms(mdi_program, mdi_locations);
+		create_azdo_resources();
+	}
+
 	return true;
 }
 
 void user_finalize()
 {
+	if (mdi_program) destroy_azdo_resources();
 }
 
 void main( int argc, char* argv[] )
@@ -558,6 +754,16 @@ void main( int argc, char* argv[] )
 
 	// initializations and validations
 	if(!(program=cg_create_program( vert_shader_path, frag_shader_path ))){ glfwTerminate(); return; }	// create and compile shaders/program
+	locations = get_program_locations( program );														// uniform/attribute locations of the program
+
+	// AZDO mode : glBufferStorage, glMultiDrawElementsIndirect and gl_DrawID need OpenGL 4.6
+	if(GLAD_GL_VERSION_4_6 && (mdi_program=cg_create_program( mdi_vert_shader_path, mdi_frag_shader_path ))) mdi_locations = get_program_locations( mdi_program );
+	else printf( "AZDO mode is not available (OpenGL 4.6 required)\n" );
+	for( int k=1; k<argc; k++ )
+	{
+		if(strcmp(argv[k],"--azdo")==0) bAzdo = mdi_program!=0;
+		else if(strcmp(argv[k],"--null")==0) bNull = true;
+	}
 	if(!user_init()){ printf( "Failed to user_init()\n" ); glfwTerminate(); return; }					// user initialization
 
 	// register event callbacks
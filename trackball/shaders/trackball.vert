@@ -4,27 +4,21 @@
 in vec3 position;
 in vec3 normal;
 in vec2 texcoord;
+in mat4 model_matrix;	// per instance, the radius is scaled in
 
 // matrices
 uniform mat4 view_matrix;
 uniform mat4 projection_matrix;
-uniform mat4 model_matrix;
 
 // outputs of vertex shader = input to fragment shader
 out vec3 norm;  // per-vertex normal before interpolation
 out vec2 tc;    // used for texture coordinate visualization
 out vec4 epos;	// eye-coordinate position
 
-// uniform variables
-uniform float planet_radius;
-
 void main()
 {
-	// apply radius
-	vec3 regulated = position * planet_radius;
-
 	// projection
-	vec4 wpos = model_matrix * vec4(regulated, 1);
+	vec4 wpos = model_matrix * vec4(position, 1);
 	epos = view_matrix * wpos;
 	gl_Position = projection_matrix * epos;
 
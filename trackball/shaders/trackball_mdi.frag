@@ -0,0 +1,61 @@
+#version 460
+
+
+// input from vertex shader
+in vec4 epos; // eye-coordinate position
+in vec3 norm; // per-vertex normal before interpolation
+in vec2 tc;	  // used for texture coordinate visualization
+flat in int draw_id; // index of the draw (the same for the whole draw)
+
+// the only output variable
+out vec4 fragColor;
+
+// per-draw parameters : texture, use_shader, use_alpha_tex, alpha texture
+layout(std430, binding = 0) readonly buffer DrawParameters
+{
+	ivec4 draws[];
+};
+
+// uniform variables
+uniform sampler2DArray texture_array;       // one layer per texture (the layer may differ within a wave, unlike a sampler array index)
+uniform mat4	view_matrix;
+uniform vec4	light_position, Ia, Id, Is;	// light
+uniform float	shininess;
+
+
+void main()
+{
+	ivec4 draw = draws[draw_id];
+	vec4 texture_color = texture( texture_array, vec3(tc, draw.x) );
+
+	if(draw.y != 0) {
+
+		// light position in the eye-space coordinate
+		vec4 lpos = view_matrix*light_position;
+
+		vec3 n = normalize(norm);	// norm interpolated via rasterizer should be normalized again here
+		vec3 p = epos.xyz;			// 3D position of this fragment
+		vec3 l = normalize(lpos.xyz-(lpos.a==0.0?vec3(0):p));	// lpos.a==0 means directional light
+		vec3 v = normalize(-p);		// eye-epos = vec3(0)-epos
+		vec3 h = normalize(l+v);	// the halfway vector
+
+		vec4 Ira = texture_color*Ia;									// ambient reflection
+		vec4 Ird = max(texture_color*dot(l,n)*Id,0.0);					// diffuse reflection
+		vec4 Irs = max(texture_color*pow(dot(h,n),shininess)*Is,0.0);	// specular reflection
+
+		fragColor = Ira + Ird + Irs;
+
+	} else {
+
+		fragColor = texture_color;
+
+	}
+
+	if(draw.z != 0) {
+
+		// alpha texture image is grayscale - so texture.r, .g, .b are equal
+		fragColor.a = texture( texture_array, vec3(tc, draw.w) ).r;
+
+	}
+
+}
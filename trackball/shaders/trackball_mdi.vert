@@ -0,0 +1,30 @@
+#version 460
+
+// vertex attributes (fixed locations : the vertex array of the AZDO mode is set up once)
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texcoord;
+layout(location = 3) in mat4 model_matrix;	// per instance (from the baseInstance of the draw), the radius is scaled in
+
+// matrices
+uniform mat4 view_matrix;
+uniform mat4 projection_matrix;
+
+// outputs of vertex shader = input to fragment shader
+out vec3 norm;  // per-vertex normal before interpolation
+out vec2 tc;    // used for texture coordinate visualization
+out vec4 epos;	// eye-coordinate position
+flat out int draw_id;	// index of the draw in glMultiDrawElementsIndirect
+
+void main()
+{
+	// projection
+	vec4 wpos = model_matrix * vec4(position, 1);
+	epos = view_matrix * wpos;
+	gl_Position = projection_matrix * epos;
+
+	// pass eye-coordinate normal to fragment shader
+	norm = normalize(mat3(view_matrix*model_matrix)*normal);
+	tc = texcoord;
+	draw_id = gl_DrawID;
+}